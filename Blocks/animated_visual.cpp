@@ -6,10 +6,12 @@ namespace Blocks {
 // TODO: Error checking if ondraw is already set? //
 void AnimatedVisual::setSprite(Sprite& s) {
 	props_.sprite = &s; // Must have the same animation properties! // TODO: Allow changing properties? //
+	markDirty();
 }
 
 void AnimatedVisual::setBackgroundColor(const Color& bg_color) {
 	props_.background_color = bg_color;
+	markDirty();
 }
 
 void AnimatedVisual::draw() {
@@ -18,7 +20,7 @@ void AnimatedVisual::draw() {
 	}
 
 	if (props_.sprite == nullptr) {
-		log::Error("AnimatedVisual", "Attempted to draw a null animated visual");
+		ARC_LOG_ERROR("AnimatedVisual", "Attempted to draw a null animated visual");
 		return;
 	}
 
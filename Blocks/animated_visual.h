@@ -26,18 +26,21 @@ public:
 	};
 
 	explicit AnimatedVisual(const Properties& props, const int width, const int height)
-	 : Drawable(width, height), props_(props) {}
+	 : Drawable(width, height), props_(props) {
+		tracked_ = true;
+	}
 
 	void setSprite(Sprite& s);
 	void setBackgroundColor(const Color& bg_color);
 
 	// To use multiple animations in one sprite
-	void setStartOffset(const int off_x, const int off_y) { props_.start_offset_x = off_x; props_.start_offset_y = off_y; }
+	void setStartOffset(const int off_x, const int off_y) { props_.start_offset_x = off_x; props_.start_offset_y = off_y; markDirty(); }
 
 	void pause() { playing_ = false; }
 	void play() { playing_ = true; }
 
 	void draw() override;
+	bool isDirty() const override { return playing_ || Drawable::isDirty(); } // Changes every frame while playing.
 
 protected:
 	Properties props_;
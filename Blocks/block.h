@@ -3,6 +3,7 @@
 #include "../arc/graphics.h"
 #include "../arc/input.h"
 
+#include "damage.h"
 #include "event.h"
 
 template<typename T>
@@ -30,14 +31,35 @@ public:
 	int height() const { return height_; }
 
 	bool is_visible() { return visible_; } // Canvas won't draw any hidden drawables.
-	void show() { visible_ = true; }
-	void hide() { visible_ = false; }
-	void toggle_visible() { visible_ = !visible_; }
+	void show() { visible_ = true; markDirty(); }
+	void hide() { visible_ = false; markDirty(); }
+	void toggle_visible() { visible_ = !visible_; markDirty(); }
+
+	// Damage tracking, so only the changed regions of the screen are drawn again:
+	// Call markDirty() when anything this draws changes, that this block doesn't already know about
+	// (such as the pixels of a sprite it draws).
+	void markDirty() { dirty_ = true; }
+	virtual bool isDirty() const { return dirty_ || !tracked_; }
+	virtual void clearDirty() { dirty_ = false; }
+	// For blocks sized by what they draw (such as a sprite still loading), updates the size. Canvases
+	// call this before checking if a block moved or resized, and before it is drawn.
+	virtual void updateSize() {}
+	// Adds the changed regions (with this block drawn at x, y) and clears the dirty state.
+	// Canvases add the changed regions of each block instead.
+	virtual void collectDamage(DamageRegion& damage, const int x, const int y) {
+		if (isDirty()) {
+			damage.add(x, y, width_, height_);
+		}
+		clearDirty();
+	}
 
 protected:
 	int width_ = 0;
 	int height_ = 0;
 	bool visible_ = true;
+	bool dirty_ = true;
+	// Set by blocks that mark themselves dirty for every change, otherwise they are always drawn again.
+	bool tracked_ = false;
 };
 
 class ExpandingDrawable : public Drawable {
@@ -64,6 +86,7 @@ public:
 		if (ex_props_.expanding_height) {
 			height_ = min_max(ex_props_.min_height, height, ex_props_.max_height) - ex_props_.margin_height;
 		}
+		markDirty();
 		onResize();
 	}
 
@@ -75,31 +75,38 @@ void Button::action(BlockAction a) {
 	}
 }
 
-void Button::draw() {
+Drawable* Button::CurrentVisual() const {
 	switch (state_) {
 		case StateHover:
 		if (props_.hover_v != nullptr) {
-			props_.hover_v->draw();
-			return;
+			return props_.hover_v;
 		}
 		break;
 		case StateClick:
 		if (props_.click_v != nullptr) {
-			props_.click_v->draw();
-			return;
+			return props_.click_v;
 		}
 		break;
 		case StateDisabled:
 		if (props_.disabled_v != nullptr) {
-			props_.disabled_v->draw();
-			return;
+			return props_.disabled_v;
 		}
 		break;
 		case StateDefault:
 		default:
 		break;
 	}
-	props_.default_v->draw();
+	return props_.default_v;
+}
+
+void Button::draw() {
+	CurrentVisual()->draw();
+}
+
+void Button::clearDirty() {
+	Drawable::clearDirty();
+	drawn_state_ = state_;
+	CurrentVisual()->clearDirty();
 }
 
 } // namespace Blocks
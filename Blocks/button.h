@@ -16,15 +16,23 @@ public:
 	// For buttons with only one visual:
 	explicit Button(Drawable& vis) : Interactive(vis.width(), vis.height()) {
 		props_.default_v = &vis;
+		tracked_ = true;
 	}
 	
-	explicit Button(Properties props) : Interactive(props.default_v->width(), props.default_v->height()), props_(props) {}
+	explicit Button(Properties props) : Interactive(props.default_v->width(), props.default_v->height()), props_(props) {
+		tracked_ = true;
+	}
 
 	void event(BlockEvent e) override;
 	void action(BlockAction a) override; // Actions: Enable, Disable, etc.
 	void draw() override;
+	// Also when the state or the current visual changed.
+	bool isDirty() const override { return Drawable::isDirty() || state_ != drawn_state_ || CurrentVisual()->isDirty(); }
+	void clearDirty() override;
 
 protected:
+	Drawable* CurrentVisual() const; // For the current state.
+
 	Properties props_;
 
 	static const uint8_t StateDefault = 0;
@@ -33,6 +41,7 @@ protected:
 	static const uint8_t StateDisabled = 3;
 
 	uint8_t state_ = StateDefault;
+	uint8_t drawn_state_ = StateDefault;
 
 	bool hovered_ = false;
 	bool pressed_down_ = false; // So drag out + up or drag in + up don't generate presses.
@@ -69,6 +69,7 @@ void Canvas::removeBlock(Drawable& block) { // Works for all types.
 					}
 				}
 			}
+			AddRemovedDamage(be);
 			delete be; // Don't need the block element anymore, although the block itself is not deleted.
 			return;
 		}
@@ -91,12 +92,19 @@ void Canvas::removeBlock(BlockElement* block_element) {
 					}
 				}
 			}
+			AddRemovedDamage(be);
 			delete be; // Don't need the block element anymore, although the block itself is not deleted.
 			return;
 		}
 	}
 }
 
+void Canvas::AddRemovedDamage(const BlockElement* be) {
+	if (be->drawn) {
+		removed_damage_.add(be->drawn_x, be->drawn_y, be->drawn_width, be->drawn_height);
+	}
+}
+
 bool Canvas::SendScreenEventHitTestAll(std::vector<BlockElement*>& int_blocks, const BlockEvent& e) {
 	for (size_t i = int_blocks.size(); i > 0; i--) {
 		BlockElement* be = int_blocks[i - 1];
@@ -141,7 +149,7 @@ void Canvas::action(BlockAction a) {
 	if (a.is_movement()) {
 		BlockElement* be = (BlockElement*) a.data;
 		if (be == nullptr) {
-			log::Error("Canvas", "Movement action received with null data!"); return;
+			ARC_LOG_ERROR("Canvas", "Movement action received with null data!"); return;
 		}
 		// TODO: Check that this block is actually in this canvas?
 		Drawable* d = be->d;
@@ -226,13 +234,22 @@ void Canvas::AssignDrawCoords(BlockElement* be) {
 }
 
 void Canvas::draw() {
+	if (render.IsClippedOut(0, 0, width_, height_)) return; // Not on screen (or outside of the parent canvas).
+
 	int off_x, off_y;
 	render.GetDrawOffset(off_x, off_y); // In case this is a sub-canvas.
+	render.PushClip(0, 0, width_, height_);
 
 	if (!props_.background_color.is_transparent()) {
 		render.DrawRect(width_, height_, props_.background_color);
 	}
+	DrawElements(off_x, off_y);
 
+	render.SetDrawOffset(off_x, off_y);
+	render.PopClip();
+}
+
+void Canvas::DrawElements(const int off_x, const int off_y) {
 	const size_t len = drawables_.size();
 	for (size_t i = 0; i < len; i++) {
 		BlockElement* be = drawables_[i];
@@ -240,10 +257,57 @@ void Canvas::draw() {
 
 		Drawable* d = be->d;
 		if (d->is_visible()) {
-			render.SetDrawOffset(off_x + be->draw_x, off_y + be->draw_y); // TODO: Clipping off of canvas boundaries?
+			d->updateSize();
+			render.SetDrawOffset(off_x + be->draw_x, off_y + be->draw_y);
+			if (render.IsClippedOut(0, 0, d->width(), d->height())) continue; // Skips any sub-blocks too.
 			d->draw(); // Drawable::draw() - virtual function should resolve the correct call.
 		}
 	}
 }
 
+void Canvas::collectDamage(DamageRegion& damage, const int x, const int y) {
+	if (isDirty()) { // Resized, etc.
+		damage.add(x, y, width_, height_);
+	}
+	clearDirty();
+
+	for (const SDL_Rect& r : removed_damage_.rects()) {
+		damage.add(x + r.x, y + r.y, r.w, r.h);
+	}
+	removed_damage_.clear();
+
+	const size_t len = drawables_.size();
+	for (size_t i = 0; i < len; i++) {
+		BlockElement* be = drawables_[i];
+		if (be == nullptr) continue;
+		CollectElementDamage(be, damage, x, y);
+	}
+}
+
+void Canvas::CollectElementDamage(BlockElement* be, DamageRegion& damage, const int x, const int y) {
+	Drawable* d = be->d;
+	const bool visible = d->is_visible();
+	d->updateSize();
+
+	if (visible != be->drawn || (visible && (be->draw_x != be->drawn_x || be->draw_y != be->drawn_y ||
+		d->width() != be->drawn_width || d->height() != be->drawn_height))) {
+		// Moved, resized, shown, or hidden, so both the old and new regions change.
+		if (be->drawn) {
+			damage.add(x + be->drawn_x, y + be->drawn_y, be->drawn_width, be->drawn_height);
+		}
+		if (visible) {
+			damage.add(x + be->draw_x, y + be->draw_y, d->width(), d->height());
+		}
+		be->drawn = visible;
+		be->drawn_x = be->draw_x;
+		be->drawn_y = be->draw_y;
+		be->drawn_width = d->width();
+		be->drawn_height = d->height();
+	}
+
+	if (visible) {
+		d->collectDamage(damage, x + be->draw_x, y + be->draw_y);
+	}
+}
+
 } // namespace Blocks
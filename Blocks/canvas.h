@@ -25,9 +25,18 @@ public:
 		// Current draw coordinates. (auto-calculated)
 		int draw_x;
 		int draw_y;
+
+		// Where it was last drawn, for damage tracking. (auto-calculated)
+		int drawn_x = 0;
+		int drawn_y = 0;
+		int drawn_width = 0;
+		int drawn_height = 0;
+		bool drawn = false;
 	};
 
-	Canvas(Properties props, ExpandingProperties ex_props) : ExpandingInteractive(ex_props), props_(props) {}
+	Canvas(Properties props, ExpandingProperties ex_props) : ExpandingInteractive(ex_props), props_(props) {
+		tracked_ = true;
+	}
 	~Canvas();
 
 	// Positive Coordinates are from top/left and negative are from bottom/right (auto-resizing)
@@ -43,6 +52,8 @@ public:
 	void event(BlockEvent e) override;
 	void action(BlockAction a) override;
 	void draw() override;
+	// Adds the regions of all blocks that moved, were shown/hidden, or are dirty.
+	void collectDamage(DamageRegion& damage, const int x, const int y) override;
 
 	static const constexpr int Centered = AlignCentered;
 
@@ -56,6 +67,13 @@ protected:
 
 	void AssignDrawCoords(BlockElement* be);
 
+	// Draws the blocks that are not clipped out. off_x/y are this canvas' draw offset.
+	void DrawElements(const int off_x, const int off_y);
+
+	// Uses the current draw_x/draw_y, so these must be assigned first. x and y are this canvas' position.
+	void CollectElementDamage(BlockElement* be, DamageRegion& damage, const int x, const int y);
+	void AddRemovedDamage(const BlockElement* be);
+
 	Properties props_;
 	
 	// All blocks which this canvas directly draws/aligns/and passes screen events to.
@@ -63,6 +81,9 @@ protected:
 	std::vector<BlockElement*> drawables_;
 	// Subset of the above, for fast screen event processing: (Not Owned)
 	std::vector<BlockElement*> interactives_;
+
+	// Regions of removed blocks, in local coordinates.
+	DamageRegion removed_damage_;
 };
 
 } // namespace Blocks
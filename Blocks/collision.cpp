@@ -1,5 +1,7 @@
 #include "collision.h"
 
+#include "../arc/trace.h"
+
 namespace Blocks {
 
 inline bool collision_detect(const int x, const int y, const int x_end, const int y_end, const CollisionObject* c) {
@@ -76,7 +78,7 @@ CollisionSpace::~CollisionSpace() {
 size_t CollisionSpace::addObject(const CollisionObject& obj) {
 	const size_t id = obj.event_id;
 	if (objects_.count(id)) {
-		log::Error("CollisionSpace", "Adding a duplicate event_id CollisionObject!");
+		ARC_LOG_ERROR("CollisionSpace", "Adding a duplicate event_id CollisionObject!");
 		return 0;
 	}
 
@@ -92,13 +94,13 @@ size_t CollisionSpace::addObject(const CollisionObject& obj) {
 // Uses the drawable dimensions as the hitbox + the event id already assigned.
 size_t CollisionSpace::addObjectAutoHitbox(Canvas::BlockElement* block_handle) {
 	if (block_handle == nullptr || block_handle->d == nullptr || block_handle->se == nullptr) {
-		log::Error("CollisionSpace", "Attempted to add null block handle as an auto-hitbox collision object!");
+		ARC_LOG_ERROR("CollisionSpace", "Attempted to add null block handle as an auto-hitbox collision object!");
 		return 0;
 	}
 
 	const size_t id = block_handle->se->connectionID();
 	if (objects_.count(id)) {
-		log::Error("CollisionSpace", "Adding a duplicate event_id CollisionObject (as AutoHitbox block_handle)!");
+		ARC_LOG_ERROR("CollisionSpace", "Adding a duplicate event_id CollisionObject (as AutoHitbox block_handle)!");
 		return 0;
 	}
 
@@ -117,7 +119,7 @@ size_t CollisionSpace::addObjectAutoHitbox(Canvas::BlockElement* block_handle) {
 size_t CollisionSpace::addActor(const CollisionActor& actor) {
 	const size_t id = actor.event_id;
 	if (actors_.count(id)) {
-		log::Error("CollisionSpace", "Adding a duplicate event_id CollisionActor!");
+		ARC_LOG_ERROR("CollisionSpace", "Adding a duplicate event_id CollisionActor!");
 		return 0;
 	}
 	
@@ -132,7 +134,7 @@ size_t CollisionSpace::addActor(const CollisionActor& actor) {
 
 void CollisionSpace::removeObjectOrActor(const size_t event_id) {
 	if (event_id == 0) {
-		log::Error("CollisionSpace", "Attempted to remove a null event id collision object!");
+		ARC_LOG_ERROR("CollisionSpace", "Attempted to remove a null event id collision object!");
 		return;
 	}
 
@@ -221,7 +223,7 @@ void CollisionSpace::action(BlockAction a) {
 		actorStop(id);
 		break;
 	default:
-		log::Error("CollisionSpace", "Unhandled collision event type!");
+		ARC_LOG_ERROR("CollisionSpace", "Unhandled collision event type!");
 		break;
 	}
 }
@@ -229,6 +231,7 @@ void CollisionSpace::action(BlockAction a) {
 #define CHUNK_AT(X, Y) grid_[(grid_x_len * Y) + X]
 
 void CollisionSpace::frame(double frame_delta_time_msec) {
+	ARC_TRACE_SCOPE("CollisionSpace::frame");
 	const float fmsec = (float)frame_delta_time_msec;
 	
 	const size_t grid_x_len = props_.grid_x_len;
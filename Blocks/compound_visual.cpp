@@ -11,7 +11,7 @@ void CompoundVisual::draw() {
 
 	const size_t len = props_.visuals.size();
 	if (len == 0 && !drawn) {
-		log::Error("CompoundVisual", "Attempted to draw a null compound visual");
+		ARC_LOG_ERROR("CompoundVisual", "Attempted to draw a null compound visual");
 		return;
 	}
 
@@ -51,4 +51,19 @@ void CompoundVisual::draw() {
 	render.SetDrawOffset(off_x, off_y); // TODO: This may be unnecessary?
 }
 
+bool CompoundVisual::isDirty() const {
+	if (Drawable::isDirty()) return true;
+	for (const BasicAlignment& a : props_.visuals) {
+		if (a.d->isDirty()) return true;
+	}
+	return false;
+}
+
+void CompoundVisual::clearDirty() {
+	Drawable::clearDirty();
+	for (BasicAlignment& a : props_.visuals) {
+		a.d->clearDirty();
+	}
+}
+
 } // namespace Blocks
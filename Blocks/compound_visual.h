@@ -15,16 +15,20 @@ public:
 	};
 
 	CompoundVisual(const Properties& props, const int width, const int height)
-		: Drawable(width, height), props_(props) {}
+		: Drawable(width, height), props_(props) {
+		tracked_ = true;
+	}
 
-	void setBackgroundColor(const Color& bg_color) { props_.background_color = bg_color; }
+	void setBackgroundColor(const Color& bg_color) { props_.background_color = bg_color; markDirty(); }
 
-	void addAlignedDrawable(const BasicAlignment& a) { props_.visuals.push_back(a); }
-	void addAlignedDrawable(BasicAlignment&& a) { props_.visuals.push_back(std::move(a)); }
+	void addAlignedDrawable(const BasicAlignment& a) { props_.visuals.push_back(a); markDirty(); }
+	void addAlignedDrawable(BasicAlignment&& a) { props_.visuals.push_back(std::move(a)); markDirty(); }
 
-	void addDrawableAt(Drawable* d, const int xpos, const int ypos) { props_.visuals.push_back(BasicAlignment(d, xpos, ypos)); }
+	void addDrawableAt(Drawable* d, const int xpos, const int ypos) { props_.visuals.push_back(BasicAlignment(d, xpos, ypos)); markDirty(); }
 
 	void draw() override;
+	bool isDirty() const override; // Also if any of the visuals are.
+	void clearDirty() override;
 
 protected:
 	Properties props_;
@@ -0,0 +1,72 @@
+#include "damage.h"
+
+namespace Blocks {
+
+// Also true if only touching, as then the union doesn't add anything extra.
+static bool RectsTouch(const SDL_Rect& a, const SDL_Rect& b) {
+	return a.x <= b.x + b.w && b.x <= a.x + a.w && a.y <= b.y + b.h && b.y <= a.y + a.h;
+}
+
+static void UniteRects(SDL_Rect& a, const SDL_Rect& b) {
+	const int x = min(a.x, b.x);
+	const int y = min(a.y, b.y);
+	a.w = max(a.x + a.w, b.x + b.w) - x;
+	a.h = max(a.y + a.h, b.y + b.h) - y;
+	a.x = x;
+	a.y = y;
+}
+
+void DamageRegion::add(const int x, const int y, const int width, const int height) {
+	if (width <= 0 || height <= 0) return;
+
+	SDL_Rect rect = SDL_Rect_From_Coordinates(x, y, width, height);
+
+	// Merging can make it touch others, so check again until none are left.
+	bool merged = true;
+	while (merged) {
+		merged = false;
+		for (size_t i = 0; i < rects_.size(); i++) {
+			if (RectsTouch(rect, rects_[i])) {
+				UniteRects(rect, rects_[i]);
+				rects_[i] = rects_.back();
+				rects_.pop_back();
+				merged = true;
+				break;
+			}
+		}
+	}
+
+	if (rects_.size() >= MAX_DAMAGE_RECTS) {
+		for (const SDL_Rect& r : rects_) {
+			UniteRects(rect, r);
+		}
+		rects_.clear();
+	}
+	rects_.push_back(rect);
+}
+
+void DamageRegion::clip(const int width, const int height) {
+	for (size_t i = rects_.size(); i > 0; i--) {
+		SDL_Rect& r = rects_[i - 1];
+		const int x_end = min(r.x + r.w, width);
+		const int y_end = min(r.y + r.h, height);
+		r.x = max(r.x, 0);
+		r.y = max(r.y, 0);
+		r.w = x_end - r.x;
+		r.h = y_end - r.y;
+		if (r.w <= 0 || r.h <= 0) {
+			rects_[i - 1] = rects_.back();
+			rects_.pop_back();
+		}
+	}
+}
+
+int64_t DamageRegion::area() const {
+	int64_t total = 0;
+	for (const SDL_Rect& r : rects_) {
+		total += int64_t(r.w) * int64_t(r.h);
+	}
+	return total;
+}
+
+} // namespace Blocks
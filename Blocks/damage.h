@@ -0,0 +1,33 @@
+#pragma once
+
+#include <vector>
+
+#include "../arc/graphics.h"
+
+using namespace arc;
+
+namespace Blocks {
+
+// More separate rectangles are merged into their bounding box, as each one is another draw pass.
+#define MAX_DAMAGE_RECTS 4
+
+// The regions of the screen that changed (are damaged) since the last frame, and must be drawn again.
+// Overlapping or touching rectangles are merged as they are added.
+class DamageRegion {
+public:
+	void add(const int x, const int y, const int width, const int height);
+	void add(const SDL_Rect& rect) { add(rect.x, rect.y, rect.w, rect.h); }
+	void clear() { rects_.clear(); }
+
+	// Removes anything outside of 0, 0, width, height (such as the screen).
+	void clip(const int width, const int height);
+
+	bool empty() const { return rects_.empty(); }
+	const std::vector<SDL_Rect>& rects() const { return rects_; }
+	int64_t area() const;
+
+protected:
+	std::vector<SDL_Rect> rects_;
+};
+
+} // namespace Blocks
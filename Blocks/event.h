@@ -71,7 +71,7 @@ public:
 	bool sendEvent(const size_t id, BlockEvent event) {
 		event.origin_id = id;
 		if (!event_queue_.trySend(event)) {
-			arc::log::Error("EventQueue", "Event queue full!");
+			ARC_LOG_ERROR_LIMITED("EventQueue", "Event queue full!");
 			return false;
 		}
 		return true;
@@ -17,7 +17,7 @@ void ExpandingVisual::draw() {
 	} else if (props_.ondraw_func != nullptr) {
 		props_.ondraw_func(width_, height_);
 	} else if (!drawn) {
-		log::Error("ExpandingVisual", "Attempted to draw a null expanding visual");
+		ARC_LOG_ERROR("ExpandingVisual", "Attempted to draw a null expanding visual");
 	}
 }
 
@@ -17,11 +17,13 @@ public:
 		bool sprite_tile_mode = true; // Otherwise, it will stretch the sprite to the available size
 	};
 
-	ExpandingVisual(const Properties& props, const ExpandingProperties& ex_props) : ExpandingDrawable(ex_props), props_(props) {}
+	ExpandingVisual(const Properties& props, const ExpandingProperties& ex_props) : ExpandingDrawable(ex_props), props_(props) {
+		tracked_ = props.ondraw_func == nullptr; // Otherwise drawn again every frame.
+	}
 
 	void draw() override; // Coordinates to draw
 
-	void setBackgroundColor(const Color& bg_color) { props_.background_color = bg_color; }
+	void setBackgroundColor(const Color& bg_color) { props_.background_color = bg_color; markDirty(); }
 
 protected:
 	Properties props_;
@@ -3,6 +3,7 @@
 #include <numeric>
 
 #include "manager.h"
+#include "../arc/trace.h"
 
 namespace Blocks {
 
@@ -44,6 +45,7 @@ unsigned int LevelGenerator::seedRandomGenerator(unsigned int seed) {
 }
 
 void LevelGenerator::generateLevelFromTemplate(const size_t id) {
+	ARC_TRACE_SCOPE("LevelGenerator::generateLevelFromTemplate");
 	if (id > levels_.size()) return; // TODO: Print error here?
 
 	LevelTemplate* lt = levels_[id];
@@ -191,7 +193,7 @@ void LevelGenerator::AddElementAtPos(const size_t element_id, int x, int y, cons
 	const size_t event_id = manager.RegisterEventable(*mv);
 
 	if (active_blocks_.count(event_id) != 0) {
-		log::Error("LevelGenerator", "Duplicate event id returned from register eventable? Was this block already deleted?");
+		ARC_LOG_ERROR("LevelGenerator", "Duplicate event id returned from register eventable? Was this block already deleted?");
 	}
 
 	const int x_off = element->cell_x_offset;
@@ -326,7 +328,7 @@ void LevelGenerator::action(BlockAction a) {
 		replaceBlock(a.sender.id, a.id);
 		break;
 	default:
-		log::Error("LevelGenerator", "Unhandled generate event type!");
+		ARC_LOG_ERROR("LevelGenerator", "Unhandled generate event type!");
 		break;
 	}
 }
@@ -1,5 +1,7 @@
 #include "manager.h"
 
+#include "../arc/trace.h"
+
 namespace Blocks {
 
 Manager manager;
@@ -15,7 +17,7 @@ Manager::~Manager() {
 
 // TODO: Multiple windows/screens on desktop.
 void Manager::Init(ExpandingInteractive& main_canvas_or_scene, const ScreenProperties& props) {
-	if (!graphics.Init()) {
+	if (!graphics.Init(props.type == SCREEN_HEADLESS)) {
 		log::Fatal("Blocks Manager", "Graphics failed to initialize!");
 	}
 
@@ -76,6 +78,7 @@ void Manager::InterruptEventInternal(InputModule::Event e) {
 
 // This handles events directly from the input module.
 void Manager::EventInternal(InputModule::Event e) {
+	const uint64_t start = profiler_.now();
 	BlockEvent be;
 	switch (e.type) {
 		case InputModule::ScreenResize:
@@ -154,11 +157,14 @@ void Manager::EventInternal(InputModule::Event e) {
 		main_cs_->event(be);
 	}
 
+	profiler_.addPhase(FrameProfiler::Events, start);
+
 	// Process Inter-Block Events Here:
 	ProcessAllBlockEvents();
 }
 
 void Manager::ProcessAllBlockEvents() {
+	ProfileScope probe(profiler_, FrameProfiler::BlockEvents);
 	BlockEvent e;
 	const size_t total_group_count = groups_.size();
 
@@ -166,15 +172,15 @@ void Manager::ProcessAllBlockEvents() {
 		const size_t o_id = e.origin_id;
 		if (o_id == 0) {
 			// Manager itself, which is impossible.
-			log::Error("Blocks Manager", "Event sent to queue with invalid zero id!"); continue;
+			ARC_LOG_ERROR("Blocks Manager", "Event sent to queue with invalid zero id!"); continue;
 		} else if (o_id >= blocks_.size()) {
 			// Since events are never sent from a group id.
-			log::Error("Blocks Manager", "Invalid inter-block event source id: " + string::itoa(o_id)); continue;
+			ARC_LOG_ERROR("Blocks Manager", "Invalid inter-block event source id: " + string::itoa(o_id)); continue;
 		}
 
 		BlockConn* bc = blocks_[o_id];
 		if (bc == nullptr) {
-			log::Error("Blocks Manager", "Event sent to queue from removed/deleted block!"); continue;
+			ARC_LOG_ERROR("Blocks Manager", "Event sent to queue from removed/deleted block!"); continue;
 		}
 
 		std::vector<Connection*>* conns_ = &(bc->conn_from); // All connections from this block ID.
@@ -200,7 +206,7 @@ void Manager::ProcessAllBlockEvents() {
 						continue; // Not active, otherwise OK.
 					}
 				} else {
-					log::Error("Blocks Manager", "Unsupported connection type!"); continue;
+					ARC_LOG_ERROR("Blocks Manager", "Unsupported connection type!"); continue;
 				}
 
 				// Send Action
@@ -214,11 +220,11 @@ void Manager::ProcessAllBlockEvents() {
 						if (c->action_func != nullptr) {
 							c->action_func(e);
 						} else {
-							log::Error("Blocks Manager", "Custom action function missing!");
+							ARC_LOG_ERROR("Blocks Manager", "Custom action function missing!");
 						}
 						continue;
 					} else {
-						log::Error("Blocks Manager",
+						ARC_LOG_ERROR("Blocks Manager",
 							"Invalid action passed to manager: " + string::itoa(c->action)); continue;
 					}
 				} else if (d_id == Connection::ID_SELF) {
@@ -228,14 +234,14 @@ void Manager::ProcessAllBlockEvents() {
 					// Group destination
 					d_id -= Connection::ID_GROUP_OFFSET;
 					if (d_id >= groups_.size() || d_id == 0) { // Group zero is also reserved.
-						log::Error("Blocks Manager",
+						ARC_LOG_ERROR("Blocks Manager",
 							"Invalid inter-block action destination group id: " + string::itoa(d_id)); continue;
 					}
 
 					BlockGroup* group = groups_[d_id];
 
 					if (group == nullptr) {
-						log::Error("Blocks Manager", "Action sent to removed/deleted group!"); return;
+						ARC_LOG_ERROR("Blocks Manager", "Action sent to removed/deleted group!"); return;
 					}
 
 					const size_t g_len = group->blocks.size();
@@ -274,13 +280,13 @@ void Manager::ProcessAllBlockEvents() {
 
 void Manager::SendActionToBlock(const size_t destination_id, Connection* c, const BlockEvent& e) {
 	if (destination_id >= blocks_.size() || destination_id == 0) {
-		log::Error("Blocks Manager",
+		ARC_LOG_ERROR("Blocks Manager",
 			"Invalid inter-block action destination id: " + string::itoa(destination_id)); return;
 	}
 
 	BlockConn* dest_bc = blocks_[destination_id];
 	if (dest_bc == nullptr || dest_bc->block == nullptr) {
-		log::Error("Blocks Manager", "Action sent to removed/deleted block!"); return;
+		ARC_LOG_ERROR("Blocks Manager", "Action sent to removed/deleted block!"); return;
 	}
 
 	SendActionToBlock(dest_bc->block, c, e);
@@ -347,12 +353,12 @@ void Manager::SendActionToBlock(Eventable* block, Connection* c, const BlockEven
 				block->toggle_enabled();
 				break;
 			default:
-				log::Error("Blocks Manager", "Unknown block-specific action!");
+				ARC_LOG_ERROR("Blocks Manager", "Unknown block-specific action!");
 				break;
 			}
 			break;
 		default:
-			log::Error("Blocks Manager", "Unknown block-specific action!");
+			ARC_LOG_ERROR("Blocks Manager", "Unknown block-specific action!");
 			break;
 		}
 		return; // These actions are done directly without passing to the block.
@@ -371,6 +377,8 @@ void Manager::Draw(const double frame_delta_time_msec) {
 
 // This handles the frame_draw from the input module's event loop.
 void Manager::DrawInternal(const double frame_delta_time_msec) {
+	ARC_TRACE_SCOPE("Manager::DrawInternal");
+	ProfileFrameScope frame_probe(profiler_);
 	if (!active_.load(std::memory_order_relaxed)) return;
 
 	frame_delta_time_msec_ = frame_delta_time_msec;
@@ -381,29 +389,83 @@ void Manager::DrawInternal(const double frame_delta_time_msec) {
 	for (size_t i = 0; i < len; i++) {
 		FrameProcessor* fp = frame_processors_[i];
 		if (fp != nullptr) {
+			const uint64_t start = profiler_.now();
 			fp->frame(frame_delta_time_msec);
+			profiler_.addProcessor(i, fp, start);
 		}
 	}
 
 	if (!active_.load(std::memory_order_relaxed)) return;
 
 	render.ClearDrawOffset(); // As the main canvas fills the entire screen.
-	render.Clear(white);
-
-	main_cs_->draw();
+	{
+		ProfileScope probe(profiler_, FrameProfiler::Draw);
+		if (retained_rendering_ && SDL_RenderTargetSupported(main_screen_->renderer())) {
+			DrawDamaged();
+		} else {
+			render.Clear(white);
+			main_cs_->draw();
+		}
+	}
 
 	if (!active_.load(std::memory_order_relaxed)) return;
 
-	render.RenderFrameDone();
+	{
+		ProfileScope probe(profiler_, FrameProfiler::Present);
+		render.RenderFrameDone();
+	}
+}
+
+void Manager::DrawDamaged() {
+	const int width = main_screen_->width();
+	const int height = main_screen_->height();
+
+	if (frame_sprite_ == nullptr || frame_sprite_->width() != width || frame_sprite_->height() != height) {
+		if (frame_sprite_ != nullptr) {
+			render.DeleteSprite(*frame_sprite_);
+		}
+		frame_sprite_ = &render.CreateBlankSpriteForRendering(width, height);
+		redraw_all_ = true;
+	}
+	if (render_targets_lost_ != render.RenderTargetsLostCount()) {
+		render_targets_lost_ = render.RenderTargetsLostCount();
+		redraw_all_ = true;
+	}
+
+	damage_.clear();
+	main_cs_->collectDamage(damage_, 0, 0); // Also clears the dirty state.
+	damage_.clip(width, height);
+
+	// One pass is faster when most of the screen changed.
+	if (redraw_all_ || damage_.area() * 4 > int64_t(width) * int64_t(height) * 3) {
+		damage_.clear();
+		damage_.add(0, 0, width, height);
+		redraw_all_ = false;
+	}
+
+	if (!damage_.empty()) {
+		render.SetSpriteContext(*frame_sprite_);
+		for (const SDL_Rect& r : damage_.rects()) {
+			render.SetClipRect(r.x, r.y, r.w, r.h);
+			render.DrawRect(r.x, r.y, r.w, r.h, white); // Instead of Clear, which ignores the clip rect.
+			main_cs_->draw();
+			render.ClearDrawOffset();
+		}
+		render.ClearSpriteContext();
+	}
+
+	render.DrawSprite(*frame_sprite_);
 }
 
-void Manager::AddFrameProcessor(FrameProcessor& proc) {
-	addtoslotvectorindex(frame_processors_, &proc);
+void Manager::AddFrameProcessor(FrameProcessor& proc, const string& name) {
+	const size_t index = addtoslotvectorindex(frame_processors_, &proc);
+	profiler_.setProcessorName(index, &proc, name);
 }
 
 void Manager::RemoveFrameProcessor(FrameProcessor& proc) {
 	// Don't delete as the frame processor object is not owned here, and may be re-used or re-added later on.
 	deletefromslotvector(frame_processors_, &proc, false);
+	profiler_.removeProcessor(&proc);
 }
 
 // To allow this block to participate in the event connection system.
@@ -542,15 +604,15 @@ size_t Manager::AddEventActionConnection(const Connection& conn) {
 		(o >= bc_len && !(o >= Connection::ID_GROUP_OFFSET && (o - Connection::ID_GROUP_OFFSET) < groups_.size())) ||
 		(d >= bc_len && !(d >= Connection::ID_GROUP_OFFSET && (d - Connection::ID_GROUP_OFFSET) < groups_.size())
 			&& d != Connection::ID_SELF)) {
-		log::Error("Invalid connection added to manager (invalid origin/destination)!");
+		ARC_LOG_ERROR("Invalid connection added to manager (invalid origin/destination)!");
 		return -1; // TODO: Should connection zero be returned/reserved instead?
 	}
 
 	if (conn.type == Connection::IfFunc && conn.test_func == nullptr) {
-		log::Error("Blocks Manager", "Invalid IfFunc connection - no test function!"); return -1;
+		ARC_LOG_ERROR("Blocks Manager", "Invalid IfFunc connection - no test function!"); return -1;
 	}
 	if (conn.type == Connection::IfVar && conn.test_var == nullptr) {
-		log::Error("Blocks Manager", "Invalid IfFunc connection - no test function!"); return -1;
+		ARC_LOG_ERROR("Blocks Manager", "Invalid IfFunc connection - no test function!"); return -1;
 	}
 
 	Connection* c = new Connection(conn);
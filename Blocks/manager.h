@@ -5,6 +5,7 @@
 
 #include "block.h"
 #include "canvas.h"
+#include "profiler.h"
 #include "scene.h"
 
 namespace Blocks {
@@ -76,7 +77,8 @@ public:
 	static void Draw(const double frame_delta_time_msec);
 
 	// Add FrameProcessors here, as they are run before draw() on the main canvas is called, but after event processing.
-	void AddFrameProcessor(FrameProcessor& proc);
+	// The name is only shown by the profiler.
+	void AddFrameProcessor(FrameProcessor& proc, const string& name = string());
 	void RemoveFrameProcessor(FrameProcessor& proc);
 	
 	// To allow this block to participate in the event connection system.
@@ -104,10 +106,18 @@ public:
 	void SetAppToBackgroundHandler(StateHandler onbackground_func) { onbackground_ = onbackground_func; }
 	void SetAppToForegroundHandler(StateHandler onforeground_func) { onforeground_ = onforeground_func; }
 
+	// When enabled (the default), the frame is kept in a render sprite, and only the regions that
+	// changed (see Drawable::markDirty) are drawn again. Otherwise everything is drawn every frame.
+	void SetRetainedRendering(const bool enabled) { retained_rendering_ = enabled; redraw_all_ = true; }
+	void RedrawAll() { redraw_all_ = true; } // Next frame only, such as after changes that aren't tracked.
+
 	Screen* MainScreen() { return main_screen_; }
 	double GetFrameDeltaTime() { return frame_delta_time_msec_; } // Time since last frame.
 	uint32_t GetFrameCount() { return frame_count_; }
 
+	// Times each phase of the frames (and each frame processor), when enabled. See ProfilerOverlay.
+	FrameProfiler& Profiler() { return profiler_; }
+
 protected:
 	DELETE_COPY_AND_ASSIGN(Manager);
 
@@ -116,6 +126,7 @@ protected:
 	void InterruptEventInternal(InputModule::Event e); // Thread Safe
 
 	void DrawInternal(const double frame_delta_time_msec);
+	void DrawDamaged(); // Retained rendering, see SetRetainedRendering
 
 	void ProcessAllBlockEvents();
 
@@ -162,6 +173,15 @@ protected:
 
 	double frame_delta_time_msec_ = 0.0;
 	uint32_t frame_count_ = 0;
+
+	// Retained rendering:
+	Sprite* frame_sprite_ = nullptr; // NOT Owned (owned by the RenderModule)
+	DamageRegion damage_;
+	uint32_t render_targets_lost_ = 0;
+	bool retained_rendering_ = true;
+	bool redraw_all_ = true;
+
+	FrameProfiler profiler_;
 };
 
 extern Manager manager;
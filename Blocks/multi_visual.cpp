@@ -93,7 +93,7 @@ void MultiVisual::action(BlockAction a) {
 		lastStep();
 		break;
 	default:
-		log::Error("MultiVisual", "Unhandled step event type!");
+		ARC_LOG_ERROR("MultiVisual", "Unhandled step event type!");
 		break;
 	}
 }
@@ -128,4 +128,19 @@ void MultiVisual::draw() {
 	}
 }
 
+bool MultiVisual::isDirty() const {
+	const MultiVisualStep& step = props_.steps[cur_step_];
+	return Drawable::isDirty() || cur_step_ != drawn_step_ || step.n_frames != 0 ||
+		(step.visual != nullptr && step.visual->isDirty());
+}
+
+void MultiVisual::clearDirty() {
+	Drawable::clearDirty();
+	drawn_step_ = cur_step_;
+	Drawable* d = props_.steps[cur_step_].visual;
+	if (d != nullptr) {
+		d->clearDirty();
+	}
+}
+
 } // namespace Blocks
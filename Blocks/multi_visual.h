@@ -43,6 +43,7 @@ public:
 			props_.event_w = props.width;
 			props_.event_h = props.height;
 		}
+		tracked_ = true;
 	}
 	~MultiVisual() {}
 
@@ -65,11 +66,15 @@ public:
 	void action(BlockAction a) override;
 
 	void draw() override;
+	// Also when the step changed, is timed, or its visual changed.
+	bool isDirty() const override;
+	void clearDirty() override;
 
 protected:
 	Properties props_;
 
 	size_t cur_step_ = 0;
+	size_t drawn_step_ = 0;
 	size_t cur_step_frames_ = 0; // Number of frames of this step that have been drawn already.
 	uint32_t last_manager_frame_count_ = 0; // To prevent duplicate frame updates.
 };
@@ -33,6 +33,7 @@ namespace Blocks {
 ParallaxScrollGroup::ParallaxScrollGroup(ScrollCanvas& first_canvas) 
 	: ExpandingInteractive(first_canvas.getExpandingProperties()) {
 	canvases_.push_back(SCFactor(first_canvas, 1.0));
+	tracked_ = true;
 }
 
 void ParallaxScrollGroup::addCanvasWithFactor(ScrollCanvas& canvas, const float scroll_factor) {
@@ -99,7 +100,7 @@ void ParallaxScrollGroup::action(BlockAction a) {
 			resumeScroll();
 			break;
 		default:
-			log::Error("ParallaxScrollGroup", "Unhandled scroll event type!");
+			ARC_LOG_ERROR("ParallaxScrollGroup", "Unhandled scroll event type!");
 			break;
 		}
 	} else {
@@ -116,6 +117,20 @@ void ParallaxScrollGroup::draw() {
 	PS_FOR_ALL_CANVASES_REVERSE(draw);
 }
 
+void ParallaxScrollGroup::collectDamage(DamageRegion& damage, const int x, const int y) {
+	if (isDirty()) {
+		damage.add(x, y, width_, height_);
+	}
+	clearDirty();
+	const size_t len = canvases_.size();
+	for (size_t i = 0; i < len; i++) {
+		ScrollCanvas* sc = canvases_[i].canvas;
+		if (sc != nullptr) {
+			sc->collectDamage(damage, x, y);
+		}
+	}
+}
+
 void ParallaxScrollGroup::onResize() {
 	PS_FOR_ALL_CANVASES_2(setDrawableArea, width_, height_);
 }
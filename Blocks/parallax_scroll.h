@@ -25,6 +25,7 @@ public:
 	void event(BlockEvent e) override;
 	void action(BlockAction a) override;
 	void draw() override;
+	void collectDamage(DamageRegion& damage, const int x, const int y) override;
 
 protected:
 	void onResize() override;
@@ -0,0 +1,278 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace Blocks {
+
+//
+// FrameProfiler
+//
+
+static const char* phase_names[FrameProfiler::PhaseCount] = { "events", "block events", "processors", "draw", "present" };
+
+const char* FrameProfiler::phaseName(const Phase phase) {
+	return phase < PhaseCount ? phase_names[phase] : "invalid";
+}
+
+FrameProfiler::FrameProfiler() {
+	for (size_t p = 0; p < PhaseCount; p++) {
+		current_.phase_msec[p] = 0.0f;
+	}
+	frames_.resize(MAX_PROFILE_FRAMES, current_);
+}
+
+void FrameProfiler::setEnabled(const bool enabled) {
+	if (enabled && ticks_per_msec_ == 0.0) {
+		ticks_per_msec_ = double(SDL_GetPerformanceFrequency()) / 1000.0;
+	}
+	enabled_ = enabled;
+}
+
+void FrameProfiler::addPhase(const Phase phase, const uint64_t start) {
+	if (start == 0) return; // Disabled when started.
+	current_.phase_msec[phase] += float(double(SDL_GetPerformanceCounter() - start) / ticks_per_msec_);
+}
+
+void FrameProfiler::addProcessor(const size_t index, const FrameProcessor* processor, const uint64_t start) {
+	if (start == 0) return;
+	const float msec = float(double(SDL_GetPerformanceCounter() - start) / ticks_per_msec_);
+	current_.phase_msec[Processors] += msec;
+
+	if (index >= processors_.size()) {
+		processors_.resize(index + 1);
+	}
+	ProcessorTimes& times = processors_[index];
+	if (times.processor != processor) { // Added without a name.
+		setProcessorName(index, processor, string());
+	}
+	times.current_msec += msec;
+}
+
+void FrameProfiler::setProcessorName(const size_t index, const FrameProcessor* processor, const string& name) {
+	if (index >= processors_.size()) {
+		processors_.resize(index + 1);
+	}
+	ProcessorTimes& times = processors_[index];
+	times.processor = processor;
+	times.name = name.empty() ? "processor " + string::itoa(index) : name;
+	times.current_msec = 0.0f;
+	times.msec.assign(MAX_PROFILE_FRAMES, 0.0f);
+}
+
+void FrameProfiler::removeProcessor(const FrameProcessor* processor) {
+	for (ProcessorTimes& times : processors_) {
+		if (times.processor == processor) {
+			times.processor = nullptr;
+			times.msec.clear();
+		}
+	}
+}
+
+void FrameProfiler::endFrame() {
+	if (!enabled_) {
+		last_frame_end_ = 0;
+		return;
+	}
+	const uint64_t end = SDL_GetPerformanceCounter();
+	frame_number_++;
+
+	current_.work_msec = 0.0f;
+	for (size_t p = 0; p < PhaseCount; p++) {
+		current_.work_msec += current_.phase_msec[p];
+	}
+	current_.total_msec = last_frame_end_ != 0 ? float(double(end - last_frame_end_) / ticks_per_msec_) : current_.work_msec;
+	last_frame_end_ = end;
+
+	frames_[next_] = current_;
+	for (ProcessorTimes& times : processors_) {
+		if (times.processor != nullptr) {
+			times.msec[next_] = times.current_msec;
+			times.current_msec = 0.0f;
+		}
+	}
+	next_ = (next_ + 1) % MAX_PROFILE_FRAMES;
+	if (count_ < MAX_PROFILE_FRAMES) {
+		count_++;
+	}
+
+	if (current_.work_msec > budget_msec_) {
+		FindOverBudget(current_);
+	}
+
+	for (size_t p = 0; p < PhaseCount; p++) {
+		current_.phase_msec[p] = 0.0f;
+	}
+}
+
+// Names the slowest processor if it took most of the processors phase, otherwise the slowest phase.
+void FrameProfiler::FindOverBudget(const Frame& f) {
+	size_t slowest_phase = 0;
+	for (size_t p = 1; p < PhaseCount; p++) {
+		if (f.phase_msec[p] > f.phase_msec[slowest_phase]) {
+			slowest_phase = p;
+		}
+	}
+	string name = phaseName(Phase(slowest_phase));
+	float msec = f.phase_msec[slowest_phase];
+
+	if (slowest_phase == Processors) {
+		const ProcessorTimes* slowest = nullptr;
+		const size_t index = Index(0);
+		for (const ProcessorTimes& times : processors_) {
+			if (times.processor != nullptr && (slowest == nullptr || times.msec[index] > slowest->msec[index])) {
+				slowest = &times;
+			}
+		}
+		if (slowest != nullptr && slowest->msec[index] * 2.0f > msec) {
+			name = slowest->name;
+			msec = slowest->msec[index];
+		}
+	}
+
+	char buffer[32];
+	snprintf(buffer, sizeof(buffer), " %.2f ms", msec);
+	last_over_budget_ = name + buffer;
+	last_over_budget_frame_ = frame_number_;
+}
+
+const FrameProfiler::Frame& FrameProfiler::frame(const size_t age) const {
+	return frames_[Index(age)];
+}
+
+double FrameProfiler::phasePercentile(const Phase phase, const double percent) const {
+	if (count_ == 0) return 0.0;
+	scratch_.resize(count_);
+	for (size_t i = 0; i < count_; i++) {
+		scratch_[i] = frame(i).phase_msec[phase];
+	}
+	const size_t index = min(size_t(double(count_ - 1) * min(max(percent, 0.0), 100.0) / 100.0 + 0.5), count_ - 1);
+	std::nth_element(scratch_.begin(), scratch_.begin() + index, scratch_.end());
+	return scratch_[index];
+}
+
+double FrameProfiler::phaseMax(const Phase phase) const {
+	float longest = 0.0f;
+	for (size_t i = 0; i < count_; i++) {
+		longest = max(longest, frame(i).phase_msec[phase]);
+	}
+	return longest;
+}
+
+size_t FrameProfiler::framesOverBudget() const {
+	size_t over = 0;
+	for (size_t i = 0; i < count_; i++) {
+		if (frame(i).work_msec > budget_msec_) over++;
+	}
+	return over;
+}
+
+double FrameProfiler::processorMsec(const size_t index, const size_t age) const {
+	if (!hasProcessor(index) || age >= count_) return 0.0;
+	return processors_[index].msec[Index(age)];
+}
+
+double FrameProfiler::processorMax(const size_t index) const {
+	if (!hasProcessor(index)) return 0.0;
+	float longest = 0.0f;
+	for (size_t i = 0; i < count_; i++) {
+		longest = max(longest, processors_[index].msec[Index(i)]);
+	}
+	return longest;
+}
+
+//
+// ProfilerOverlay
+//
+
+Color ProfilerOverlay::phaseColor(const FrameProfiler::Phase phase) {
+	switch (phase) {
+	case FrameProfiler::Events: return Color(0x4080FF);
+	case FrameProfiler::BlockEvents: return Color(0x40E0E0);
+	case FrameProfiler::Processors: return Color(0xFFA020);
+	case FrameProfiler::Draw: return Color(0x40E040);
+	case FrameProfiler::Present: return Color(0xE040E0);
+	default: return gray;
+	}
+}
+
+static string FormatMsec(const double msec) {
+	char buffer[16];
+	snprintf(buffer, sizeof(buffer), "%.2f", msec);
+	return string(buffer);
+}
+
+int ProfilerOverlay::DrawTextLine(const string& text, const int x, const int y) {
+	int w, h;
+	render.GetPixelTextSize(text, props_.pixel_font_id, w, h);
+	render.DrawPixelText(text, props_.pixel_font_id, x, y);
+	return y + h + 2;
+}
+
+void ProfilerOverlay::draw() {
+	if (!props_.background_color.is_transparent()) {
+		render.DrawRect(width_, height_, props_.background_color);
+	}
+	if (profiler_.frameCount() == 0) return;
+
+	const FrameProfiler::Frame& last = profiler_.frame(0);
+	int y = 2;
+	y = DrawTextLine("frame " + FormatMsec(last.total_msec) + " work " + FormatMsec(last.work_msec) + " budget "
+		+ FormatMsec(profiler_.budgetMsec()) + " over " + string::itoa(profiler_.framesOverBudget()), 2, y);
+
+	// Each phase with its color, the median and the max:
+	int w, line_h;
+	render.GetPixelTextSize("0", props_.pixel_font_id, w, line_h);
+	for (size_t p = 0; p < FrameProfiler::PhaseCount; p++) {
+		const FrameProfiler::Phase phase = FrameProfiler::Phase(p);
+		render.DrawRect(2, y, line_h, line_h, phaseColor(phase));
+		y = DrawTextLine(string(FrameProfiler::phaseName(phase)) + " " + FormatMsec(profiler_.phasePercentile(phase, 50.0))
+			+ " max " + FormatMsec(profiler_.phaseMax(phase)), line_h + 6, y);
+	}
+
+	// The slowest frame processors (by the max of the kept frames):
+	slowest_.clear();
+	for (size_t i = 0; i < profiler_.processorCount(); i++) {
+		if (profiler_.hasProcessor(i)) slowest_.push_back(i);
+	}
+	const FrameProfiler& profiler = profiler_;
+	std::sort(slowest_.begin(), slowest_.end(), [&profiler](const size_t a, const size_t b) {
+		return profiler.processorMax(a) > profiler.processorMax(b);
+	});
+	for (size_t i = 0; i < slowest_.size() && i < props_.max_processors; i++) {
+		const size_t index = slowest_[i];
+		y = DrawTextLine(profiler_.processorName(index) + " " + FormatMsec(profiler_.processorMsec(index, 0))
+			+ " max " + FormatMsec(profiler_.processorMax(index)), 2, y);
+	}
+
+	if (!profiler_.lastOverBudget().empty()) {
+		y = DrawTextLine("over budget " + profiler_.lastOverBudget(), 2, y);
+	}
+
+	if (y + 8 < height_) {
+		DrawGraph(y + 2, height_ - y - 4);
+	}
+}
+
+// Stacked bars of the phases of each frame, oldest on the left, with the budget at 2/3 of the height.
+void ProfilerOverlay::DrawGraph(const int y, const int height) {
+	const int bar_width = max(1, (width_ - 4) / MAX_PROFILE_FRAMES);
+	const double px_per_msec = (double(height) * 2.0 / 3.0) / profiler_.budgetMsec();
+	const int bottom = y + height;
+	const size_t frames = min(profiler_.frameCount(), size_t((width_ - 4) / bar_width));
+
+	for (size_t i = 0; i < frames; i++) {
+		const FrameProfiler::Frame& f = profiler_.frame(frames - 1 - i);
+		const int x = 2 + int(i) * bar_width;
+		int bar_top = bottom;
+		for (size_t p = 0; p < FrameProfiler::PhaseCount && bar_top > y; p++) {
+			const int h = min(int(f.phase_msec[p] * px_per_msec + 0.5), bar_top - y);
+			if (h <= 0) continue;
+			bar_top -= h;
+			render.DrawRect(x, bar_top, bar_width, h, phaseColor(FrameProfiler::Phase(p)));
+		}
+	}
+	render.DrawRect(2, bottom - int(double(height) * 2.0 / 3.0), width_ - 4, 1, red);
+}
+
+} // namespace Blocks
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <vector>
+
+#include "block.h"
+
+namespace Blocks {
+
+// Frames kept by the FrameProfiler (2 seconds at 60 fps).
+#define MAX_PROFILE_FRAMES 120
+
+// Times each phase of the Manager's frames, and each frame processor, for the last
+// MAX_PROFILE_FRAMES frames, to find out what took too long. Disabled by default, then the probes
+// don't read the clock at all. Only used on the main (event loop) thread.
+class FrameProfiler {
+public:
+	enum Phase {
+		Events = 0, // Input events, and passing them to the blocks.
+		BlockEvents, // Inter-block events and connections (ProcessAllBlockEvents)
+		Processors, // All frame processors
+		Draw, // The main canvas (or scene)
+		Present, // RenderFrameDone
+		PhaseCount
+	};
+	static const char* phaseName(const Phase phase);
+
+	struct Frame {
+		float phase_msec[PhaseCount];
+		float work_msec = 0.0f; // All of the phases.
+		float total_msec = 0.0f; // Since the previous frame ended (including waiting for this one).
+	};
+
+	FrameProfiler();
+
+	void setEnabled(const bool enabled);
+	bool enabled() const { return enabled_; }
+	// Frames with more work than this are counted as over budget.
+	void setBudgetMsec(const double msec) { budget_msec_ = msec; }
+	double budgetMsec() const { return budget_msec_; }
+
+	// Probes: start is from now(), which is 0 when disabled (then these do nothing).
+	uint64_t now() const { return enabled_ ? SDL_GetPerformanceCounter() : 0; }
+	void addPhase(const Phase phase, const uint64_t start);
+	void addProcessor(const size_t index, const FrameProcessor* processor, const uint64_t start);
+	void endFrame();
+
+	// Processors are kept by their index in the Manager, with an optional name to show.
+	void setProcessorName(const size_t index, const FrameProcessor* processor, const string& name);
+	void removeProcessor(const FrameProcessor* processor);
+
+	size_t frameCount() const { return count_; }
+	const Frame& frame(const size_t age) const; // 0 is the most recent frame.
+	double phasePercentile(const Phase phase, const double percent) const; // Of all kept frames.
+	double phaseMax(const Phase phase) const;
+	size_t framesOverBudget() const; // Of all kept frames.
+
+	size_t processorCount() const { return processors_.size(); }
+	bool hasProcessor(const size_t index) const { return index < processors_.size() && processors_[index].processor != nullptr; }
+	const string& processorName(const size_t index) const { return processors_[index].name; }
+	double processorMsec(const size_t index, const size_t age) const;
+	double processorMax(const size_t index) const;
+
+	// What took the longest in the most recent frame over budget (empty if none yet), and its frame number.
+	const string& lastOverBudget() const { return last_over_budget_; }
+	uint64_t lastOverBudgetFrame() const { return last_over_budget_frame_; }
+
+protected:
+	size_t Index(const size_t age) const { return (next_ + MAX_PROFILE_FRAMES - 1 - age) % MAX_PROFILE_FRAMES; }
+	void FindOverBudget(const Frame& f);
+
+	struct ProcessorTimes {
+		const FrameProcessor* processor = nullptr; // NOT Owned
+		string name;
+		float current_msec = 0.0f;
+		std::vector<float> msec; // Same index as frames_
+	};
+
+	std::vector<Frame> frames_; // Ring buffer, next_ is the oldest when full.
+	size_t next_ = 0;
+	size_t count_ = 0;
+	Frame current_;
+	std::vector<ProcessorTimes> processors_;
+
+	double ticks_per_msec_ = 0.0; // Set when enabled, as SDL may not be initialized before.
+	double budget_msec_ = 1000.0 / 60.0;
+	uint64_t last_frame_end_ = 0;
+	uint64_t frame_number_ = 0;
+	uint64_t last_over_budget_frame_ = 0;
+	string last_over_budget_;
+	bool enabled_ = false;
+
+	mutable std::vector<float> scratch_; // For phasePercentile
+};
+
+// Adds the time until the end of the scope to the phase.
+class ProfileScope {
+public:
+	ProfileScope(FrameProfiler& profiler, const FrameProfiler::Phase phase)
+		: profiler_(profiler), phase_(phase), start_(profiler.now()) {}
+	~ProfileScope() { profiler_.addPhase(phase_, start_); }
+
+private:
+	DELETE_COPY_AND_ASSIGN(ProfileScope);
+
+	FrameProfiler& profiler_;
+	const FrameProfiler::Phase phase_;
+	const uint64_t start_;
+};
+
+// Ends the profiler's frame when it goes out of scope, so every exit path of a frame ends it.
+class ProfileFrameScope {
+public:
+	explicit ProfileFrameScope(FrameProfiler& profiler) : profiler_(profiler) {}
+	~ProfileFrameScope() { profiler_.endFrame(); }
+
+private:
+	DELETE_COPY_AND_ASSIGN(ProfileFrameScope);
+
+	FrameProfiler& profiler_;
+};
+
+// Shows the frame profiler: The time of each phase over the last frames as a stacked graph (with
+// the budget as a line), and the slowest phases and frame processors as pixel text.
+// Enables the profiler, and is drawn again every frame.
+class ProfilerOverlay : public Drawable {
+public:
+	struct Properties {
+		size_t pixel_font_id = 0;
+		Color background_color = Color(0xC0, 0, 0, 0);
+		size_t max_processors = 4; // The slowest ones are listed.
+	};
+
+	ProfilerOverlay(FrameProfiler& profiler, const int width, const int height)
+		: ProfilerOverlay(profiler, Properties(), width, height) {}
+	ProfilerOverlay(FrameProfiler& profiler, const Properties& props, const int width, const int height)
+		: Drawable(width, height), profiler_(profiler), props_(props) {
+		profiler_.setEnabled(true);
+	}
+
+	void draw() override;
+
+	static Color phaseColor(const FrameProfiler::Phase phase);
+
+protected:
+	// Returns the y for the next line.
+	int DrawTextLine(const string& text, const int x, const int y);
+	void DrawGraph(const int y, const int height);
+
+	FrameProfiler& profiler_; // NOT Owned
+	Properties props_;
+	std::vector<size_t> slowest_;
+};
+
+} // namespace Blocks
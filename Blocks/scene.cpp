@@ -12,7 +12,7 @@ void Scene::setScene(const size_t id) {
 		// In case resizes occured between scenes.
 		onResize();
 	} else {
-		log::Error("Scene", "Tried to set the scene to an invalid id: " + string::itoa(id));
+		ARC_LOG_ERROR("Scene", "Tried to set the scene to an invalid id: " + string::itoa(id));
 	}
 }
 
@@ -33,7 +33,7 @@ void Scene::action(BlockAction a) {
 			if (cur_scene_ > 0) {
 				setScene(cur_scene_ - 1);
 			} else {
-				log::Error("Scene", "Tried to go to a previous scene when already at the first scene!");
+				ARC_LOG_ERROR("Scene", "Tried to go to a previous scene when already at the first scene!");
 			}
 			break;
 		case BlockAction::FirstStep:
@@ -43,7 +43,7 @@ void Scene::action(BlockAction a) {
 			setScene(scenes_.size() - 1);
 			break;
 		default:
-			log::Error("Scene", "Unhandled step/scene event type!");
+			ARC_LOG_ERROR("Scene", "Unhandled step/scene event type!");
 			break;
 		}
 	} else {
@@ -56,4 +56,17 @@ void Scene::draw() {
 	scenes_[cur_scene_]->draw();
 }
 
+void Scene::collectDamage(DamageRegion& damage, const int x, const int y) {
+	if (cur_scene_ != drawn_scene_) {
+		drawn_scene_ = cur_scene_;
+		markDirty();
+	}
+	if (isDirty()) {
+		damage.add(x, y, width_, height_);
+	}
+	clearDirty();
+
+	scenes_[cur_scene_]->collectDamage(damage, x, y);
+}
+
 } // namespace Blocks
@@ -9,6 +9,7 @@ class Scene : public ExpandingInteractive {
 public:
 	Scene(Canvas& first_scene_canvas, const ExpandingProperties& ex_props) : ExpandingInteractive(ex_props) {
 		scenes_.push_back(&first_scene_canvas);
+		tracked_ = true;
 	}
 
 	size_t addScene(Canvas& scene_canvas) { scenes_.push_back(&scene_canvas); return (scenes_.size() - 1); }
@@ -22,6 +23,7 @@ public:
 	void event(BlockEvent e) override;
 	void action(BlockAction a) override;
 	void draw() override;
+	void collectDamage(DamageRegion& damage, const int x, const int y) override;
 
 protected:
 	void onResize() override;
@@ -30,6 +32,7 @@ protected:
 	std::vector<Canvas*> scenes_;
 
 	size_t cur_scene_ = 0;
+	size_t drawn_scene_ = 0;
 };
 
 } // namespace Blocks
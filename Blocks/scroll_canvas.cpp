@@ -38,6 +38,7 @@ void ScrollCanvas::removeScrollBlock(Drawable& block) { // Works for all types.
 					}
 				}
 			}
+			AddRemovedDamage(be);
 			delete be; // Don't need the block element anymore, although the block itself is not deleted.
 			return;
 		}
@@ -60,6 +61,7 @@ void ScrollCanvas::removeScrollBlock(BlockElement* block_element) {
 					}
 				}
 			}
+			AddRemovedDamage(be);
 			delete be; // Don't need the block element anymore, although the block itself is not deleted.
 			return;
 		}
@@ -176,13 +178,13 @@ void ScrollCanvas::action(BlockAction a) {
 			resumeScroll();
 			break;
 		default:
-			log::Error("ScrollCanvas", "Unhandled scroll event type!");
+			ARC_LOG_ERROR("ScrollCanvas", "Unhandled scroll event type!");
 			break;
 		}
 	} else if (a.is_movement()) {
 		BlockElement* be = (BlockElement*)a.data;
 		if (be == nullptr) {
-			log::Error("ScrollCanvas", "Movement action received with null data!"); return;
+			ARC_LOG_ERROR("ScrollCanvas", "Movement action received with null data!"); return;
 		}
 
 		// TODO: Check that this block is actually in this canvas + is a scroll element?
@@ -233,10 +235,13 @@ void ScrollCanvas::GetScrollCoords(BlockElement* be, const Drawable* d, int& x,
 }
 
 void ScrollCanvas::draw() {
+	if (render.IsClippedOut(0, 0, width_, height_)) return; // Not on screen (or outside of the parent canvas).
+
 	const size_t len = sc_drawables_.size();
 
 	int off_x, off_y, x, y, xw, yh;
 	render.GetDrawOffset(off_x, off_y); // In case this is a sub-canvas.
+	render.PushClip(0, 0, width_, height_);
 
 	for (size_t i = 0; i < len; i++) {
 		BlockElement* be = sc_drawables_[i];
@@ -244,19 +249,43 @@ void ScrollCanvas::draw() {
 
 		Drawable* d = be->d;
 		if (!d->is_visible()) continue;
+		d->updateSize();
 
 		// Get scrolled to actual coordinates
 		GetScrollCoords(be, d, x, y, xw, yh);
 
-		// Draw if at least partially on-screen.
+		// Draw if at least partially on-screen (inside the clip rect).
 		if (xw > 0 && yh > 0 && x < width_ && y < height_) {
-			render.SetDrawOffset(off_x + x, off_y + y); // TODO: Clipping off of canvas boundaries?
-			d->draw();
+			render.SetDrawOffset(off_x + x, off_y + y);
+			if (!render.IsClippedOut(0, 0, d->width(), d->height())) {
+				d->draw();
+			}
 		}
 	}
 
+	render.SetDrawOffset(off_x, off_y);
 	// TODO: Background color can overlap here!
 	Canvas::draw(); // Draw all non-scrolling objects (above on the top layer).
+	render.PopClip();
+}
+
+void ScrollCanvas::collectDamage(DamageRegion& damage, const int x, const int y) {
+	if (sc_x_ != drawn_sc_x_ || sc_y_ != drawn_sc_y_) {
+		drawn_sc_x_ = sc_x_;
+		drawn_sc_y_ = sc_y_;
+		markDirty();
+	}
+
+	int sx, sy, xw, yh;
+	const size_t len = sc_drawables_.size();
+	for (size_t i = 0; i < len; i++) {
+		BlockElement* be = sc_drawables_[i];
+		if (be == nullptr) continue;
+		GetScrollCoords(be, be->d, sx, sy, xw, yh); // Sets the draw coordinates.
+		CollectElementDamage(be, damage, x, y);
+	}
+
+	Canvas::collectDamage(damage, x, y);
 }
 
 void ScrollCanvas::frame(double frame_delta_time_msec) {
@@ -60,6 +60,8 @@ public:
 	void action(BlockAction a) override;
 	
 	void draw() override;
+	// Everything is damaged when scrolled.
+	void collectDamage(DamageRegion& damage, const int x, const int y) override;
 
 	void frame(double frame_delta_time_msec) override;
 
@@ -82,6 +84,10 @@ protected:
 	int sc_x_ = 0;
 	int sc_y_ = 0;
 
+	// Scroll values when last drawn:
+	int drawn_sc_x_ = 0;
+	int drawn_sc_y_ = 0;
+
 	int wrap_total_x_ = 0;
 	int wrap_total_y_ = 0;
 
@@ -85,7 +85,7 @@ void SoundGenerator::action(BlockAction a) {
 			rewindMusic();
 			break;
 		default:
-			log::Error("SoundGenerator", "Unknown audio action type!");
+			ARC_LOG_ERROR("SoundGenerator", "Unknown audio action type!");
 			break;
 		}
 	}
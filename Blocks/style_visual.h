@@ -42,14 +42,21 @@ public:
 		: Drawable(
 			visual.width() + (props.border_thickness * 2) + props.padding_left + props.padding_right + props.margin_left + props.margin_right,
 			visual.height() + (props.border_thickness * 2) + props.padding_top + props.padding_bottom + props.margin_top + props.margin_bottom),
-		  props_(props), visual_(&visual) {}
+		  props_(props), visual_(&visual) {
+		tracked_ = true;
+	}
 
-	void setBackgroundColor(const Color& bg_color) { props_.background_color = bg_color; }
-	void setBorderColor(const Color& border_color) { props_.border_color = border_color; }
+	void setBackgroundColor(const Color& bg_color) { props_.background_color = bg_color; markDirty(); }
+	void setBorderColor(const Color& border_color) { props_.border_color = border_color; markDirty(); }
 
-	void setVisual(Drawable& visual) { visual_ = &visual; }
+	void setVisual(Drawable& visual) { visual_ = &visual; markDirty(); }
 
 	void draw() override;
+	bool isDirty() const override { return Drawable::isDirty() || (visual_ != nullptr && visual_->isDirty()); }
+	void clearDirty() override {
+		Drawable::clearDirty();
+		if (visual_ != nullptr) visual_->clearDirty();
+	}
 
 protected:
 	Properties props_;
@@ -18,12 +18,12 @@ void VarVisual::draw() {
 
 			buffer_.append(str);
 
-			render.DrawPixelText(buffer_, props_.pixel_font_id);
+			render.DrawPixelTextCached(buffer_, props_.pixel_font_id);
 		} else {
-			render.DrawPixelText(str, props_.pixel_font_id);
+			render.DrawPixelTextCached(str, props_.pixel_font_id);
 		}
 	} else if (!drawn) {
-		log::Error("VarVisual", "Attempted to draw a null VarVisual");
+		ARC_LOG_ERROR("VarVisual", "Attempted to draw a null VarVisual");
 	}
 }
 
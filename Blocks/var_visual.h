@@ -33,15 +33,25 @@ public:
 		if (props.pad_to_length > 0) {
 			buffer_.reserve(props.pad_to_length);
 		}
+		tracked_ = true;
 	}
 
-	void setIntVariable(IntVariable& int_var) { props_.int_var = &int_var; }
-	void setBackgroundColor(const Color& bg_color) { props_.background_color = bg_color; }
+	void setIntVariable(IntVariable& int_var) { props_.int_var = &int_var; markDirty(); }
+	void setBackgroundColor(const Color& bg_color) { props_.background_color = bg_color; markDirty(); }
 
 	void draw() override;
+	// Also when the variable's value changed.
+	bool isDirty() const override {
+		return Drawable::isDirty() || (props_.int_var != nullptr && props_.int_var->value() != drawn_value_);
+	}
+	void clearDirty() override {
+		Drawable::clearDirty();
+		if (props_.int_var != nullptr) drawn_value_ = props_.int_var->value();
+	}
 
 protected:
 	Properties props_;
+	int32_t drawn_value_ = 0;
 
 	string buffer_;
 };
@@ -7,6 +7,26 @@ void Visual::setSprite(Sprite& s) {
 	props_.sprite = &s;
 	width_ = s.width();
 	height_ = s.height();
+	sprite_size_ = true;
+	markDirty();
+}
+
+bool Visual::isDirty() const {
+	return Drawable::isDirty() || (props_.sprite != nullptr && props_.sprite->version() != drawn_sprite_version_);
+}
+
+void Visual::clearDirty() {
+	Drawable::clearDirty();
+	if (props_.sprite != nullptr) {
+		drawn_sprite_version_ = props_.sprite->version();
+	}
+}
+
+void Visual::updateSize() {
+	if (sprite_size_ && props_.sprite != nullptr) {
+		width_ = props_.sprite->width();
+		height_ = props_.sprite->height();
+	}
 }
 
 void Visual::draw() {
@@ -16,13 +36,13 @@ void Visual::draw() {
 		drawn = true;
 	}
 	if (props_.sprite != nullptr) {
-		render.DrawSprite(*props_.sprite);
+		render.DrawSprite(*props_.sprite, 0, 0, props_.tint);
 	} else if (props_.ondraw_func != nullptr) {
 		props_.ondraw_func();
 	} else if (!props_.pixel_text.empty()) {
-		render.DrawPixelText(props_.pixel_text, props_.pixel_font_id);
+		render.DrawPixelTextCached(props_.pixel_text, props_.pixel_font_id);
 	} else if (!drawn) {
-		log::Error("Visual", "Attempted to draw a null visual");
+		ARC_LOG_ERROR("Visual", "Attempted to draw a null visual");
 	}
 }
 
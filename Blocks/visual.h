@@ -16,17 +16,23 @@ public:
 		// This can also be set for a background color drawn first. (Useful for rectangles, etc. as well)
 		Color background_color;
 
-		// TODO: Transform for stretching/scaling/etc. + recolor sprites, etc.
+		// Recolors the sprite when drawn, see RenderModule::DrawSprite. (So many visuals can share one sprite.)
+		Color tint = white;
+
+		// TODO: Transform for stretching/scaling/etc.
 	};
 
 	// Single sprite
 	explicit Visual(Sprite& sprite) : Drawable(sprite.width(), sprite.height()) {
 		props_.sprite = &sprite;
+		sprite_size_ = true;
+		tracked_ = true;
 	}
 
 	// Solid/Background color
 	Visual(const Color& color, const int width, const int height) : Drawable(width, height) {
 		props_.background_color = color;
+		tracked_ = true;
 	}
 
 	// Dynamic ondraw function
@@ -37,28 +43,43 @@ public:
 
 	// Static pixel text
 	Visual(const string& pixel_text, const size_t pixel_font_id = 0)
-		: Drawable(render.GetPixelTextWidth(pixel_text, pixel_font_id),
-				   render.GetPixelTextHeight(pixel_text, pixel_font_id)) {
-		props_.pixel_text = pixel_text;
-		props_.pixel_font_id = pixel_font_id;
-	}
+		: Visual(pixel_text, pixel_font_id, render.MeasurePixelText(pixel_text, pixel_font_id)) {}
 
 	// MUST set width/height for an ondraw_func or plain background color, otherwise auto-detects from the sprite.
 	explicit Visual(const Properties& props, const int width = 0, const int height = 0)
-	 : Drawable(width == 0 ? props.sprite->width() : width, height == 0 ? props.sprite->height() : height), props_(props) {}
+	 : Drawable(width == 0 ? props.sprite->width() : width, height == 0 ? props.sprite->height() : height), props_(props) {
+		sprite_size_ = width == 0 && height == 0;
+		tracked_ = props.ondraw_func == nullptr; // Otherwise drawn again every frame.
+	}
 
 	void setSprite(Sprite& s);
 	void setBackgroundColor(const Color& bg_color);
-	void setPixelText(const string& pixel_text) { props_.pixel_text = pixel_text; }
+	void setTint(const Color& tint) { props_.tint = tint; markDirty(); }
+	void setPixelText(const string& pixel_text) { props_.pixel_text = pixel_text; markDirty(); }
 	
 	void draw() override;
+	// Also when the sprite changed (such as when an async sprite is loaded).
+	bool isDirty() const override;
+	void clearDirty() override;
+	void updateSize() override; // To the sprite's, unless set otherwise.
 
 protected:
+	// Measures the text only once for both the width and height.
+	Visual(const string& pixel_text, const size_t pixel_font_id, const PixelTextLayout& layout)
+		: Drawable(layout.width, layout.height) {
+		props_.pixel_text = pixel_text;
+		props_.pixel_font_id = pixel_font_id;
+		tracked_ = true;
+	}
+
 	Properties props_;
+	uint32_t drawn_sprite_version_ = 0;
+	bool sprite_size_ = false; // The width/height are from the sprite.
 };
 
 inline void Visual::setBackgroundColor(const Color& bg_color) {
 	props_.background_color = bg_color;
+	markDirty();
 }
 	
 } // namespace Blocks
@@ -0,0 +1,281 @@
+#include "atlas.h"
+
+#include <climits>
+#include <cstring>
+
+namespace arc {
+
+//
+// skyline_packer
+//
+
+skyline_packer::skyline_packer(const int width, const int height) : width_(width), height_(height) {
+	reset();
+}
+
+void skyline_packer::reset() {
+	skyline_.clear();
+	skyline_.push_back({ 0, 0, width_ });
+	used_area_ = 0;
+}
+
+bool skyline_packer::fits(const size_t index, const int width, const int height, int& y) const {
+	const int x = skyline_[index].x;
+	if (x + width > width_) {
+		return false;
+	}
+	int width_left = width;
+	size_t i = index;
+	y = skyline_[index].y;
+	while (width_left > 0) {
+		if (skyline_[i].y > y) {
+			y = skyline_[i].y;
+		}
+		if (y + height > height_) {
+			return false;
+		}
+		width_left -= skyline_[i].width;
+		i++;
+	}
+	return true;
+}
+
+bool skyline_packer::pack(const int width, const int height, int& x, int& y) {
+	if (width <= 0 || height <= 0) {
+		return false;
+	}
+
+	// Bottom-left: the lowest top edge, then the narrowest node to waste less space.
+	int best_bottom = INT_MAX;
+	int best_width = INT_MAX;
+	size_t best_index = 0;
+	bool found = false;
+
+	const size_t len = skyline_.size();
+	for (size_t i = 0; i < len; i++) {
+		int fit_y = 0;
+		if (fits(i, width, height, fit_y)) {
+			const int bottom = fit_y + height;
+			if (bottom < best_bottom || (bottom == best_bottom && skyline_[i].width < best_width)) {
+				best_bottom = bottom;
+				best_width = skyline_[i].width;
+				best_index = i;
+				x = skyline_[i].x;
+				y = fit_y;
+				found = true;
+			}
+		}
+	}
+	if (!found) {
+		return false;
+	}
+
+	skyline_.insert(skyline_.begin() + best_index, { x, y + height, width });
+
+	// Shrink or remove the nodes now covered by the new one.
+	for (size_t i = best_index + 1; i < skyline_.size(); ) {
+		const skyline_node& prev = skyline_[i - 1];
+		const int overlap = prev.x + prev.width - skyline_[i].x;
+		if (overlap <= 0) {
+			break;
+		}
+		skyline_[i].x += overlap;
+		skyline_[i].width -= overlap;
+		if (skyline_[i].width > 0) {
+			break;
+		}
+		skyline_.erase(skyline_.begin() + i);
+	}
+
+	// Merge neighbors at the same height.
+	for (size_t i = 0; i + 1 < skyline_.size(); ) {
+		if (skyline_[i].y == skyline_[i + 1].y) {
+			skyline_[i].width += skyline_[i + 1].width;
+			skyline_.erase(skyline_.begin() + i + 1);
+		} else {
+			i++;
+		}
+	}
+
+	used_area_ += size_t(width) * size_t(height);
+	return true;
+}
+
+//
+// SpriteAtlas
+//
+
+SpriteAtlas::~SpriteAtlas() {
+	// Sub-sprites first, as they refer to the page textures. (Any already deleted are skipped.)
+	for (const SpriteHandle handle : sprites_) {
+		render.DeleteSprite(handle);
+	}
+	sprites_.clear();
+	for (AtlasPage& page : pages_) {
+		render.DeleteSprite(*page.sprite);
+		delete page.packer;
+	}
+	pages_.clear();
+}
+
+Sprite& SpriteAtlas::AddImage(const string& file_path) {
+	string img_fn = file_path;
+	SDL_Surface* surface = IMG_Load(img_fn.c_str());
+
+	if (surface == nullptr) {
+		throw graphics_error("Unable to load image: " + file_path + IMG_GetError());
+	}
+
+	return AddSurface(surface, file_path);
+}
+
+Sprite& SpriteAtlas::AddBitmap(const string& file_path) {
+	string bmp_fn = file_path;
+	SDL_Surface* surface = SDL_LoadBMP(bmp_fn.c_str());
+
+	if (surface == nullptr) {
+		throw graphics_error("Unable to load bitmap: " + file_path + SDL_GetError());
+	}
+
+	return AddSurface(surface, file_path);
+}
+
+Sprite& SpriteAtlas::AddDataBuffer(const DataBuffer& data) {
+	if (data.format != SDL_PIXELFORMAT_ARGB8888) {
+		throw graphics_error("sprite atlas data buffers must be in the ARGB8888 format");
+	}
+	return AddPixels(data.data, data.bytes_per_row, data.width, data.height);
+}
+
+Sprite& SpriteAtlas::AddSurface(SDL_Surface* surface, const string& file_path) {
+	// Pages are always ARGB8888, so convert first.
+	SDL_Surface* converted = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_ARGB8888, 0);
+	SDL_FreeSurface(surface);
+
+	if (converted == nullptr) {
+		throw graphics_error("Unable to convert image for sprite atlas: " + file_path + SDL_GetError());
+	}
+
+	SDL_LockSurface(converted);
+	try {
+		Sprite& s = AddPixels(converted->pixels, converted->pitch, converted->w, converted->h);
+		SDL_UnlockSurface(converted);
+		SDL_FreeSurface(converted);
+		return s;
+	} catch (...) {
+		SDL_UnlockSurface(converted);
+		SDL_FreeSurface(converted);
+		throw;
+	}
+}
+
+SpriteAtlas::AtlasPage& SpriteAtlas::AddPage() {
+	// Pages start out transparent.
+	DataBuffer blank;
+	blank.width = options_.page_width;
+	blank.height = options_.page_height;
+	blank.set_bytes_per_row();
+	blank.len = size_t(blank.bytes_per_row) * size_t(blank.height);
+	blank.data = calloc(blank.len, 1);
+	if (blank.data == nullptr) {
+		throw graphics_error("Out of memory for a new sprite atlas page!");
+	}
+
+	Sprite& sprite = render.SpriteFromDataBuffer(blank);
+	free(blank.data);
+	sprite.enableAlphaBlending();
+
+	AtlasPage page;
+	page.sprite = &sprite;
+	page.packer = new skyline_packer(options_.page_width, options_.page_height);
+	pages_.push_back(page);
+	return pages_.back();
+}
+
+Sprite& SpriteAtlas::AddPixels(const void* pixels, const int bytes_per_row, const int width, const int height) {
+	if (width <= 0 || height <= 0) {
+		throw graphics_error("Tried to add an empty image to a sprite atlas!");
+	}
+
+	const int pad = options_.padding > 0 ? options_.padding : 0;
+	const int pw = width + (2 * pad);
+	const int ph = height + (2 * pad);
+
+	if (pw > options_.max_image_width || ph > options_.max_image_height ||
+		pw > options_.page_width || ph > options_.page_height) {
+		// Too large to share, so it gets its own texture.
+		DataBuffer data;
+		data.data = (void*) pixels;
+		data.width = width;
+		data.height = height;
+		data.bytes_per_row = bytes_per_row;
+		data.len = size_t(bytes_per_row) * size_t(height);
+		Sprite& s = render.SpriteFromDataBuffer(data);
+		s.enableAlphaBlending();
+		sprites_.push_back(s.handle());
+		return s;
+	}
+
+	// Newest pages are the most likely to have room left.
+	AtlasPage* page = nullptr;
+	int px = 0;
+	int py = 0;
+	for (size_t i = pages_.size(); i > 0; i--) {
+		if (pages_[i - 1].packer->pack(pw, ph, px, py)) {
+			page = &pages_[i - 1];
+			break;
+		}
+	}
+	if (page == nullptr) {
+		page = &AddPage();
+		if (!page->packer->pack(pw, ph, px, py)) {
+			throw graphics_error("Unable to fit image into a new sprite atlas page!");
+		}
+	}
+
+	// Copy with the padding, either transparent or extruded from the edges.
+	DataBuffer padded;
+	padded.width = pw;
+	padded.height = ph;
+	padded.set_bytes_per_row();
+	padded.len = size_t(padded.bytes_per_row) * size_t(ph);
+	padded.data = calloc(padded.len, 1);
+	if (padded.data == nullptr) {
+		throw graphics_error("Out of memory for a sprite atlas image!");
+	}
+
+	const uint8_t* src = (const uint8_t*) pixels;
+	uint8_t* dst = (uint8_t*) padded.data;
+	for (int y = 0; y < ph; y++) {
+		int sy = y - pad;
+		uint32_t* row = (uint32_t*) (dst + (size_t(y) * padded.bytes_per_row));
+		if (sy < 0 || sy >= height) {
+			if (!options_.extrude) {
+				continue;
+			}
+			sy = sy < 0 ? 0 : height - 1;
+		}
+		const uint32_t* src_row = (const uint32_t*) (src + (size_t(sy) * bytes_per_row));
+		memcpy(row + pad, src_row, size_t(width) * 4);
+		if (options_.extrude) {
+			for (int x = 0; x < pad; x++) {
+				row[x] = src_row[0];
+				row[pad + width + x] = src_row[width - 1];
+			}
+		}
+	}
+
+	Sprite& page_sprite = *page->sprite;
+	render.UpdateSpriteRegionFromDataBuffer(page_sprite, px, py, padded);
+	free(padded.data);
+
+	Sprite& s = render.SpriteFromSubRegion(page_sprite, px + pad, py + pad, width, height);
+	if (&s == &page_sprite) {
+		// The region was rejected, and the page is already deleted with the atlas.
+		throw graphics_error("Unable to make a sprite for the sprite atlas image!");
+	}
+	sprites_.push_back(s.handle());
+	return s;
+}
+
+} // namespace arc
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <vector>
+
+#include "graphics.h"
+
+namespace arc {
+
+// Packs rectangles into a fixed size area, using the skyline bottom-left heuristic.
+// (Only rectangles are tracked here, see SpriteAtlas for the textures.)
+class skyline_packer {
+public:
+	skyline_packer(const int width, const int height);
+
+	// Returns false if there is no room left for a rectangle of this size.
+	bool pack(const int width, const int height, int& x, int& y);
+	void reset();
+
+	int width() const { return width_; }
+	int height() const { return height_; }
+	size_t used_area() const { return used_area_; }
+	double occupancy() const { return (double) used_area_ / ((double) width_ * (double) height_); }
+
+protected:
+	struct skyline_node {
+		int x;
+		int y; // Top of the free space above this node.
+		int width;
+	};
+
+	// Returns false if it doesn't fit, otherwise sets y to the lowest position it fits at.
+	bool fits(const size_t index, const int width, const int height, int& y) const;
+
+	std::vector<skyline_node> skyline_; // Sorted by x, covers the full width.
+	const int width_;
+	const int height_;
+	size_t used_area_ = 0;
+};
+
+struct SpriteAtlasOptions {
+	int page_width = 1024;
+	int page_height = 1024;
+	// Empty pixels around each image, so linear filtering (when scaling) doesn't mix in any
+	// neighboring images.
+	int padding = 1;
+	// Fills the padding with the image's edge pixels instead of transparency, which also avoids
+	// transparent seams at the edges of tiled/scaled images.
+	bool extrude = true;
+	// Larger images (including padding) get their own texture instead.
+	int max_image_width = 256;
+	int max_image_height = 256;
+};
+
+// Combines many small images into a few shared textures (atlas pages), so that drawing them
+// can be batched instead of switching textures for nearly every sprite.
+// All returned sprites are normal sub-sprites of a page, owned by the RenderModule.
+// Should always be used as a SpriteAtlas&
+class SpriteAtlas {
+public:
+	explicit SpriteAtlas(const SpriteAtlasOptions& options = SpriteAtlasOptions()) : options_(options) {}
+	~SpriteAtlas(); // DANGER: Deletes all of the pages and sprites, so never use any sprites from this atlas afterwards!
+
+	Sprite& AddImage(const string& file_path); // Including PNG, etc.
+	Sprite& AddBitmap(const string& file_path);
+	// Must be SDL_PIXELFORMAT_ARGB8888.
+	Sprite& AddDataBuffer(const DataBuffer& data);
+
+	size_t pages() const { return pages_.size(); }
+	Sprite& page(const size_t index) { return *(pages_.at(index).sprite); }
+	const SpriteAtlasOptions& options() const { return options_; }
+
+protected:
+	struct AtlasPage {
+		Sprite* sprite = nullptr; // NOT Owned (owned by the RenderModule)
+		skyline_packer* packer = nullptr; // Owned
+	};
+
+	// Takes ownership of (frees) the surface.
+	Sprite& AddSurface(SDL_Surface* surface, const string& file_path);
+	// 32-bit pixels, copied into a page (with padding), or into a new texture if too large.
+	Sprite& AddPixels(const void* pixels, const int bytes_per_row, const int width, const int height);
+	AtlasPage& AddPage();
+
+	const SpriteAtlasOptions options_;
+	std::vector<AtlasPage> pages_;
+	std::vector<SpriteHandle> sprites_; // All returned sprites (sub-sprites and separate textures), deleted with the atlas.
+
+	DELETE_COPY_AND_ASSIGN(SpriteAtlas);
+};
+
+} // namespace arc
@@ -2,8 +2,15 @@
 
 #include "path.h"
 #include "file.h"
+#include "thread.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
 
 #include <errno.h>
+#include <string.h>
 
 #ifdef _WIN32
 	#error "Windows directory/stat not implemented."
@@ -14,11 +21,81 @@
 	#include <sys/types.h>
 	#include <sys/stat.h>
 	#include <dirent.h>
+	#include <fcntl.h>
 	#include <unistd.h>
 #endif
 
 namespace arc {
 
+struct DirReadEntry {
+	std::string name;
+	int type;
+};
+
+static int ModeToEntryType(const mode_t mode) {
+	if (S_ISREG(mode)) {
+		return DIR_ENTRY_FILE;
+	} else if (S_ISDIR(mode)) {
+		return DIR_ENTRY_DIR;
+	} else if (S_ISLNK(mode)) {
+		return DIR_ENTRY_SYMLINK;
+	}
+	return DIR_ENTRY_OTHER;
+}
+
+// Reads all entries of the dir (other than . and ..), using d_type so that stat is only
+// needed for symlinks being followed, or on file systems that do not report the type.
+static bool ReadDirInternal(const char* dir, const bool follow_symlinks, std::vector<DirReadEntry>& entries) {
+	errno = 0;
+	DIR* d = opendir(dir);
+	if (d == nullptr) {
+		perror("ERROR [DirModule] Failed to open directory");
+		return false;
+	}
+	const int dfd = dirfd(d);
+
+	while (true) {
+		errno = 0;
+		const auto* entry = readdir(d);
+		if (entry == nullptr) {
+			if (errno != 0) {
+				perror("ERROR [DirModule] Failed to read directory entry");
+			}
+			break;
+		}
+		const char* name = entry->d_name;
+		if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+			continue;
+		}
+
+#ifdef _DIRENT_HAVE_D_TYPE
+		const unsigned char d_type = entry->d_type;
+#else
+		const unsigned char d_type = DT_UNKNOWN;
+#endif
+		int type = DIR_ENTRY_OTHER;
+		if (d_type == DT_UNKNOWN || (d_type == DT_LNK && follow_symlinks)) {
+			struct stat st;
+			if (fstatat(dfd, name, &st, follow_symlinks ? 0 : AT_SYMLINK_NOFOLLOW) == 0) {
+				type = ModeToEntryType(st.st_mode);
+			} else if (d_type == DT_LNK) {
+				type = DIR_ENTRY_SYMLINK; // Broken link
+			}
+		} else if (d_type == DT_REG) {
+			type = DIR_ENTRY_FILE;
+		} else if (d_type == DT_DIR) {
+			type = DIR_ENTRY_DIR;
+		} else if (d_type == DT_LNK) {
+			type = DIR_ENTRY_SYMLINK;
+		}
+
+		entries.push_back(DirReadEntry{ std::string(name), type });
+	}
+
+	closedir(d);
+	return true;
+}
+
 // Lists the contents of the current working dir.
 array<string> DirModule::List() const {
 	return List(string("."));
@@ -66,6 +143,7 @@ bool DirModule::Create(const string& dir, const mode_t mode) const {
 		perror("ERROR [DirModule] Failed to create directory");
 		return false;
 	}
+	path.InvalidateStatCache(dir);
 	return true;
 }
 
@@ -118,6 +196,7 @@ bool DirModule::Remove(const string& dir) const {
 		perror("ERROR [DirModule]: Failed to remove directory");
 		return false;
 	}
+	path.InvalidateStatCache(dir);
 	return true;
 }
 
@@ -166,12 +245,17 @@ bool DirModule::RemoveAll(const string& dir) const {
 }
 
 // This deletes all directories and all files within. Careful!
+// Note that symlinks are deleted, never followed.
 bool DirModule::RemoveRecursive(const string& dir) const {
-	array<string> list = List(dir);
+	string cdir(dir);
+	std::vector<DirReadEntry> list;
+	if (!ReadDirInternal(cdir.c_str(), false, list)) {
+		return false;
+	}
 
-	for (size_t i = 0; i < list.len(); i++) {
-		const string& current = path.Join(dir, list.at(i));
-		if (path.IsDir(current)) {
+	for (size_t i = 0; i < list.size(); i++) {
+		const string& current = path.Join(dir, string(list[i].name.c_str()));
+		if (list[i].type == DIR_ENTRY_DIR) {
 			if (!RemoveRecursive(current)) {
 				return false;
 			}
@@ -185,4 +269,123 @@ bool DirModule::RemoveRecursive(const string& dir) const {
 	return Remove(dir);
 }
 
+// Shared by all dirs of one walk.
+struct DirWalkInternal {
+	DirWalkInternal(const DirWalkOptions& opts, DirModule::WalkCallback& cb) : options(opts), callback(cb) {}
+
+	const DirWalkOptions& options;
+	DirModule::WalkCallback& callback;
+
+	// Strings are not thread safe (non-atomic reference counts), so all DirEntry strings are created,
+	// passed to the filter/callback, and destroyed while holding this.
+	std::mutex mutex;
+	std::condition_variable done_cv;
+	size_t count = 0;
+	size_t pending = 0; // Dirs queued on the pool but not yet walked.
+	bool stopped = false;
+};
+
+static string OwnedString(const std::string& str) {
+	string owned('\0', str.size());
+	memcpy(owned.mutable_data(), str.data(), str.size());
+	return owned;
+}
+
+// Walks the entries of a single dir, adding any subdirectories that should be walked next.
+static void WalkOneDirInternal(DirWalkInternal& walk, const std::string& dir, const int depth, std::vector<std::string>& subdirs) {
+	std::vector<DirReadEntry> entries;
+	if (!ReadDirInternal(dir.c_str(), walk.options.follow_symlinks, entries)) {
+		return;
+	}
+
+	const DirWalkOptions& options = walk.options;
+	const bool descend = options.max_depth < 0 || depth < options.max_depth;
+	const bool add_separator = !dir.empty() && (unsigned char) dir.back() != path.PathSeparator;
+
+	std::lock_guard<std::mutex> lock(walk.mutex);
+	for (const DirReadEntry& read_entry : entries) {
+		if (walk.stopped) {
+			return;
+		}
+		if (!options.include_hidden && read_entry.name[0] == '.') {
+			continue;
+		}
+
+		std::string full_path;
+		full_path.reserve(dir.size() + read_entry.name.size() + 1);
+		full_path.append(dir);
+		if (add_separator) {
+			full_path.push_back((char) path.PathSeparator);
+		}
+		full_path.append(read_entry.name);
+
+		DirEntry entry{ OwnedString(full_path), OwnedString(read_entry.name), read_entry.type, depth };
+		if (options.filter && !options.filter(entry)) {
+			continue;
+		}
+
+		const bool is_dir = read_entry.type == DIR_ENTRY_DIR;
+		if (is_dir ? options.include_dirs : options.include_files) {
+			walk.count++;
+			if (!walk.callback(entry)) {
+				walk.stopped = true;
+				return;
+			}
+		}
+		if (is_dir && descend) {
+			subdirs.push_back(std::move(full_path));
+		}
+	}
+}
+
+// Requires walk.pending to already include this dir.
+static void QueueWalkInternal(DirWalkInternal& walk, std::string dir, const int depth) {
+	thread_manager.Pool().run([&walk, dir, depth]() {
+		std::vector<std::string> subdirs;
+		WalkOneDirInternal(walk, dir, depth, subdirs);
+
+		std::lock_guard<std::mutex> lock(walk.mutex);
+		if (!walk.stopped) {
+			for (std::string& subdir : subdirs) {
+				walk.pending++;
+				QueueWalkInternal(walk, std::move(subdir), depth + 1);
+			}
+		}
+		walk.pending--;
+		if (walk.pending == 0) {
+			walk.done_cv.notify_all();
+		}
+	});
+}
+
+// Note that parallel walks must not be started from a pool task, as this waits on the pool.
+size_t DirModule::Walk(const string& dir, WalkCallback callback, const DirWalkOptions& options) const {
+	DirWalkInternal walk(options, callback);
+	const std::string root((const char*) dir.data(), dir.len());
+
+	if (options.parallel) {
+		std::unique_lock<std::mutex> lock(walk.mutex);
+		walk.pending = 1;
+		QueueWalkInternal(walk, root, 0);
+		walk.done_cv.wait(lock, [&walk]() { return walk.pending == 0; });
+		return walk.count;
+	}
+
+	// Depth-first, with an explicit stack so deep trees can't overflow the call stack.
+	std::vector<std::pair<std::string, int>> stack;
+	stack.emplace_back(root, 0);
+	std::vector<std::string> subdirs;
+	while (!stack.empty() && !walk.stopped) {
+		std::pair<std::string, int> current = std::move(stack.back());
+		stack.pop_back();
+
+		subdirs.clear();
+		WalkOneDirInternal(walk, current.first, current.second, subdirs);
+		for (size_t i = subdirs.size(); i > 0; i--) { // Reversed, so subdirs are walked in read order.
+			stack.emplace_back(std::move(subdirs[i - 1]), current.second + 1);
+		}
+	}
+	return walk.count;
+}
+
 } // namespace arc
@@ -1,9 +1,38 @@
 #pragma once
 
+#include <functional>
+
 #include "string.h"
 
 namespace arc {
 
+#define DIR_ENTRY_FILE 0
+#define DIR_ENTRY_DIR 1
+#define DIR_ENTRY_SYMLINK 2 /* Only when not following symlinks */
+#define DIR_ENTRY_OTHER 3 /* Devices, pipes, sockets, etc. */
+
+struct DirEntry {
+	string path; // The walked dir joined with the path to this entry.
+	string name;
+	int type; // DIR_ENTRY_*
+	int depth; // 0 for entries directly within the walked dir.
+};
+
+struct DirWalkOptions {
+	int max_depth = -1; // -1 for unlimited, 0 for only the entries directly within the walked dir.
+	bool include_files = true; // Also includes symlinks and other non-directories.
+	bool include_dirs = true;
+	bool include_hidden = true; // Names starting with '.'
+	bool follow_symlinks = false; // Careful, symlink loops are only stopped by max_depth!
+
+	// Entries for which this returns false are skipped, and skipped directories are not walked.
+	std::function<bool(const DirEntry&)> filter;
+
+	// Walks subdirectories in parallel on the thread pool. The callback is then called from
+	// pool threads (but never concurrently), and the order of entries is not deterministic.
+	bool parallel = false;
+};
+
 class DirModule {
 public:
 	DirModule() {}
@@ -21,6 +50,14 @@ public:
 	// This deletes all directories and all files within. Careful!
 	bool RemoveRecursive(const string& dir) const;
 
+	// Return false from the callback to stop the walk early.
+	typedef std::function<bool(const DirEntry& entry)> WalkCallback;
+
+	// Recursively walks the given dir, calling callback for each entry (other than . and ..).
+	// Uses the type from readdir where possible, so most entries need no stat call.
+	// Returns the number of entries passed to the callback.
+	size_t Walk(const string& dir, WalkCallback callback, const DirWalkOptions& options = DirWalkOptions()) const;
+
 private:
 	DELETE_COPY_AND_ASSIGN(DirModule);
 } dir;
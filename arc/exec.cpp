@@ -0,0 +1,656 @@
+#include "exec.h"
+
+#include "log.h"
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <errno.h>
+#include <string.h>
+
+#ifdef _WIN32
+	#error "Windows process spawning not implemented."
+#else
+	#include <fcntl.h>
+	#include <poll.h>
+	#include <signal.h>
+	#include <spawn.h>
+	#include <unistd.h>
+	#include <sys/wait.h>
+#endif
+
+extern char** environ;
+
+namespace arc {
+
+#define EXEC_FD_INHERIT 0
+#define EXEC_FD_DEVNULL 1
+#define EXEC_FD_PIPE 2
+
+static std::string StdString(const string& str) {
+	return std::string((const char*) str.data(), str.len());
+}
+
+// Strings are not thread safe (non-atomic reference counts), so output is always given out as fresh copies.
+static string OwnedString(const char* data, const size_t len) {
+	string owned('\0', len);
+	if (len > 0) {
+		memcpy(owned.mutable_data(), data, len);
+	}
+	return owned;
+}
+
+// Splits on whitespace, with '' and "" quoting and backslash escapes (not within '').
+static std::vector<std::string> SplitCommandInternal(const std::string& command) {
+	std::vector<std::string> args;
+	std::string current;
+	bool in_arg = false;
+	char quote = '\0';
+
+	for (size_t i = 0; i < command.size(); i++) {
+		const char c = command[i];
+		if (quote != '\0') {
+			if (c == quote) {
+				quote = '\0';
+			} else if (c == '\\' && quote == '"' && i + 1 < command.size()) {
+				current.push_back(command[++i]);
+			} else {
+				current.push_back(c);
+			}
+		} else if (c == '\'' || c == '"') {
+			quote = c;
+			in_arg = true;
+		} else if (c == '\\' && i + 1 < command.size()) {
+			current.push_back(command[++i]);
+			in_arg = true;
+		} else if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+			if (in_arg) {
+				args.push_back(std::move(current));
+				current.clear();
+				in_arg = false;
+			}
+		} else {
+			current.push_back(c);
+			in_arg = true;
+		}
+	}
+	if (in_arg) {
+		args.push_back(std::move(current));
+	}
+	return args;
+}
+
+struct ExecSpawnInternal {
+	int modes[3] = { EXEC_FD_INHERIT, EXEC_FD_INHERIT, EXEC_FD_INHERIT }; // stdin, stdout, stderr
+	int fds[3] = { -1, -1, -1 }; // The parent's (non-blocking) end of each EXEC_FD_PIPE.
+};
+
+static bool PipeInternal(int fds[2]) {
+#ifdef __linux__
+	return pipe2(fds, O_CLOEXEC) == 0;
+#else
+	if (pipe(fds) != 0) {
+		return false;
+	}
+	fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+	fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+	return true;
+#endif
+}
+
+// Uses posix_spawn, which (unlike fork) does not copy the page tables of this process.
+// Pipes are close-on-exec, so concurrently started commands never inherit each other's pipes.
+static pid_t SpawnInternal(const std::string& shell, const std::string& command, const bool use_shell, ExecSpawnInternal& spawn) {
+	std::vector<std::string> args;
+	if (use_shell) {
+		args = { shell, "-c", command };
+	} else {
+		args = SplitCommandInternal(command);
+	}
+	if (args.empty()) {
+		ARC_LOG_ERROR("ExecModule", "Empty command");
+		return -1;
+	}
+
+	std::vector<char*> argv;
+	argv.reserve(args.size() + 1);
+	for (std::string& arg : args) {
+		argv.push_back(&arg[0]);
+	}
+	argv.push_back(nullptr);
+
+	int pipes[3][2] = { { -1, -1 }, { -1, -1 }, { -1, -1 } };
+	posix_spawn_file_actions_t actions;
+	posix_spawn_file_actions_init(&actions);
+
+	bool ok = true;
+	for (int fd = 0; fd < 3 && ok; fd++) {
+		if (spawn.modes[fd] == EXEC_FD_PIPE) {
+			if (!PipeInternal(pipes[fd])) {
+				perror("ERROR [ExecModule] Failed to create pipe");
+				ok = false;
+				break;
+			}
+			posix_spawn_file_actions_adddup2(&actions, fd == 0 ? pipes[fd][0] : pipes[fd][1], fd);
+		} else if (spawn.modes[fd] == EXEC_FD_DEVNULL) {
+			posix_spawn_file_actions_addopen(&actions, fd, "/dev/null", fd == 0 ? O_RDONLY : O_WRONLY, 0);
+		}
+	}
+
+	pid_t pid = -1;
+	if (ok) {
+		const int result = use_shell
+			? posix_spawn(&pid, argv[0], &actions, nullptr, argv.data(), environ)
+			: posix_spawnp(&pid, argv[0], &actions, nullptr, argv.data(), environ);
+		if (result != 0) {
+			errno = result;
+			perror("ERROR [ExecModule] Failed to start command");
+			ok = false;
+			pid = -1;
+		}
+	}
+	posix_spawn_file_actions_destroy(&actions);
+
+	for (int fd = 0; fd < 3; fd++) {
+		if (pipes[fd][0] < 0) {
+			continue;
+		}
+		const int child_end = fd == 0 ? 0 : 1;
+		close(pipes[fd][child_end]);
+		if (ok) {
+			spawn.fds[fd] = pipes[fd][1 - child_end];
+			fcntl(spawn.fds[fd], F_SETFL, fcntl(spawn.fds[fd], F_GETFL) | O_NONBLOCK);
+		} else {
+			close(pipes[fd][1 - child_end]);
+		}
+	}
+
+	return pid;
+}
+
+static int ExitCodeFromStatus(const int status) {
+	if (WIFEXITED(status)) {
+		return WEXITSTATUS(status);
+	} else if (WIFSIGNALED(status)) {
+		return 128 + WTERMSIG(status);
+	}
+	return -1;
+}
+
+// Exits are checked this often while any pipes are still open, as a background process started by
+// the command (such as with sh -c 'daemon &') can keep them open long after the command exits.
+static const int kExitPollMsec = 10;
+
+// Returns true (with the exit code) if the process has exited, without waiting.
+static bool TryWaitInternal(const pid_t pid, int& exit_code) {
+	int status = 0;
+	pid_t result;
+	while ((result = waitpid(pid, &status, WNOHANG)) == -1 && errno == EINTR) {}
+	if (result == 0) {
+		return false;
+	}
+	exit_code = result == pid ? ExitCodeFromStatus(status) : -1;
+	return true;
+}
+
+static int WaitInternal(const pid_t pid) {
+	int status = 0;
+	while (waitpid(pid, &status, 0) == -1) {
+		if (errno != EINTR) {
+			perror("ERROR [ExecModule] Failed to wait for command");
+			return -1;
+		}
+	}
+	return ExitCodeFromStatus(status);
+}
+
+// Writes without raising SIGPIPE (which would exit this process) when the child has closed its stdin.
+static ssize_t WriteNoSigPipe(const int fd, const char* data, const size_t len) {
+	sigset_t pipe_set, old_set;
+	sigemptyset(&pipe_set);
+	sigaddset(&pipe_set, SIGPIPE);
+	pthread_sigmask(SIG_BLOCK, &pipe_set, &old_set);
+
+	const ssize_t written = write(fd, data, len);
+	const int write_errno = errno;
+	if (written < 0 && write_errno == EPIPE && !sigismember(&old_set, SIGPIPE)) {
+		const struct timespec no_wait = { 0, 0 };
+		sigtimedwait(&pipe_set, nullptr, &no_wait); // Discard the now pending SIGPIPE.
+	}
+
+	pthread_sigmask(SIG_SETMASK, &old_set, nullptr);
+	errno = write_errno;
+	return written;
+}
+
+// Reads everything currently available, and closes the fd at EOF.
+// The output goes to the callback when set, otherwise it is collected.
+static void ReadAvailableInternal(int& fd, std::string& collected, const ExecOutputCallback& callback) {
+	char buffer[65536];
+	while (fd >= 0) {
+		const ssize_t n = read(fd, buffer, sizeof(buffer));
+		if (n > 0) {
+			if (callback) {
+				callback(OwnedString(buffer, (size_t) n));
+			} else {
+				collected.append(buffer, (size_t) n);
+			}
+		} else if (n == 0) {
+			close(fd);
+			fd = -1;
+		} else if (errno == EINTR) {
+			continue;
+		} else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+			return;
+		} else {
+			perror("ERROR [ExecModule] Failed to read command output");
+			close(fd);
+			fd = -1;
+		}
+	}
+}
+
+// Writes as much of the input as the pipe accepts, and closes the fd once all of it is written.
+static void WriteAvailableInternal(int& fd, const std::string& input, size_t& written) {
+	while (fd >= 0 && written < input.size()) {
+		const ssize_t n = WriteNoSigPipe(fd, input.data() + written, input.size() - written);
+		if (n > 0) {
+			written += (size_t) n;
+		} else if (n < 0 && errno == EINTR) {
+			continue;
+		} else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			return;
+		} else {
+			if (errno != EPIPE) { // EPIPE: The command exited or closed stdin without reading everything.
+				perror("ERROR [ExecModule] Failed to write command input");
+			}
+			close(fd);
+			fd = -1;
+			return;
+		}
+	}
+	if (fd >= 0) {
+		close(fd);
+		fd = -1;
+	}
+}
+
+// Handles the pipes of all async processes, so any number can run without a thread each.
+class ExecReactorInternal {
+public:
+	static ExecReactorInternal& Get() {
+		static ExecReactorInternal reactor;
+		return reactor;
+	}
+
+	~ExecReactorInternal();
+
+	void Add(std::shared_ptr<process> proc);
+
+protected:
+	ExecReactorInternal();
+
+	void Wake();
+	void Main();
+	bool Reap(process& proc); // Returns true if the process has exited.
+	void ReadOutput(process& proc, int& fd);
+	void Finish(process& proc); // After reaping, reads any output left and marks it exited.
+
+	std::mutex mutex_; // For added_ and stopping_
+	std::vector<std::shared_ptr<process>> added_;
+	bool stopping_ = false;
+
+	int wake_fds_[2] = { -1, -1 };
+	std::thread thread_;
+
+	DELETE_COPY_AND_ASSIGN(ExecReactorInternal);
+};
+
+ExecReactorInternal::ExecReactorInternal() {
+	if (!PipeInternal(wake_fds_)) {
+		perror("ERROR [ExecModule] Failed to create pipe");
+	}
+	fcntl(wake_fds_[0], F_SETFL, fcntl(wake_fds_[0], F_GETFL) | O_NONBLOCK);
+	fcntl(wake_fds_[1], F_SETFL, fcntl(wake_fds_[1], F_GETFL) | O_NONBLOCK);
+	thread_ = std::thread(&ExecReactorInternal::Main, this);
+}
+
+// Any processes still running are left running (and not waited for).
+ExecReactorInternal::~ExecReactorInternal() {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stopping_ = true;
+	}
+	Wake();
+	if (thread_.joinable()) {
+		thread_.join();
+	}
+	close(wake_fds_[0]);
+	close(wake_fds_[1]);
+}
+
+void ExecReactorInternal::Add(std::shared_ptr<process> proc) {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		added_.push_back(std::move(proc));
+	}
+	Wake();
+}
+
+void ExecReactorInternal::Wake() {
+	const char c = 0;
+	while (write(wake_fds_[1], &c, 1) == -1 && errno == EINTR) {}
+	// EAGAIN: Already full, so it will wake anyway.
+}
+
+bool ExecReactorInternal::Reap(process& proc) {
+	std::lock_guard<std::mutex> lock(proc.mutex_); // So signals can never be sent to a reused pid.
+	int exit_code = -1;
+	if (!TryWaitInternal(proc.pid_, exit_code)) {
+		return false;
+	}
+	proc.exit_code_ = exit_code;
+	proc.reaped_ = true;
+	return true;
+}
+
+void ExecReactorInternal::ReadOutput(process& proc, int& fd) {
+	std::string collected;
+	ReadAvailableInternal(fd, collected, &fd == &proc.out_fd_ ? proc.on_stdout_ : proc.on_stderr_);
+	if (!collected.empty()) {
+		std::lock_guard<std::mutex> lock(proc.mutex_);
+		(&fd == &proc.out_fd_ ? proc.out_ : proc.err_).append(collected);
+	}
+}
+
+// Output still in the pipes is read, but not waited for, as other processes may hold them open.
+void ExecReactorInternal::Finish(process& proc) {
+	ReadOutput(proc, proc.out_fd_);
+	ReadOutput(proc, proc.err_fd_);
+	for (int* fd : { &proc.in_fd_, &proc.out_fd_, &proc.err_fd_ }) {
+		if (*fd >= 0) {
+			close(*fd);
+			*fd = -1;
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(proc.mutex_);
+	proc.exited_ = true;
+	proc.exited_cv_.notify_all();
+}
+
+void ExecReactorInternal::Main() {
+	std::vector<std::shared_ptr<process>> procs;
+	std::vector<pollfd> fds;
+	std::vector<std::pair<process*, int*>> fd_owners; // Matches fds (after the wake fd)
+
+	while (true) {
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			if (stopping_) {
+				break;
+			}
+			for (std::shared_ptr<process>& proc : added_) {
+				WriteAvailableInternal(proc->in_fd_, proc->input_, proc->input_written_);
+				procs.push_back(std::move(proc));
+			}
+			added_.clear();
+		}
+
+		fds.clear();
+		fd_owners.clear();
+		fds.push_back(pollfd{ wake_fds_[0], POLLIN, 0 });
+		for (std::shared_ptr<process>& proc : procs) {
+			if (proc->in_fd_ >= 0) {
+				fds.push_back(pollfd{ proc->in_fd_, POLLOUT, 0 });
+				fd_owners.emplace_back(proc.get(), &proc->in_fd_);
+			}
+			if (proc->out_fd_ >= 0) {
+				fds.push_back(pollfd{ proc->out_fd_, POLLIN, 0 });
+				fd_owners.emplace_back(proc.get(), &proc->out_fd_);
+			}
+			if (proc->err_fd_ >= 0) {
+				fds.push_back(pollfd{ proc->err_fd_, POLLIN, 0 });
+				fd_owners.emplace_back(proc.get(), &proc->err_fd_);
+			}
+		}
+
+		// Exits are only noticed by polling (whether or not the pipes are still open).
+		if (poll(fds.data(), (nfds_t) fds.size(), procs.empty() ? -1 : kExitPollMsec) == -1 && errno != EINTR) {
+			perror("ERROR [ExecModule] Failed to poll command pipes");
+		}
+
+		if (fds[0].revents != 0) {
+			char buffer[64];
+			while (read(wake_fds_[0], buffer, sizeof(buffer)) > 0) {}
+		}
+
+		for (size_t i = 1; i < fds.size(); i++) {
+			if (fds[i].revents == 0) {
+				continue;
+			}
+			process* proc = fd_owners[i - 1].first;
+			int* fd = fd_owners[i - 1].second;
+			if (fd == &proc->in_fd_) {
+				WriteAvailableInternal(proc->in_fd_, proc->input_, proc->input_written_);
+			} else {
+				ReadOutput(*proc, *fd);
+			}
+		}
+
+		for (size_t i = 0; i < procs.size();) {
+			process& proc = *procs[i];
+			if (Reap(proc)) {
+				Finish(proc);
+				procs[i] = std::move(procs.back());
+				procs.pop_back();
+			} else {
+				i++;
+			}
+		}
+	}
+}
+
+process::~process() {
+	if (in_fd_ >= 0) {
+		close(in_fd_);
+	}
+	if (out_fd_ >= 0) {
+		close(out_fd_);
+	}
+	if (err_fd_ >= 0) {
+		close(err_fd_);
+	}
+}
+
+bool process::running() {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return !exited_;
+}
+
+int process::wait() {
+	std::unique_lock<std::mutex> lock(mutex_);
+	exited_cv_.wait(lock, [this]() { return exited_; });
+	return exit_code_;
+}
+
+bool process::wait_for(const uint32_t timeout_ms) {
+	std::unique_lock<std::mutex> lock(mutex_);
+	return exited_cv_.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this]() { return exited_; });
+}
+
+int process::exit_code() {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return exited_ ? exit_code_ : -1;
+}
+
+bool process::signal(const int sig) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (exited_ || reaped_) {
+		return false;
+	}
+	return ::kill(pid_, sig) == 0;
+}
+
+bool process::terminate() {
+	return signal(SIGTERM);
+}
+
+bool process::kill() {
+	return signal(SIGKILL);
+}
+
+string process::out() {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return OwnedString(out_.data(), out_.size());
+}
+
+string process::err() {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return OwnedString(err_.data(), err_.size());
+}
+
+// Runs the command to completion on this thread, multiplexing all of the pipes with poll.
+static multireturn3<int, string, string> RunCaptureInternal(const std::string& shell, const std::string& command, const bool use_shell,
+	const std::string& input) {
+	ExecSpawnInternal spawn;
+	spawn.modes[0] = input.empty() ? EXEC_FD_DEVNULL : EXEC_FD_PIPE;
+	spawn.modes[1] = EXEC_FD_PIPE;
+	spawn.modes[2] = EXEC_FD_PIPE;
+
+	const pid_t pid = SpawnInternal(shell, command, use_shell, spawn);
+	if (pid < 0) {
+		return multireturn3<int, string, string>(-1, string(), string());
+	}
+
+	std::string out;
+	std::string err;
+	size_t input_written = 0;
+	const ExecOutputCallback no_callback;
+	WriteAvailableInternal(spawn.fds[0], input, input_written);
+
+	pollfd fds[3];
+	int return_code = -1;
+	bool exited = false;
+	while (spawn.fds[0] >= 0 || spawn.fds[1] >= 0 || spawn.fds[2] >= 0) {
+		for (int fd = 0; fd < 3; fd++) {
+			fds[fd].fd = spawn.fds[fd]; // Negative fds are ignored by poll.
+			fds[fd].events = fd == 0 ? POLLOUT : POLLIN;
+			fds[fd].revents = 0;
+		}
+		if (poll(fds, 3, kExitPollMsec) == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+			perror("ERROR [ExecModule] Failed to poll command pipes");
+			break;
+		}
+		if (fds[0].revents != 0) {
+			WriteAvailableInternal(spawn.fds[0], input, input_written);
+		}
+		if (fds[1].revents != 0) {
+			ReadAvailableInternal(spawn.fds[1], out, no_callback);
+		}
+		if (fds[2].revents != 0) {
+			ReadAvailableInternal(spawn.fds[2], err, no_callback);
+		}
+
+		// Output still in the pipes is read, but not waited for, as other processes may hold them open.
+		if (TryWaitInternal(pid, return_code)) {
+			exited = true;
+			ReadAvailableInternal(spawn.fds[1], out, no_callback);
+			ReadAvailableInternal(spawn.fds[2], err, no_callback);
+			break;
+		}
+	}
+	for (int fd = 0; fd < 3; fd++) {
+		if (spawn.fds[fd] >= 0) {
+			close(spawn.fds[fd]);
+		}
+	}
+
+	if (!exited) {
+		return_code = WaitInternal(pid);
+	}
+	return multireturn3<int, string, string>(return_code, OwnedString(out.data(), out.size()), OwnedString(err.data(), err.size()));
+}
+
+static int RunWithModesInternal(const std::string& shell, const std::string& command, const bool use_shell, const int mode) {
+	ExecSpawnInternal spawn;
+	spawn.modes[0] = mode;
+	spawn.modes[1] = mode;
+	spawn.modes[2] = mode;
+
+	const pid_t pid = SpawnInternal(shell, command, use_shell, spawn);
+	if (pid < 0) {
+		return -1;
+	}
+	return WaitInternal(pid);
+}
+
+int ExecModule::CheckAutoFail(const int return_code) const {
+	if (auto_fail_ && return_code != 0) {
+		if (auto_fail_msg_.empty()) {
+			log::Fatal("ExecModule", "Command failed with return code " + string::itoa(return_code));
+		} else {
+			log::Fatal("ExecModule", auto_fail_msg_);
+		}
+	}
+	return return_code;
+}
+
+int ExecModule::Run(const string& command) const {
+	return CheckAutoFail(RunWithModesInternal(StdString(shell_), StdString(command), false, EXEC_FD_DEVNULL));
+}
+
+int ExecModule::RunShell(const string& command) const {
+	return CheckAutoFail(RunWithModesInternal(StdString(shell_), StdString(command), true, EXEC_FD_DEVNULL));
+}
+
+int ExecModule::Stream(const string& command) const {
+	return CheckAutoFail(RunWithModesInternal(StdString(shell_), StdString(command), false, EXEC_FD_INHERIT));
+}
+
+int ExecModule::StreamShell(const string& command) const {
+	return CheckAutoFail(RunWithModesInternal(StdString(shell_), StdString(command), true, EXEC_FD_INHERIT));
+}
+
+multireturn3<int, string, string> ExecModule::RunGetOutput(const string& command) const {
+	multireturn3<int, string, string> result = RunCaptureInternal(StdString(shell_), StdString(command), false, std::string());
+	CheckAutoFail(result.item0);
+	return result;
+}
+
+multireturn3<int, string, string> ExecModule::RunGetOutputWithInput(const string& command, const string& input) const {
+	multireturn3<int, string, string> result = RunCaptureInternal(StdString(shell_), StdString(command), false, StdString(input));
+	CheckAutoFail(result.item0);
+	return result;
+}
+
+std::shared_ptr<process> ExecModule::RunAsync(const string& command, const ExecAsyncOptions& options) const {
+	ExecSpawnInternal spawn;
+	spawn.modes[0] = options.input.empty() ? EXEC_FD_DEVNULL : EXEC_FD_PIPE;
+	spawn.modes[1] = EXEC_FD_PIPE;
+	spawn.modes[2] = EXEC_FD_PIPE;
+
+	const pid_t pid = SpawnInternal(StdString(shell_), StdString(command), options.shell, spawn);
+	if (pid < 0) {
+		CheckAutoFail(-1);
+		return nullptr;
+	}
+
+	std::shared_ptr<process> proc = std::make_shared<process>();
+	proc->pid_ = pid;
+	proc->in_fd_ = spawn.fds[0];
+	proc->out_fd_ = spawn.fds[1];
+	proc->err_fd_ = spawn.fds[2];
+	proc->input_ = StdString(options.input);
+	proc->on_stdout_ = options.on_stdout;
+	proc->on_stderr_ = options.on_stderr;
+
+	ExecReactorInternal::Get().Add(proc);
+	return proc;
+}
+
+} // namespace arc
@@ -1,10 +1,79 @@
 #pragma once
 
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+
 #include "arc.h"
 #include "string.h"
 
+#include <sys/types.h>
+
 namespace arc {
 
+// Called with each chunk of output as it arrives, on the exec I/O thread (NOT the calling thread!)
+typedef std::function<void(const string& data)> ExecOutputCallback;
+
+struct ExecAsyncOptions {
+	bool shell = false; // Runs the command with the shell (see ExecModule::SetShell)
+	string input; // All of this is sent to stdin, which is then closed.
+
+	// When not set, the output is collected instead, and available from process::out()/err() once exited.
+	ExecOutputCallback on_stdout;
+	ExecOutputCallback on_stderr;
+};
+
+// A running (or exited) child process, from ExecModule::RunAsync.
+// All functions are thread safe.
+class process {
+public:
+	process() {}
+	~process(); // Note that the exec I/O thread holds a reference until the process has exited.
+
+	pid_t pid() const { return pid_; }
+
+	bool running();
+	int wait(); // Returns the exit code (128 + signal number if killed by a signal).
+	bool wait_for(const uint32_t timeout_ms); // Returns true if the process has exited.
+	int exit_code(); // -1 if still running.
+
+	bool terminate(); // SIGTERM, returns false if already exited.
+	bool kill(); // SIGKILL, returns false if already exited.
+
+	// The collected output (only without the matching callback), complete once exited.
+	string out();
+	string err();
+
+protected:
+	friend class ExecReactorInternal;
+	friend class ExecModule;
+
+	bool signal(const int sig);
+
+	pid_t pid_ = -1;
+
+	// Only used by the exec I/O thread:
+	int in_fd_ = -1;
+	int out_fd_ = -1;
+	int err_fd_ = -1;
+	std::string input_;
+	size_t input_written_ = 0;
+	ExecOutputCallback on_stdout_;
+	ExecOutputCallback on_stderr_;
+
+	std::mutex mutex_; // For everything below.
+	std::condition_variable exited_cv_;
+	std::string out_;
+	std::string err_;
+	bool exited_ = false; // Once the exit code and the output are complete.
+	bool reaped_ = false; // The pid may be reused once reaped, so it is never signaled after.
+	int exit_code_ = -1;
+
+	DELETE_COPY_AND_ASSIGN(process);
+};
+
 // WARNING: Never use this module (especially shell-based functions) with user input! (Santized may be okay, depending upon syntax.) //
 
 class ExecModule {
@@ -18,10 +87,16 @@ public:
 	void SetShell(const char* shell) { shell_ = shell; }
 	void SetShell(const string& shell) { shell_ = shell; }
 
+	// Commands without the shell are split into arguments on whitespace (with quotes and backslash
+	// escapes), and searched for in the PATH. All of these return the exit code, or -1 if the
+	// command could not be started.
+
+	// Runs the command without any input, and discards the output.
 	//int Run(const char* command);
 	int Run(const string& command) const;
 	int RunShell(const string& command) const;
 
+	// Runs the command with this process's stdin/stdout/stderr, so the output is shown as it runs.
 	//int Stream(const char* command);
 	int Stream(const string& command) const;
 	int StreamShell(const string& command) const;
@@ -35,9 +110,14 @@ public:
 
 	// TODO: Stdin with stream/link
 
-	// TODO: Run async with links for out, err, callback, wait, terminate/stop/pause, channels, promise/futures
+	// Starts the command and returns immediately. Any number of these can run at once, as all of
+	// their pipes are handled by one I/O thread. Returns nullptr if the command could not be started.
+	std::shared_ptr<process> RunAsync(const string& command, const ExecAsyncOptions& options = ExecAsyncOptions()) const;
+
+	// TODO: Async stop/pause, channels, promise/futures
 
 private:
+	int CheckAutoFail(const int return_code) const;
 	bool auto_fail_ = false;
 	string auto_fail_msg_;
 	string shell_ = "/bin/sh"; // TODO: Windows/etc!
@@ -1,24 +1,32 @@
 #include "file.h"
 
 #include "path.h"
+#include "io_ring.h"
+#include "thread.h"
+#include "log.h"
+#include "trace.h"
+
+#include <atomic>
+#include <memory>
+#include <vector>
 
 #include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 
-namespace arc {
+#ifndef _WIN32
+#include <unistd.h>
+#endif
 
-string FileModule::GetContents(const string& filename, const bool binary) const {
-	string file_path = filename;
-	
-	if (!path.IsAbsolute(file_path)) {
-		const string& working_dir = path.CurrentWorkingDirInternal();
-		if (working_dir.len() > 0) {
-			file_path = path.Join(working_dir, file_path);
-		}
-	}
+namespace arc {
 
+// Throws file_error on failure.
+static string ReadContentsInternal(const char* file_path, const bool binary) {
 	string file_contents;
 
-	FILE* f = fopen(file_path.c_str(), binary ? "rb" : "r");
+	FILE* f = fopen(file_path, binary ? "rb" : "r");
 	if (f == nullptr) {
 		perror("Error [FileModule.GetContents]: file open failed");
 		throw file_error("file open failed");
@@ -33,40 +41,26 @@ string FileModule::GetContents(const string& filename, const bool binary) const
 	rewind(f);
 	size_t size = ssize;
 
-	file_contents.reserve(size);
+	file_contents = string('\0', size);
 
 	if (fread(file_contents.mutable_data(), 1, size, f) != size) {
 		perror("Error [FileModule.GetContents]: file read failed");
 		fclose(f);
 		throw file_error("file read failed");
 	}
-	
-    fclose(f);
-    return file_contents;
-}
 
-array<string> FileModule::GetLines(const string& filename) const {
-	return GetContents(filename, false).split(string("\n"));
+	fclose(f);
+	return file_contents;
 }
 
-size_t FileModule::WriteContents(const string& filename, const string& data, const bool binary) const {
-	string file_path = filename;
-	
-	if (!path.IsAbsolute(file_path)) {
-		const string& working_dir = path.CurrentWorkingDirInternal();
-		if (working_dir.len() > 0) {
-			file_path = path.Join(working_dir, file_path);
-		}
-	}
-
-	FILE* f = fopen(file_path.c_str(), binary ? "wb" : "w"); // Note that this already truncates it to zero length.
+// Throws file_error on failure.
+static size_t WriteContentsInternal(const char* file_path, const unsigned char* bytes, const size_t len, const bool binary) {
+	FILE* f = fopen(file_path, binary ? "wb" : "w"); // Note that this already truncates it to zero length.
 	if (f == nullptr) {
 		perror("Error [FileModule.WriteContents]: file open for write failed");
 		throw file_error("file open failed");
 	}
 
-	const unsigned char* bytes = data.data();
-	const size_t len = data.len();
 	size_t written = fwrite(bytes, 1, len, f);
 
 	if (written != len) {
@@ -80,10 +74,484 @@ size_t FileModule::WriteContents(const string& filename, const string& data, con
 	return written;
 }
 
+// Note that strings are not thread safe (non-atomic reference counts), so anything handed to
+// another thread must be a fresh copy that only that thread references.
+static string OwnedCopy(const string& data) {
+	string copy('\0', data.len());
+	if (data.len() > 0) {
+		memcpy(copy.mutable_data(), data.data(), data.len());
+	}
+	return copy;
+}
+
+static std::string StdString(const string& str) {
+	return std::string((const char*) str.data(), str.len());
+}
+
+// Stat cache entries are keyed by the path as given, so both the given and full path are invalidated.
+static void InvalidateStatCacheInternal(const string& filename, const string& file_path) {
+	path.InvalidateStatCache(filename);
+	if (file_path != filename) {
+		path.InvalidateStatCache(file_path);
+	}
+}
+
+#ifdef __linux__
+// Largest single read/write, as the kernel limits these to just under 2 GB anyway.
+static const size_t kMaxRingTransfer = 1 << 30;
+
+// Read: openat -> fstat -> read (repeated on short reads) -> close
+// Deletes itself after calling the callback.
+class AsyncReadRequest : public io_ring_request {
+public:
+	AsyncReadRequest(io_ring* ring, const std::string& file_path, FileModule::ReadCallback callback)
+		: ring_(ring), path_(file_path), callback_(std::move(callback)) {}
+
+	bool start() { // Caller submits.
+		if (!ring_->queueOpenAt(this, path_.c_str(), O_RDONLY | O_CLOEXEC)) {
+			return false;
+		}
+		ARC_TRACE_ASYNC_BEGIN("FileModule::GetContentsAsync", this);
+		return true;
+	}
+
+	FileModule::ReadCallback& callback() { return callback_; } // For falling back when start() fails.
+
+	void complete(const int result) override {
+		switch (stage_) {
+		case Stage::OPEN:
+			if (result < 0) {
+				ARC_LOG_ERROR("FileModule.GetContentsAsync", "file open failed: " + string(strerror(-result)));
+				Finish();
+				return;
+			}
+			fd_ = result;
+			{
+				struct stat st;
+				if (fstat(fd_, &st) != 0) {
+					ARC_LOG_ERROR("FileModule.GetContentsAsync", "file stat failed: " + string(strerror(errno)));
+					Close();
+					return;
+				}
+				size_ = st.st_size > 0 ? (size_t) st.st_size : 0;
+			}
+			if (size_ == 0) {
+				ok_ = true;
+				Close();
+				return;
+			}
+			contents_ = string('\0', size_);
+			ReadNext();
+			return;
+		case Stage::READ:
+			if (result < 0) {
+				ARC_LOG_ERROR("FileModule.GetContentsAsync", "file read failed: " + string(strerror(-result)));
+				Close();
+				return;
+			}
+			if (result == 0) { // Truncated since the fstat, so just return what was read.
+				string truncated('\0', done_);
+				memcpy(truncated.mutable_data(), contents_.data(), done_);
+				contents_ = std::move(truncated);
+				ok_ = true;
+				Close();
+				return;
+			}
+			done_ += (size_t) result;
+			if (done_ < size_) {
+				ReadNext();
+			} else {
+				ok_ = true;
+				Close();
+			}
+			return;
+		case Stage::CLOSE:
+			fd_ = -1;
+			Finish();
+			return;
+		}
+	}
+
+protected:
+	enum class Stage { OPEN, READ, CLOSE };
+
+	void ReadNext() {
+		stage_ = Stage::READ;
+		const uint32_t len = (uint32_t) min(size_ - done_, kMaxRingTransfer);
+		if (!ring_->queueRead(this, fd_, contents_.mutable_data() + done_, len, done_)) {
+			ReadRemainingSync();
+			return;
+		}
+		ring_->submit();
+	}
+
+	void ReadRemainingSync() { // If the ring is out of space, finish on this thread instead.
+		while (done_ < size_) {
+			const ssize_t result = pread(fd_, contents_.mutable_data() + done_, size_ - done_, done_);
+			if (result <= 0) {
+				ARC_LOG_ERROR("FileModule.GetContentsAsync", "file read failed");
+				Close();
+				return;
+			}
+			done_ += (size_t) result;
+		}
+		ok_ = true;
+		Close();
+	}
+
+	void Close() {
+		stage_ = Stage::CLOSE;
+		if (!ring_->queueClose(this, fd_)) {
+			close(fd_);
+			fd_ = -1;
+			Finish();
+			return;
+		}
+		ring_->submit();
+	}
+
+	void Finish() {
+		if (!ok_) {
+			contents_ = string();
+		}
+		callback_(contents_, ok_);
+		ARC_TRACE_ASYNC_END("FileModule::GetContentsAsync", this);
+		delete this;
+	}
+
+	// NOT Owned:
+	io_ring* ring_;
+
+	std::string path_;
+	FileModule::ReadCallback callback_;
+	Stage stage_ = Stage::OPEN;
+	string contents_;
+	size_t size_ = 0;
+	size_t done_ = 0;
+	int fd_ = -1;
+	bool ok_ = false;
+};
+
+// Write: openat -> write (repeated on short writes) -> close
+// Deletes itself after calling the callback.
+class AsyncWriteRequest : public io_ring_request {
+public:
+	AsyncWriteRequest(io_ring* ring, const std::string& file_path, string&& data, FileModule::WriteCallback callback)
+		: ring_(ring), path_(file_path), data_(std::move(data)), callback_(std::move(callback)) {}
+
+	bool start() { // Caller submits.
+		if (!ring_->queueOpenAt(this, path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666)) {
+			return false;
+		}
+		ARC_TRACE_ASYNC_BEGIN("FileModule::WriteContentsAsync", this);
+		return true;
+	}
+
+	// For falling back when start() fails:
+	FileModule::WriteCallback& callback() { return callback_; }
+	string& data() { return data_; }
+
+	void complete(const int result) override {
+		switch (stage_) {
+		case Stage::OPEN:
+			if (result < 0) {
+				ARC_LOG_ERROR("FileModule.WriteContentsAsync", "file open for write failed: " + string(strerror(-result)));
+				Finish();
+				return;
+			}
+			fd_ = result;
+			WriteNext();
+			return;
+		case Stage::WRITE:
+			if (result <= 0) {
+				ARC_LOG_ERROR("FileModule.WriteContentsAsync", "file write failed: " + string(strerror(result < 0 ? -result : EIO)));
+				Close();
+				return;
+			}
+			written_ += (size_t) result;
+			WriteNext();
+			return;
+		case Stage::CLOSE:
+			fd_ = -1;
+			Finish();
+			return;
+		}
+	}
+
+protected:
+	enum class Stage { OPEN, WRITE, CLOSE };
+
+	void WriteNext() {
+		if (written_ >= data_.len()) {
+			ok_ = true;
+			Close();
+			return;
+		}
+		stage_ = Stage::WRITE;
+		const uint32_t len = (uint32_t) min(data_.len() - written_, kMaxRingTransfer);
+		if (!ring_->queueWrite(this, fd_, data_.data() + written_, len, written_)) {
+			WriteRemainingSync();
+			return;
+		}
+		ring_->submit();
+	}
+
+	void WriteRemainingSync() { // If the ring is out of space, finish on this thread instead.
+		while (written_ < data_.len()) {
+			const ssize_t result = pwrite(fd_, data_.data() + written_, data_.len() - written_, written_);
+			if (result <= 0) {
+				ARC_LOG_ERROR("FileModule.WriteContentsAsync", "file write failed");
+				Close();
+				return;
+			}
+			written_ += (size_t) result;
+		}
+		ok_ = true;
+		Close();
+	}
+
+	void Close() {
+		stage_ = Stage::CLOSE;
+		if (!ring_->queueClose(this, fd_)) {
+			close(fd_);
+			fd_ = -1;
+			Finish();
+			return;
+		}
+		ring_->submit();
+	}
+
+	void Finish() {
+		callback_(written_, ok_);
+		ARC_TRACE_ASYNC_END("FileModule::WriteContentsAsync", this);
+		delete this;
+	}
+
+	// NOT Owned:
+	io_ring* ring_;
+
+	std::string path_;
+	string data_;
+	FileModule::WriteCallback callback_;
+	Stage stage_ = Stage::OPEN;
+	size_t written_ = 0;
+	int fd_ = -1;
+	bool ok_ = false;
+};
+#endif // __linux__
+
+// Queues the read on the ring (without submitting), returns false if the thread pool must be used instead.
+static bool QueueReadOnRing(io_ring* ring, const std::string& file_path, FileModule::ReadCallback& callback) {
+#ifdef __linux__
+	if (ring == nullptr) {
+		return false;
+	}
+	AsyncReadRequest* req = new AsyncReadRequest(ring, file_path, std::move(callback));
+	if (!req->start()) {
+		callback = std::move(req->callback());
+		delete req;
+		return false;
+	}
+	return true;
+#else
+	return false;
+#endif
+}
+
+static void ReadOnPool(const std::string& file_path, FileModule::ReadCallback callback) {
+	thread_manager.Pool().run([file_path, callback]() {
+		ARC_TRACE_SCOPE("FileModule::GetContentsAsync");
+		bool ok = true;
+		string contents;
+		try {
+			contents = ReadContentsInternal(file_path.c_str(), true);
+		} catch (const file_error&) {
+			ok = false;
+		}
+		callback(contents, ok);
+	});
+}
+
+string FileModule::FullPath(const string& filename) const {
+	string file_path = filename;
+
+	if (!path.IsAbsolute(file_path)) {
+		const string& working_dir = path.CurrentWorkingDirInternal();
+		if (working_dir.len() > 0) {
+			file_path = path.Join(working_dir, file_path);
+		}
+	}
+
+	return file_path;
+}
+
+string FileModule::GetContents(const string& filename, const bool binary) const {
+	ARC_TRACE_SCOPE("FileModule::GetContents");
+	string file_path = FullPath(filename);
+	return ReadContentsInternal(file_path.c_str(), binary);
+}
+
+array<string> FileModule::GetLines(const string& filename) const {
+	return GetContents(filename, false).split(string("\n"));
+}
+
+size_t FileModule::WriteContents(const string& filename, const string& data, const bool binary) const {
+	ARC_TRACE_SCOPE("FileModule::WriteContents");
+	string file_path = FullPath(filename);
+	const size_t written = WriteContentsInternal(file_path.c_str(), data.data(), data.len(), binary);
+	InvalidateStatCacheInternal(filename, file_path);
+	return written;
+}
+
 size_t FileModule::WriteLines(const string& filename, const array<string>& data) const {
 	return WriteContents(filename, data.join(string("\n")), false);
 }
 
+void FileModule::GetContentsAsync(const string& filename, ReadCallback callback) const {
+	const std::string file_path = StdString(FullPath(filename));
+
+	io_ring* ring = SharedIoRing();
+	if (QueueReadOnRing(ring, file_path, callback)) {
+		ring->submit();
+		return;
+	}
+	ReadOnPool(file_path, std::move(callback));
+}
+
+void FileModule::WriteContentsAsync(const string& filename, const string& data, WriteCallback on_written) const {
+	const std::string file_path = StdString(FullPath(filename));
+	string owned_data = OwnedCopy(data);
+	const std::string name = StdString(filename);
+	WriteCallback callback = [on_written, name, file_path](const size_t written, const bool ok) {
+		InvalidateStatCacheInternal(string(name.c_str()), string(file_path.c_str()));
+		on_written(written, ok);
+	};
+
+#ifdef __linux__
+	io_ring* ring = SharedIoRing();
+	if (ring != nullptr) {
+		AsyncWriteRequest* req = new AsyncWriteRequest(ring, file_path, std::move(owned_data), std::move(callback));
+		if (req->start()) {
+			ring->submit();
+			return;
+		}
+		owned_data = std::move(req->data());
+		callback = std::move(req->callback());
+		delete req;
+	}
+#endif
+
+	// The string is moved into a shared_ptr so only the worker ever references it.
+	std::shared_ptr<string> shared_data = std::make_shared<string>(std::move(owned_data));
+	thread_manager.Pool().run([file_path, shared_data, callback]() {
+		ARC_TRACE_SCOPE("FileModule::WriteContentsAsync");
+		bool ok = true;
+		size_t written = 0;
+		try {
+			written = WriteContentsInternal(file_path.c_str(), shared_data->data(), shared_data->len(), true);
+		} catch (const file_error&) {
+			ok = false;
+		}
+		callback(written, ok);
+	});
+}
+
+std::future<string> FileModule::GetContentsAsync(const string& filename) const {
+	std::shared_ptr<std::promise<string>> promise = std::make_shared<std::promise<string>>();
+	std::future<string> result = promise->get_future();
+
+	GetContentsAsync(filename, [promise](string& contents, const bool ok) {
+		if (ok) {
+			promise->set_value(std::move(contents));
+		} else {
+			promise->set_exception(std::make_exception_ptr(file_error("file read failed")));
+		}
+	});
+
+	return result;
+}
+
+std::future<size_t> FileModule::WriteContentsAsync(const string& filename, const string& data) const {
+	std::shared_ptr<std::promise<size_t>> promise = std::make_shared<std::promise<size_t>>();
+	std::future<size_t> result = promise->get_future();
+
+	WriteContentsAsync(filename, data, [promise](const size_t written, const bool ok) {
+		if (ok) {
+			promise->set_value(written);
+		} else {
+			promise->set_exception(std::make_exception_ptr(file_error("file write failed")));
+		}
+	});
+
+	return result;
+}
+
+// Shared between all reads of one batch, the last read to finish fulfills the promise.
+struct FileBatchInternal {
+	explicit FileBatchInternal(const size_t count) : results(count), remaining(count) {}
+
+	std::vector<string> results; // Each read only writes its own index.
+	std::atomic<size_t> remaining;
+	std::atomic<bool> failed{ false };
+	std::promise<array<string>> promise;
+
+	void Done() {
+		if (remaining.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+			return;
+		}
+		if (failed.load()) {
+			promise.set_exception(std::make_exception_ptr(file_error("file read failed")));
+			return;
+		}
+		array<string> contents;
+		contents.reserve(results.size());
+		for (string& result : results) {
+			contents.append(std::move(result));
+		}
+		promise.set_value(std::move(contents));
+	}
+};
+
+std::future<array<string>> FileModule::GetContentsBatchAsync(const array<string>& filenames) const {
+	std::shared_ptr<FileBatchInternal> batch = std::make_shared<FileBatchInternal>(filenames.len());
+	std::future<array<string>> result = batch->promise.get_future();
+
+	if (filenames.len() == 0) {
+		batch->promise.set_value(array<string>());
+		return result;
+	}
+
+	// All of the opens go to the kernel in one submit, rather than one per file.
+	io_ring* ring = SharedIoRing();
+	bool queued = false;
+	for (size_t i = 0; i < filenames.len(); i++) {
+		const std::string file_path = StdString(FullPath(filenames[i]));
+		ReadCallback callback = [batch, i](string& contents, const bool ok) {
+			if (ok) {
+				batch->results[i] = std::move(contents);
+			} else {
+				batch->failed.store(true);
+			}
+			batch->Done();
+		};
+
+		if (QueueReadOnRing(ring, file_path, callback)) {
+			queued = true;
+		} else {
+			ReadOnPool(file_path, std::move(callback));
+		}
+	}
+	if (queued) {
+		ring->submit();
+	}
+
+	return result;
+}
+
+array<string> FileModule::GetContentsBatch(const array<string>& filenames) const {
+	return GetContentsBatchAsync(filenames).get();
+}
+
 bool FileModule::Exists(const string& filename) const {
 	return path.IsFile(filename);
 }
@@ -94,6 +562,7 @@ bool FileModule::Delete(const string& filename) const {
 		perror("Error [FileModule]: file delete failed");
 		return false;
 	}
+	InvalidateStatCacheInternal(filename, FullPath(filename));
 	return true;
 }
 
@@ -104,6 +573,8 @@ bool FileModule::Rename(const string& old_filename, const string& new_filename)
 		perror("Error [FileModule]: file rename failed");
 		return false;
 	}
+	InvalidateStatCacheInternal(old_filename, FullPath(old_filename));
+	InvalidateStatCacheInternal(new_filename, FullPath(new_filename));
 	return true;
 }
 
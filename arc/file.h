@@ -1,6 +1,8 @@
 #pragma once
 
 #include <exception>
+#include <functional>
+#include <future>
 #include <string>
 
 #include "string.h"
@@ -23,9 +25,33 @@ public:
 
 	bool Rename(const string& old_filename, const string& new_filename) const;
 
-	// TODO: GetContentsAsync, Stream, Append, Seek, File Class, TmpFile, etc.
+	// Asynchronous versions of the above, which never block the calling thread.
+	// These use io_uring when the kernel supports it, and the shared thread pool otherwise.
+	// Note that these always read/write in binary mode.
+
+	// Callbacks run on an I/O thread, NOT the calling thread! (ok is false when the file could not be read/written.)
+	// With io_uring that is the single completion thread shared by all async I/O, so keep callbacks
+	// short (hand longer work to the thread pool), and never wait on another async operation inside
+	// one (such as get() on a future from these), as that would deadlock.
+	typedef std::function<void(string& contents, const bool ok)> ReadCallback;
+	typedef std::function<void(const size_t written, const bool ok)> WriteCallback;
+
+	void GetContentsAsync(const string& filename, ReadCallback callback) const;
+	void WriteContentsAsync(const string& filename, const string& data, WriteCallback callback) const;
+
+	// The futures throw file_error from get() when the operation failed.
+	std::future<string> GetContentsAsync(const string& filename) const;
+	std::future<size_t> WriteContentsAsync(const string& filename, const string& data) const;
+
+	// Reads all of the files as one batch, with the results in the same order as filenames.
+	std::future<array<string>> GetContentsBatchAsync(const array<string>& filenames) const;
+	array<string> GetContentsBatch(const array<string>& filenames) const; // Waits for the whole batch.
+
+	// TODO: Stream, Append, Seek, File Class, TmpFile, etc.
 
 private:
+	string FullPath(const string& filename) const; // Relative to the working dir, if set.
+
 	DELETE_COPY_AND_ASSIGN(FileModule);
 } file;
 
@@ -0,0 +1,132 @@
+#include "frame_timing.h"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+namespace arc {
+
+//
+// FramePacer
+//
+
+void FramePacer::Init() {
+	ticks_per_msec_ = double(SDL_GetPerformanceFrequency()) / 1000.0;
+	min_margin_ticks_ = uint64_t(ticks_per_msec_ * 0.25);
+	max_margin_ticks_ = uint64_t(ticks_per_msec_ * 4.0);
+	margin_ticks_ = uint64_t(ticks_per_msec_ * 1.0); // About right for most timers, then adapts.
+}
+
+uint64_t FramePacer::WaitUntil(const uint64_t deadline) {
+	if (ticks_per_msec_ == 0.0) {
+		Init();
+	}
+	uint64_t now = SDL_GetPerformanceCounter();
+
+	if (now + margin_ticks_ < deadline) {
+		const uint32_t sleep_msec = (uint32_t) (double(deadline - now - margin_ticks_) / ticks_per_msec_);
+		if (sleep_msec > 0) {
+			const uint64_t sleep_start = now;
+			SDL_Delay(sleep_msec);
+			now = SDL_GetPerformanceCounter();
+
+			// How much longer than asked it slept, to keep the margin just above that.
+			const uint64_t asked = uint64_t(double(sleep_msec) * ticks_per_msec_);
+			const uint64_t slept = now - sleep_start;
+			const uint64_t oversleep = slept > asked ? slept - asked : 0;
+			const uint64_t wanted = oversleep + (oversleep / 4);
+			if (wanted > margin_ticks_) {
+				margin_ticks_ = wanted; // Rise at once, so the next deadline isn't missed too.
+			} else {
+				margin_ticks_ -= (margin_ticks_ - wanted) / 32;
+			}
+			margin_ticks_ = min(max(margin_ticks_, min_margin_ticks_), max_margin_ticks_);
+		}
+	}
+
+	while (now < deadline) {
+		std::this_thread::yield();
+		now = SDL_GetPerformanceCounter();
+	}
+	return now;
+}
+
+//
+// FrameTimeStats
+//
+
+FrameTimeStats::FrameTimeStats() {
+	samples_.resize(ARC_FRAME_TIME_WINDOW);
+	Clear();
+}
+
+size_t FrameTimeStats::Bucket(const double frame_msec) {
+	if (frame_msec <= 0.0) {
+		return 0;
+	}
+	const size_t bucket = (size_t) (frame_msec / ARC_FRAME_TIME_BUCKET_MSEC);
+	return bucket < ARC_FRAME_TIME_BUCKETS ? bucket : ARC_FRAME_TIME_BUCKETS - 1;
+}
+
+void FrameTimeStats::Add(const double frame_msec, const bool missed) {
+	Sample& sample = samples_[next_];
+	if (count_ == ARC_FRAME_TIME_WINDOW) { // Replace the oldest.
+		total_msec_ -= sample.msec;
+		histogram_[Bucket(sample.msec)]--;
+		if (sample.missed) {
+			missed_--;
+		}
+	} else {
+		count_++;
+	}
+
+	sample.msec = (float) frame_msec;
+	sample.missed = missed;
+	total_msec_ += sample.msec;
+	histogram_[Bucket(sample.msec)]++;
+	if (missed) {
+		missed_++;
+		total_missed_++;
+	}
+	total_frames_++;
+	next_ = (next_ + 1) % ARC_FRAME_TIME_WINDOW;
+}
+
+void FrameTimeStats::Clear() {
+	next_ = 0;
+	count_ = 0;
+	total_msec_ = 0.0;
+	missed_ = 0;
+	total_missed_ = 0;
+	total_frames_ = 0;
+	memset(histogram_, 0, sizeof(histogram_));
+}
+
+double FrameTimeStats::Percentile(const double percent) const {
+	if (count_ == 0) {
+		return 0.0;
+	}
+	sorted_.resize(count_);
+	for (size_t i = 0; i < count_; i++) {
+		sorted_[i] = samples_[i].msec; // The order doesn't matter here.
+	}
+	// Nearest rank, so P99 of less than 100 frames is the max.
+	const double rank = (min(max(percent, 0.0), 100.0) / 100.0) * double(count_);
+	size_t index = (size_t) rank;
+	if (double(index) < rank) {
+		index++;
+	}
+	index = index > 0 ? index - 1 : 0;
+	std::nth_element(sorted_.begin(), sorted_.begin() + index, sorted_.end());
+	return sorted_[index];
+}
+
+double FrameTimeStats::Max() const {
+	float longest = 0.0f;
+	for (size_t i = 0; i < count_; i++) {
+		longest = max(longest, samples_[i].msec);
+	}
+	return longest;
+}
+
+} // namespace arc
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "graphics.h"
+
+namespace arc {
+
+// Frame times kept for FrameTimeStats (about 4 seconds at 120 Hz).
+#define ARC_FRAME_TIME_WINDOW 512
+// The histogram has buckets of this many msec, with the last one for all longer frames.
+#define ARC_FRAME_TIME_BUCKET_MSEC 0.25
+#define ARC_FRAME_TIME_BUCKETS 200
+
+// Waits until a deadline in performance counter ticks (SDL_GetPerformanceCounter) more precisely
+// than SDL_Delay alone: Sleeps until the margin before the deadline, then spins for the rest.
+// The margin adapts to how much SDL_Delay oversleeps, rising at once and falling slowly.
+class FramePacer {
+public:
+	// Returns the performance counter when done (at or just after the deadline).
+	uint64_t WaitUntil(const uint64_t deadline);
+
+	double SleepMarginMsec() const { return ticks_per_msec_ > 0.0 ? double(margin_ticks_) / ticks_per_msec_ : 0.0; }
+
+private:
+	void Init(); // When first used, as SDL may not be initialized before.
+
+	double ticks_per_msec_ = 0.0;
+	uint64_t margin_ticks_ = 0;
+	uint64_t min_margin_ticks_ = 0;
+	uint64_t max_margin_ticks_ = 0;
+};
+
+// A rolling window of the last ARC_FRAME_TIME_WINDOW frame times, for measuring jitter.
+// Not thread safe, so only use it from the event loop thread (such as the frame draw function).
+class FrameTimeStats {
+public:
+	FrameTimeStats();
+
+	// missed is if the frame was later than its deadline.
+	void Add(const double frame_msec, const bool missed = false);
+	void Clear();
+
+	size_t Count() const { return count_; } // In the window.
+	// Of the frames in the window (0 if empty):
+	double Percentile(const double percent) const; // 0 to 100
+	double P50() const { return Percentile(50.0); }
+	double P99() const { return Percentile(99.0); }
+	double Max() const;
+	double Mean() const { return count_ > 0 ? total_msec_ / double(count_) : 0.0; }
+	size_t MissedDeadlines() const { return missed_; } // In the window.
+	uint64_t TotalMissedDeadlines() const { return total_missed_; } // Since started (or cleared).
+	uint64_t TotalFrames() const { return total_frames_; }
+
+	// Frames in the window from index * ARC_FRAME_TIME_BUCKET_MSEC up to the next bucket.
+	uint32_t HistogramBucket(const size_t index) const { return index < ARC_FRAME_TIME_BUCKETS ? histogram_[index] : 0; }
+
+private:
+	static size_t Bucket(const double frame_msec);
+
+	struct Sample {
+		float msec;
+		bool missed;
+	};
+	std::vector<Sample> samples_; // Ring buffer, the oldest at next_ when full.
+	size_t next_ = 0;
+	size_t count_ = 0;
+	double total_msec_ = 0.0;
+	size_t missed_ = 0;
+	uint64_t total_missed_ = 0;
+	uint64_t total_frames_ = 0;
+	uint32_t histogram_[ARC_FRAME_TIME_BUCKETS];
+
+	mutable std::vector<float> sorted_; // For Percentile, to not allocate every time.
+};
+
+} // namespace arc
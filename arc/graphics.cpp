@@ -1,6 +1,14 @@
 #include "graphics.h"
 
 #include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+#include "atlas.h"
+#include "raster.h"
+#include "thread.h"
 
 namespace arc {
 
@@ -13,7 +21,7 @@ GraphicsModule graphics;
 
 void CheckError(const int sdl_return) {
 	if (sdl_return < 0) {
-		log::Error(string("SDL render error: ") + SDL_GetError());
+		ARC_LOG_ERROR(string("SDL render error: ") + SDL_GetError());
 	}
 }
 
@@ -54,12 +62,22 @@ Screen::~Screen() {
 	if (window_ != nullptr) {
 		SDL_DestroyWindow(window_);
 	}
+	if (surface_ != nullptr) {
+		SDL_FreeSurface(surface_);
+	}
 }
 
 SDL_Renderer* Screen::renderer() {
 	if (renderer_ != nullptr) {
 		return renderer_;
 	}
+	if (surface_ != nullptr) {
+		renderer_ = SDL_CreateSoftwareRenderer(surface_);
+		if (renderer_ == nullptr) {
+			log::Fatal("Screen", string("SDL create software renderer error: ") + SDL_GetError());
+		}
+		return renderer_;
+	}
 	renderer_ = SDL_CreateRenderer(window_, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC); // TODO: Enable disabling vsync!
 	if (properties_.type == SCREEN_FULLSCREEN && (properties_.width > 0 || properties_.height > 0)) { // TODO: Mobile screen scaling
 		if (properties_.width <= 0 || properties_.height <= 0) {
@@ -93,20 +111,31 @@ void Screen::RecalculateWidthHeightFromRendererAspectRatio() {
 void Screen::setTitle(const string& new_title) {
 	if (properties_.title != new_title) {
 		properties_.title = new_title;
-		SDL_SetWindowTitle(window_, properties_.title.c_str());
+		if (window_ != nullptr) {
+			SDL_SetWindowTitle(window_, properties_.title.c_str());
+		}
 	}
 }
 
 int Screen::width() {
-	SDL_GetWindowSize(window_, &(properties_.width), &(properties_.height));
+	if (window_ != nullptr) {
+		SDL_GetWindowSize(window_, &(properties_.width), &(properties_.height));
+	}
 	return properties_.width;
 }
 int Screen::height() {
-	SDL_GetWindowSize(window_, &(properties_.width), &(properties_.height));
+	if (window_ != nullptr) {
+		SDL_GetWindowSize(window_, &(properties_.width), &(properties_.height));
+	}
 	return properties_.height;
 }
 
 void Screen::resizeTo(const int width, const int height) {
+	if (window_ == nullptr) {
+		// The software renderer (and so all of its textures) is tied to the surface size.
+		ARC_LOG_WARN("Screen", "headless screens can't be resized");
+		return;
+	}
 	properties_.width = width;
 	properties_.height = height;
 	SDL_SetWindowSize(window_, width, height);
@@ -130,38 +159,52 @@ int Screen::renderHeight() {
 
 void Screen::show() {
 	properties_.hidden = false;
-	SDL_ShowWindow(window_);
+	if (window_ != nullptr) {
+		SDL_ShowWindow(window_);
+	}
 }
 
 void Screen::hide() {
 	properties_.hidden = true;
-	SDL_HideWindow(window_);
+	if (window_ != nullptr) {
+		SDL_HideWindow(window_);
+	}
 }
 
 void Screen::focus() {
-	SDL_RaiseWindow(window_);
+	if (window_ != nullptr) {
+		SDL_RaiseWindow(window_);
+	}
 }
 
 // TODO: OpenGL context with SDL_GL_CreateContext
 
 int Screen::xPos() {
-	SDL_GetWindowPosition(window_, &(properties_.xpos), &(properties_.ypos));
+	if (window_ != nullptr) {
+		SDL_GetWindowPosition(window_, &(properties_.xpos), &(properties_.ypos));
+	}
 	return properties_.xpos;
 }
 
 int Screen::yPos() {
-	SDL_GetWindowPosition(window_, &(properties_.xpos), &(properties_.ypos));
+	if (window_ != nullptr) {
+		SDL_GetWindowPosition(window_, &(properties_.xpos), &(properties_.ypos));
+	}
 	return properties_.ypos;	
 }
 
 void Screen::center() {
-	SDL_SetWindowPosition(window_, SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED);
+	if (window_ != nullptr) {
+		SDL_SetWindowPosition(window_, SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED);
+	}
 }
 
 void Screen::moveTo(const int xpos, const int ypos) {
 	properties_.xpos = xpos;
 	properties_.ypos = ypos;
-	SDL_SetWindowPosition(window_, xpos, ypos);
+	if (window_ != nullptr) {
+		SDL_SetWindowPosition(window_, xpos, ypos);
+	}
 }
 
 //
@@ -193,6 +236,7 @@ Sprite::~Sprite() {
 	if (texture_ != nullptr && !is_sub_) {
 		SDL_DestroyTexture(texture_);
 	}
+	delete source_;
 }
 
 bool Sprite::sub_region(SDL_Rect& rect) const {
@@ -215,16 +259,17 @@ bool Sprite::sub_region(SDL_Rect& rect, const int x, const int y, const int widt
 	rect.y = sub_y_ + y;
 	rect.w = width;
 	rect.h = height;
+	// Checked in this sprite's coordinates, as sub-sprites can be anywhere in the texture.
 	if (allow_crop) {
-		if (rect.x + width > width_) {
-			rect.w = width_ - rect.x;
+		if (x + width > width_) {
+			rect.w = width_ - x;
 		}
-		if (rect.y + height > height_) {
-			rect.h = height_ - rect.y;
+		if (y + height > height_) {
+			rect.h = height_ - y;
 		}
 	}
-	if (rect.x >= width_ || rect.y >= height_ || rect.x + rect.w > width_ || rect.y + rect.h > height_) {
-		log::Error("Sprite", "Invalid sprite drawing coordinates.");
+	if (x < 0 || y < 0 || x >= width_ || y >= height_ || x + rect.w > width_ || y + rect.h > height_) {
+		ARC_LOG_ERROR("Sprite", "Invalid sprite drawing coordinates.");
 		ok = false;
 		return false;
 	}
@@ -232,6 +277,15 @@ bool Sprite::sub_region(SDL_Rect& rect, const int x, const int y, const int widt
 	return true;
 }
 
+bool Sprite::reload() {
+	return render.ReloadSprite(*this);
+}
+
+void Sprite::enableAlphaBlending() {
+	render.FlushBatch(); // In case any queued draws use this texture.
+	SDL_SetTextureBlendMode(texture_, SDL_BLENDMODE_BLEND);
+}
+
 void Sprite::SetRenderParams() {
 	if (has_color_mod()) { // TODO: Doesn't work for empty/none texture mod! (If previously set) //
 		SDL_SetTextureColorMod(texture_, color_mod_.r, color_mod_.g, color_mod_.b);
@@ -241,6 +295,231 @@ void Sprite::SetRenderParams() {
 	}
 }
 
+//
+// Sprite sources (for reloading)
+//
+
+SpriteSource* FileSpriteSource(const string& file_path, const bool bitmap) {
+	SpriteSource* source = new SpriteSource();
+	source->file_path.assign((const char*) file_path.data(), file_path.len()); // Used by other threads.
+	source->bitmap = bitmap;
+	return source;
+}
+
+// Run-length encodes 32-bit pixels, only if smaller than the (tightly packed) pixels.
+void CompactSpriteSource(SpriteSource& source) {
+	if (source.pixels.empty() || SDL_BYTESPERPIXEL(source.format) != 4) {
+		return;
+	}
+	const uint32_t* pixels = (const uint32_t*) source.pixels.data();
+	const size_t len = source.pixels.size() / 4;
+	const size_t max_runs = len / 2; // Each run is two values.
+
+	std::vector<uint32_t> runs;
+	size_t i = 0;
+	while (i < len) {
+		const uint32_t pixel = pixels[i];
+		size_t count = 1;
+		while (i + count < len && pixels[i + count] == pixel && count < UINT32_MAX) {
+			count++;
+		}
+		if (runs.size() / 2 >= max_runs) {
+			return; // Not worth it, keep the pixels.
+		}
+		runs.push_back((uint32_t) count);
+		runs.push_back(pixel);
+		i += count;
+	}
+
+	runs.shrink_to_fit();
+	source.runs.swap(runs);
+	std::vector<uint8_t>().swap(source.pixels);
+}
+
+// Copies the pixels without row padding, returns false if the format has no fixed pixel size.
+bool SetSpriteSourcePixels(SpriteSource& source, const void* pixels, const int bytes_per_row) {
+	const size_t bpp = SDL_BYTESPERPIXEL(source.format);
+	if (bpp == 0 || SDL_ISPIXELFORMAT_FOURCC(source.format) || source.width <= 0 || source.height <= 0) {
+		return false;
+	}
+	const size_t row_len = bpp * size_t(source.width);
+	source.runs.clear();
+	source.pixels.resize(row_len * size_t(source.height));
+
+	const uint8_t* src = (const uint8_t*) pixels;
+	for (int y = 0; y < source.height; y++) {
+		memcpy(source.pixels.data() + (row_len * size_t(y)), src + (size_t(bytes_per_row) * size_t(y)), row_len);
+	}
+	CompactSpriteSource(source);
+	return true;
+}
+
+// Writes the pixels to dst, with pitch bytes per row.
+void DecodeSpriteSource(const SpriteSource& source, uint8_t* dst, const int pitch) {
+	const size_t row_len = SDL_BYTESPERPIXEL(source.format) * size_t(source.width);
+	if (source.runs.empty()) {
+		for (int y = 0; y < source.height; y++) {
+			memcpy(dst + (size_t(pitch) * size_t(y)), source.pixels.data() + (row_len * size_t(y)), row_len);
+		}
+		return;
+	}
+
+	// Runs can continue across rows.
+	const size_t width = size_t(source.width);
+	size_t x = 0;
+	size_t y = 0;
+	uint32_t* row = (uint32_t*) dst;
+	for (size_t r = 0; r + 1 < source.runs.size() && y < size_t(source.height); r += 2) {
+		size_t count = source.runs[r];
+		const uint32_t pixel = source.runs[r + 1];
+		while (count > 0 && y < size_t(source.height)) {
+			const size_t n = min(count, width - x);
+			std::fill(row + x, row + x + n, pixel);
+			count -= n;
+			x += n;
+			if (x == width) {
+				x = 0;
+				y++;
+				row = (uint32_t*) (dst + (size_t(pitch) * y));
+			}
+		}
+	}
+}
+
+void ExpandSpriteSource(SpriteSource& source) {
+	if (source.runs.empty()) {
+		return;
+	}
+	const int row_len = SDL_BYTESPERPIXEL(source.format) * source.width;
+	source.pixels.resize(size_t(row_len) * size_t(source.height));
+	DecodeSpriteSource(source, source.pixels.data(), row_len);
+	std::vector<uint32_t>().swap(source.runs);
+}
+
+// The source must be expanded first, x and y are in texture coordinates.
+void PatchSpriteSource(SpriteSource& source, const int x, const int y, const DataBuffer& data) {
+	const size_t bpp = SDL_BYTESPERPIXEL(source.format);
+	const int x_start = max(x, 0);
+	const int y_start = max(y, 0);
+	const int x_end = min(x + data.width, source.width);
+	const int y_end = min(y + data.height, source.height);
+	if (x_start >= x_end || y_start >= y_end) {
+		return;
+	}
+	const size_t row_len = bpp * size_t(source.width);
+	const size_t copy_len = bpp * size_t(x_end - x_start);
+	const uint8_t* src = (const uint8_t*) data.data;
+	for (int sy = y_start; sy < y_end; sy++) {
+		memcpy(source.pixels.data() + (row_len * size_t(sy)) + (bpp * size_t(x_start)),
+			src + (size_t(data.bytes_per_row) * size_t(sy - y)) + (bpp * size_t(x_start - x)), copy_len);
+	}
+}
+
+// format itself if the renderer supports it, otherwise a supported format that raster::ConvertPixels
+// can convert it to (so that SDL doesn't have to, with its slower generic conversion).
+// Alpha isn't dropped by choosing RGB565 for 32-bit pixels.
+uint32_t NativeTextureFormat(const SDL_RendererInfo& info, const uint32_t format) {
+	if (!raster::IsConvertibleFormat(format)) {
+		return format;
+	}
+	uint32_t found = format;
+	for (Uint32 i = 0; i < info.num_texture_formats; i++) {
+		const uint32_t f = info.texture_formats[i];
+		if (f == format) {
+			return format;
+		}
+		if (found == format && raster::IsConvertibleFormat(f)
+			&& (f != SDL_PIXELFORMAT_RGB565 || format == SDL_PIXELFORMAT_RGB565)) {
+			found = f;
+		}
+	}
+	return found;
+}
+
+// Converts the surface to a native texture format, if needed (and possible) before creating a texture
+// from it, returning the new surface (the old one is freed), or the same one. Safe to call on other threads.
+SDL_Surface* ConvertSurfaceToNative(SDL_Surface* surface, const SDL_RendererInfo& info) {
+	Uint32 key = 0;
+	const uint32_t format = surface->format->format;
+	const uint32_t native = NativeTextureFormat(info, format);
+	if (native == format || SDL_GetColorKey(surface, &key) == 0) {
+		return surface; // SDL converts color keyed surfaces to alpha.
+	}
+	SDL_Surface* converted = SDL_CreateRGBSurfaceWithFormat(0, surface->w, surface->h, SDL_BITSPERPIXEL(native), native);
+	if (converted == nullptr) {
+		return surface;
+	}
+
+	SDL_LockSurface(surface);
+	SDL_LockSurface(converted);
+	DataBuffer src;
+	src.data = surface->pixels;
+	src.format = format;
+	src.width = surface->w;
+	src.height = surface->h;
+	src.bytes_per_row = surface->pitch;
+	DataBuffer dst = src;
+	dst.data = converted->pixels;
+	dst.format = native;
+	dst.bytes_per_row = converted->pitch;
+	const bool ok = raster::ConvertPixels(src, dst);
+	SDL_UnlockSurface(converted);
+	SDL_UnlockSurface(surface);
+
+	if (!ok) {
+		SDL_FreeSurface(converted);
+		return surface;
+	}
+	SDL_FreeSurface(surface);
+	return converted;
+}
+
+// Safe to call on other threads, sets error on failure.
+// If info is given, the surface is converted to a native texture format, see ConvertSurfaceToNative.
+SDL_Surface* SurfaceFromSpriteSource(const SpriteSource& source, std::string& error, const SDL_RendererInfo* info) {
+	if (!source.file_path.empty()) {
+		SDL_Surface* surface = source.bitmap ? SDL_LoadBMP(source.file_path.c_str()) : IMG_Load(source.file_path.c_str());
+		if (surface == nullptr) {
+			error = (source.bitmap ? "Unable to load bitmap: " : "Unable to load image: ") + source.file_path + " " + SDL_GetError();
+		} else if (info != nullptr) {
+			surface = ConvertSurfaceToNative(surface, *info);
+		}
+		return surface;
+	}
+
+	SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(
+		0, source.width, source.height, SDL_BITSPERPIXEL(source.format), source.format);
+	if (surface == nullptr) {
+		error = std::string("Unable to create surface for sprite source: ") + SDL_GetError();
+		return nullptr;
+	}
+	SDL_LockSurface(surface);
+	DecodeSpriteSource(source, (uint8_t*) surface->pixels, surface->pitch);
+	SDL_UnlockSurface(surface);
+	return info != nullptr ? ConvertSurfaceToNative(surface, *info) : surface;
+}
+
+// Copies row_bytes of each row, for when the source and destination pitch differ.
+void CopyPixelRows(void* dst, const int dst_pitch, const void* src, const int src_pitch, const int row_bytes,
+	const int rows) {
+	uint8_t* d = (uint8_t*) dst;
+	const uint8_t* s = (const uint8_t*) src;
+	for (int y = 0; y < rows; y++) {
+		memcpy(d + (size_t(dst_pitch) * size_t(y)), s + (size_t(src_pitch) * size_t(y)), row_bytes);
+	}
+}
+
+// The same pixels, only a smaller view of them. The region must be inside data.
+DataBuffer DataBufferRegion(const DataBuffer& data, const int x, const int y, const int width, const int height) {
+	const size_t pixel_bytes = SDL_BYTESPERPIXEL(data.format);
+	DataBuffer region = data;
+	region.data = (uint8_t*) data.data + (size_t(y) * size_t(data.bytes_per_row)) + (size_t(x) * pixel_bytes);
+	region.width = width;
+	region.height = height;
+	region.len = (size_t(height - 1) * size_t(data.bytes_per_row)) + (size_t(width) * pixel_bytes);
+	return region;
+}
+
 //
 // RenderModule
 //
@@ -248,10 +527,20 @@ void Sprite::SetRenderParams() {
 RenderModule::~RenderModule() {
 	screen_ = nullptr;
 	renderer_ = nullptr;
-	deleteallslotvector(sprites_);
+	for (PixelTextPage& page : text_pages_) {
+		delete page.packer; // The sprites are deleted below.
+	}
+	for (PendingReadback& readback : readbacks_) {
+		SDL_DestroyTexture(readback.copy);
+	}
+	for (ReleasedTexture& released : released_textures_) {
+		SDL_DestroyTexture(released.texture);
+	}
+	sprites_.clear();
 }
 
 void RenderModule::SetScreenContext(Screen& screen) { // Set the screen to render to currently.
+	FlushBatch();
 	screen_ = &screen;
 	renderer_ = screen.renderer();
 	ClearSpriteContext();
@@ -261,37 +550,132 @@ void RenderModule::SetSpriteContext(Sprite& sprite) { // Render to a sprite inst
 	if (!sprite.is_render()) {
 		throw graphics_error("cannot set a non-rendering sprite as a render target");
 	}
+	if (recording_) {
+		ARC_LOG_ERROR("RenderModule", "the render target changed while recording commands");
+	}
+	FlushBatch();
 	SDL_SetRenderTarget(renderer_, sprite.texture());
+	SpriteChanged(sprite); // Drawn to from now on.
 	ClearDrawOffset();
+	ClearClipRect();
 }
 
 void RenderModule::ClearSpriteContext() { // Render to the screen again.
+	if (recording_) {
+		ARC_LOG_ERROR("RenderModule", "the render target changed while recording commands");
+	}
+	FlushBatch();
 	SDL_SetRenderTarget(renderer_, NULL);
 	ClearDrawOffset();
+	ClearClipRect();
+}
+
+void RenderModule::SetClipRect(const int x, const int y, const int width, const int height) {
+	FlushBatch();
+	clip_rect_ = SDL_Rect_From_Coordinates(x, y, width, height);
+	has_clip_ = true;
+	SDL_RenderSetClipRect(renderer_, &clip_rect_);
+}
+
+void RenderModule::ClearClipRect() {
+	FlushBatch();
+	has_clip_ = false;
+	SDL_RenderSetClipRect(renderer_, NULL);
+}
+
+void RenderModule::PushClip(const int x, const int y, const int width, const int height) {
+	ClipState previous;
+	previous.rect = clip_rect_;
+	previous.has_clip = has_clip_;
+	clip_stack_.push_back(previous);
+
+	int x_start = off_x_ + x;
+	int y_start = off_y_ + y;
+	int x_end = x_start + max(width, 0);
+	int y_end = y_start + max(height, 0);
+	if (has_clip_) { // Only the part inside both.
+		x_start = max(x_start, clip_rect_.x);
+		y_start = max(y_start, clip_rect_.y);
+		x_end = min(x_end, clip_rect_.x + clip_rect_.w);
+		y_end = min(y_end, clip_rect_.y + clip_rect_.h);
+	}
+	// If they don't overlap this is empty, so everything is clipped out.
+	const SDL_Rect rect = SDL_Rect_From_Coordinates(x_start, y_start, max(x_end - x_start, 0), max(y_end - y_start, 0));
+	ApplyClip(true, rect);
+}
+
+void RenderModule::PopClip() {
+	if (clip_stack_.empty()) {
+		ARC_LOG_ERROR("RenderModule", "PopClip called without a matching PushClip");
+		return;
+	}
+	const ClipState previous = clip_stack_.back();
+	clip_stack_.pop_back();
+	ApplyClip(previous.has_clip, previous.rect);
+}
+
+void RenderModule::ApplyClip(const bool has_clip, const SDL_Rect& rect) {
+	if (has_clip == has_clip_ && (!has_clip || (rect.x == clip_rect_.x && rect.y == clip_rect_.y &&
+		rect.w == clip_rect_.w && rect.h == clip_rect_.h))) {
+		return;
+	}
+	if (has_clip) {
+		SetClipRect(rect.x, rect.y, rect.w, rect.h);
+	} else {
+		ClearClipRect();
+	}
+}
+
+bool RenderModule::IsClippedOut(const int x, const int y, const int width, const int height) const {
+	if (width <= 0 || height <= 0) {
+		return true;
+	}
+	if (!has_clip_) {
+		return false;
+	}
+	const int x_start = off_x_ + x;
+	const int y_start = off_y_ + y;
+	return x_start >= clip_rect_.x + clip_rect_.w || y_start >= clip_rect_.y + clip_rect_.h ||
+		x_start + width <= clip_rect_.x || y_start + height <= clip_rect_.y;
 }
 
 void RenderModule::Clear() {
 	if (renderer_ == nullptr) { return; }
+	if (recording_) {
+		Clear(clear_color_);
+		return;
+	}
+	FlushBatch();
 	CheckError(SDL_SetRenderDrawColor(renderer_, clear_color_.r, clear_color_.g, clear_color_.b, clear_color_.a));
 	CheckError(SDL_RenderClear(renderer_));
 }
 
 void RenderModule::Clear(const Color& color) {
 	if (renderer_ == nullptr) { return; }
+	if (recording_) {
+		RenderCommand& c = RecordCommand(ARC_RENDER_CLEAR);
+		c.color = { color.r, color.g, color.b, color.a };
+		return;
+	}
+	FlushBatch();
 	CheckError(SDL_SetRenderDrawColor(renderer_, color.r, color.g, color.b, color.a));
 	CheckError(SDL_RenderClear(renderer_));
 }
 
 void RenderModule::DrawRect(const int x, const int y, const int width, const int height) {
-	if (renderer_ == nullptr) { return; }
-	SDL_Rect r = SDL_Rect_From_Coordinates(off_x_ + x, off_y_ + y, width, height);
-	CheckError(SDL_SetRenderDrawColor(renderer_, draw_color_.r, draw_color_.g, draw_color_.b, draw_color_.a));
-	CheckError(SDL_RenderFillRect(renderer_, &r));
+	DrawRect(x, y, width, height, draw_color_);
 }
 
 void RenderModule::DrawRect(const int x, const int y, const int width, const int height, const Color& color) {
 	if (renderer_ == nullptr) { return; }
 	SDL_Rect r = SDL_Rect_From_Coordinates(off_x_ + x, off_y_ + y, width, height);
+	if (recording_) {
+		RenderCommand& c = RecordCommand(ARC_RENDER_RECT);
+		c.dst = r;
+		c.color = { color.r, color.g, color.b, color.a };
+		return;
+	}
+	FlushBatch();
 	CheckError(SDL_SetRenderDrawColor(renderer_, color.r, color.g, color.b, color.a));
 	CheckError(SDL_RenderFillRect(renderer_, &r));
 }
@@ -299,161 +683,56 @@ void RenderModule::DrawRect(const int x, const int y, const int width, const int
 void RenderModule::DrawRectBorder(const int x, const int y, const int width, const int height, const Color& color) {
 	if (renderer_ == nullptr) { return; }
 	SDL_Rect r = SDL_Rect_From_Coordinates(off_x_ + x, off_y_ + y, width, height);
+	if (recording_) {
+		RenderCommand& c = RecordCommand(ARC_RENDER_RECT_BORDER);
+		c.dst = r;
+		c.color = { color.r, color.g, color.b, color.a };
+		return;
+	}
+	FlushBatch();
 	CheckError(SDL_SetRenderDrawColor(renderer_, color.r, color.g, color.b, color.a));
 	CheckError(SDL_RenderDrawRect(renderer_, &r));
 }
 
 void RenderModule::DrawLine(const int x_start, const int y_start, const int x_end, const int y_end) {
-	if (renderer_ == nullptr) { return; }
-	CheckError(SDL_SetRenderDrawColor(renderer_, draw_color_.r, draw_color_.g, draw_color_.b, draw_color_.a));
-	CheckError(SDL_RenderDrawLine(renderer_, off_x_ + x_start, off_y_ + y_start, off_x_ + x_end, off_y_ + y_end));
+	DrawLine(x_start, y_start, x_end, y_end, draw_color_);
 }
 
 void RenderModule::DrawLine(const int x_start, const int y_start, const int x_end, const int y_end, const Color& color) {
 	if (renderer_ == nullptr) { return; }
-	CheckError(SDL_SetRenderDrawColor(renderer_, color.r, color.g, color.b, color.a));
-	CheckError(SDL_RenderDrawLine(renderer_, off_x_ + x_start, off_y_ + y_start, off_x_ + x_end, off_y_ + y_end));
-}
-
-#define A_MASK 0xFF000000
-#define R_MASK 0x00FF0000
-#define G_MASK 0x0000FF00
-#define B_MASK 0x000000FF
-#define RGB_MASK 0x00FFFFFF
-
-// Mixes the two colors, based on the alpha of the addition.
-// Keeps the original alpha the same.
-void internal_32_addition_alpha_blend(uint32_t& original, const uint32_t addition) {
-	const uint32_t add_alpha = (addition & A_MASK) >> 24;
-	if (add_alpha == 0) {
-		return; // No changes.
-	}
-
-	const uint32_t a = original & A_MASK;
-	if (add_alpha == 0xFF) {
-		original = a + (addition & RGB_MASK); // Replace color entirely.
-	}
-
-	const uint32_t orig_alpha = 0xFF - add_alpha;
-	
-	const uint32_t r = (((original & R_MASK) * orig_alpha / 0xFF) + ((addition & R_MASK) * add_alpha / 0xFF)) & R_MASK;
-	const uint32_t g = (((original & G_MASK) * orig_alpha / 0xFF) + ((addition & G_MASK) * add_alpha / 0xFF)) & G_MASK;
-	const uint32_t b = (((original & B_MASK) * orig_alpha / 0xFF) + ((addition & B_MASK) * add_alpha / 0xFF)) & B_MASK;
-	original = a + r + g + b;
-}
-
-// Mixes the two colors, and sets the alpha (must be 0x00 - 0xFF)
-void internal_32_color_blend(uint32_t& original, const uint32_t addition, const uint32_t alpha) {
-	const uint32_t r = ((original & R_MASK) * 7 / 8 + (addition & R_MASK) / 8) & R_MASK;
-	const uint32_t g = ((original & G_MASK) * 7 / 8 + (addition & G_MASK) / 8) & G_MASK;
-	const uint32_t b = ((original & B_MASK) * 7 / 8 + (addition & B_MASK) / 8) & B_MASK;
-	original = ((alpha << 24) & A_MASK) + r + g + b;
-}
-
-void internal_32_alpha_blend(uint32_t& original, const uint32_t addition) {
-	uint32_t alpha = (original & A_MASK) >> 24;
-	if (alpha == 0x00) {
-		original = (0x40 << 24) + (addition & RGB_MASK); // Set to 1/4 alpha.
+	if (recording_) {
+		RenderCommand& c = RecordCommand(ARC_RENDER_LINE);
+		c.dst = SDL_Rect_From_Coordinates(off_x_ + x_start, off_y_ + y_start, off_x_ + x_end, off_y_ + y_end);
+		c.color = { color.r, color.g, color.b, color.a };
 		return;
-	} else if (alpha < 0xFF) {
-		if (alpha == 0xC0) {
-			alpha = 0xFF;
-		} else {
-			alpha += 0x40;
-		}
-	}
-	internal_32_color_blend(original, addition, alpha);
-}
-
-// TODO: Selectable Blending Value //
-void internal_draw_point(uint32_t* pixel_data,
-	const int x, const int y, const int w, const int h,
-	const int thickness, const uint32_t pixel_value, const bool blending) {
-	if (thickness > 1) {
-		for (int yt = y; yt < y + thickness && yt < h; yt++) {
-			for (int xt = x; xt < x + thickness && xt < w; xt++) {
-				const int pos = (yt * w) + xt;
-				if (blending) {
-					internal_32_alpha_blend(pixel_data[pos], pixel_value);
-				} else {
-					pixel_data[pos] = pixel_value;
-				}
-			}
-		}
-	} else {
-		pixel_data[(y * w) + x] = pixel_value;
 	}
+	FlushBatch();
+	CheckError(SDL_SetRenderDrawColor(renderer_, color.r, color.g, color.b, color.a));
+	CheckError(SDL_RenderDrawLine(renderer_, off_x_ + x_start, off_y_ + y_start, off_x_ + x_end, off_y_ + y_end));
 }
 
 void RenderModule::DrawLineIntoBuffer32(DataBuffer& buffer,
 	const int x_start, const int y_start,
 	const int x_end, const int y_end,
 	const int thickness, const uint32_t pixel_value, const bool blending) {
-
-	const int totalx = x_end - x_start;
-	const int totaly = y_end - y_start;
-
-	const int sx = totalx < 0 ? -1 : 1;
-	const int sy = totaly < 0 ? -1 : 1;
-
-	const int w = buffer.width;
-	const int h = buffer.height;
-
-	uint32_t* pixel_data = (uint32_t*)buffer.data;
-
-	if (totalx == 0 && totaly == 0) {
-		internal_draw_point(pixel_data, x_start, y_start, w, h, thickness, pixel_value, blending);
-	} else if (totalx == 0) {
-		// Vertical
-		for (int y = y_start; y != y_end + sy && y < h && y >= 0; y += sy) {
-			internal_draw_point(pixel_data, x_start, y, w, h, thickness, pixel_value, blending);
-		}
-	} else if (totaly == 0) {
-		// Horizontal
-		for (int x = x_start; x != x_end + sx && x < w && x >= 0; x += sx) {
-			internal_draw_point(pixel_data, x, y_start, w, h, thickness, pixel_value, blending);
-		}
-	} else {
-		// Diagonal
-		const int atx = abs(totalx);
-		const int aty = abs(totaly);
-		int error = (atx > aty ? atx : -aty) / 2;
-		int error2;
-
-		int x = x_start;
-		int y = y_start;
-
-		while (true) {
-			internal_draw_point(pixel_data, x, y, w, h, thickness, pixel_value, blending);
-			if (x == x_end && y == y_end) break;
-			error2 = error;
-			if (error2 > -atx) {
-				error -= aty;
-				x += sx;
-			}
-			if (error2 < aty) {
-				error += atx;
-				y += sy;
-			}
-		}
-	}
+	// Drawn as spans, see raster.h
+	raster::DrawLine32(buffer, x_start, y_start, x_end, y_end, thickness, pixel_value, blending);
 }
 
-void RenderModule::DrawSprite(Sprite& sprite, const int x, const int y) {
+void RenderModule::DrawSprite(Sprite& sprite, const int x, const int y, const Color& tint) {
 	if (renderer_ == nullptr) { return; }
 
 	SDL_Rect src;
-	const bool src_region = sprite.sub_region(src);
-
-	SDL_Rect dst = SDL_Rect_From_Coordinates(off_x_ + x, off_y_ + y, sprite.width(), sprite.height());
-	const bool dst_region = (dst.x != 0 || dst.y != 0 || screen_->renderWidth() != sprite.width() || screen_->renderHeight() != sprite.height());
+	if (!sprite.sub_region(src)) {
+		src = SDL_Rect_From_Coordinates(0, 0, sprite.width(), sprite.height());
+	}
 
-	sprite.SetRenderParams();
-	CheckError(SDL_RenderCopy(renderer_, sprite.texture(), src_region ? &src : NULL, dst_region ? &dst : NULL));
+	const SDL_Rect dst = SDL_Rect_From_Coordinates(off_x_ + x, off_y_ + y, sprite.width(), sprite.height());
+	QueueSpriteQuad(sprite, src, dst, tint);
 }
 
 void RenderModule::DrawSpriteSubRegion(Sprite& sprite, const int x, const int y, const int sub_x, const int sub_y,
-	const int sub_width, const int sub_height, const bool allow_crop) {
+	const int sub_width, const int sub_height, const Color& tint, const bool allow_crop) {
 	if (renderer_ == nullptr) { return; }
 
 	SDL_Rect src; // Set only if src_region == true
@@ -463,42 +742,37 @@ void RenderModule::DrawSpriteSubRegion(Sprite& sprite, const int x, const int y,
 	const bool src_region = sprite.sub_region(src, sub_x, sub_y, sub_width, sub_height, ok, allow_crop);
 	if (!ok) { return; }
 
-	if (src_region) {
-		dst = SDL_Rect_From_Coordinates(off_x_ + x, off_y_ + y, src.w, src.h); // In case of cropping.
-	} else {
-		dst = SDL_Rect_From_Coordinates(off_x_ + x, off_y_ + y, sub_width, sub_height);
+	if (!src_region) {
+		src = SDL_Rect_From_Coordinates(0, 0, sub_width, sub_height);
 	}
+	dst = SDL_Rect_From_Coordinates(off_x_ + x, off_y_ + y, src.w, src.h); // In case of cropping.
 
-	// TODO: Optimize this check away?
-	const bool dst_region = (dst.x != 0 || dst.y != 0 || screen_->renderWidth() != src.w || screen_->renderHeight() != src.h);
-
-	sprite.SetRenderParams();
-	CheckError(SDL_RenderCopy(renderer_, sprite.texture(), src_region ? &src : NULL, dst_region ? &dst : NULL));
+	QueueSpriteQuad(sprite, src, dst, tint);
 }
 
-void RenderModule::DrawSpriteScaling(Sprite& sprite, const int x, const int y, const double scale_factor) {
+void RenderModule::DrawSpriteScaling(Sprite& sprite, const int x, const int y, const double scale_factor, const Color& tint) {
 	if (renderer_ == nullptr) { return; }
 
 	const int width = (int) (((double) sprite.width()) * scale_factor);
 	const int height = (int) (((double) sprite.height()) * scale_factor);
 
-	DrawSpriteStretch(sprite, x, y, width, height);
+	DrawSpriteStretch(sprite, x, y, width, height, tint);
 }
 
-void RenderModule::DrawSpriteStretch(Sprite& sprite, const int x, const int y, const int width, const int height) {
+void RenderModule::DrawSpriteStretch(Sprite& sprite, const int x, const int y, const int width, const int height, const Color& tint) {
 	if (renderer_ == nullptr) { return; }
 
 	SDL_Rect src;
-	const bool src_region = sprite.sub_region(src);
-
-	SDL_Rect dst = SDL_Rect_From_Coordinates(off_x_ + x, off_y_ + y, width, height);
-	const bool dst_region = (dst.x != 0 || dst.y != 0 || screen_->renderWidth() != width || screen_->renderHeight() != height);
+	if (!sprite.sub_region(src)) {
+		src = SDL_Rect_From_Coordinates(0, 0, sprite.width(), sprite.height());
+	}
 
-	sprite.SetRenderParams();
-	CheckError(SDL_RenderCopy(renderer_, sprite.texture(), src_region ? &src : NULL, dst_region ? &dst : NULL));
+	const SDL_Rect dst = SDL_Rect_From_Coordinates(off_x_ + x, off_y_ + y, width, height);
+	QueueSpriteQuad(sprite, src, dst, tint);
 }
 
-void RenderModule::DrawSpriteTiled(Sprite& sprite, const int x, const int y, const int width, const int height) {
+// All of the tiles are queued as one batch (unless the batch fills up).
+void RenderModule::DrawSpriteTiled(Sprite& sprite, const int x, const int y, const int width, const int height, const Color& tint) {
 	if (renderer_ == nullptr) { return; }
 
 	int cur_x = x;
@@ -516,7 +790,7 @@ void RenderModule::DrawSpriteTiled(Sprite& sprite, const int x, const int y, con
 		while (cur_w > 0) {
 			draw_w = min(sw, cur_w);
 			draw_h = min(sh, cur_h);
-			DrawSpriteSubRegion(sprite, cur_x, cur_y, 0, 0, draw_w, draw_h);
+			DrawSpriteSubRegion(sprite, cur_x, cur_y, 0, 0, draw_w, draw_h, tint);
 			cur_w -= sw;
 			cur_x += sw;
 		}
@@ -531,7 +805,7 @@ void RenderModule::DrawPixelText(const string& text, const size_t font_id,
 								 const int x, const int y, const Color& color, const Color& back_color) {
 	const size_t len = text.len();
 	if (font_id >= pixel_fonts_.size()) {
-		log::Error("RenderModule", "Tried to draw text from an invalid pixel font id!");
+		ARC_LOG_ERROR("RenderModule", "Tried to draw text from an invalid pixel font id!");
 		return;
 	} else if (len == 0) {
 		return;
@@ -583,12 +857,212 @@ void RenderModule::DrawPixelText(const string& text, const size_t font_id,
 	}
 
 	if (char_count != len) {
-		// TODO: Prevent this from possible spamming? //
-		log::Warn("RenderModule", "Character(s) not in pixel font when drawing text!");
+		ARC_LOG_WARN_LIMITED("RenderModule", "Character(s) not in pixel font when drawing text!");
 	}
 }
 
-void RenderModule::GetPixelTextSize(const string& text, const size_t font_id, int& width, int& height) {
+#define ARC_TEXT_CACHE_PAGE_SIZE 512
+#define ARC_TEXT_CACHE_PADDING 1 /* Transparent, in case of scaling. */
+
+void RenderModule::DrawPixelTextCached(const string& text, const size_t font_id, const int x, const int y,
+									   const Color& color, const Color& back_color) {
+	if (renderer_ == nullptr) { return; }
+
+	const PixelTextRun* run = FindOrRenderPixelTextRun(text, font_id, color, back_color);
+	if (run == nullptr) {
+		// Too large (or invalid), so draw it directly instead.
+		if (!back_color.is_transparent()) {
+			int w, h;
+			GetPixelTextSize(text, font_id, w, h);
+			DrawRect(x, y, w, h, back_color);
+		}
+		DrawPixelText(text, font_id, x, y, color, back_color);
+		return;
+	}
+
+	const SDL_Rect dst = SDL_Rect_From_Coordinates(off_x_ + x, off_y_ + y, run->rect.w, run->rect.h);
+	if (recording_) {
+		text_pages_[run->page].recording = recording_count_;
+	}
+	// The page has the pixels a direct draw leaves: with a background all of them (as the rect isn't
+	// blended), so they're copied, otherwise the glyphs as they are in the font, blended the same way.
+	SDL_BlendMode blend = SDL_BLENDMODE_NONE;
+	if (back_color.is_transparent()) {
+		SDL_GetTextureBlendMode(pixel_fonts_[font_id].sprite->texture(), &blend);
+	}
+	QueueSpriteQuad(*text_pages_[run->page].sprite, run->rect, dst, white, blend);
+}
+
+const RenderModule::PixelTextRun* RenderModule::FindOrRenderPixelTextRun(
+	const string& text, const size_t font_id, const Color& color, const Color& back_color) {
+	if (font_id >= pixel_fonts_.size() || text.len() == 0) {
+		return nullptr;
+	}
+	SDL_Texture* font_texture = pixel_fonts_[font_id].sprite->texture();
+	SDL_BlendMode font_blend = SDL_BLENDMODE_NONE;
+	if (font_texture == nullptr || SDL_GetTextureBlendMode(font_texture, &font_blend) != 0) {
+		return nullptr;
+	}
+	if (back_color.is_transparent() && font_blend == SDL_BLENDMODE_NONE) {
+		return nullptr; // The gaps between the glyphs would be drawn too.
+	}
+
+	// The text followed by a fixed size suffix, so keys can't collide.
+	// The color isn't included as DrawPixelText doesn't apply it, so it would only add identical runs.
+	const uint32_t key_suffix[2] = { (uint32_t) font_id, back_color.toARGB8888() };
+	text_key_.assign((const char*) text.data(), text.len());
+	text_key_.append((const char*) key_suffix, sizeof(key_suffix));
+
+	text_use_count_++;
+	auto found = text_runs_.find(text_key_);
+	if (found != text_runs_.end()) {
+		found->second.last_used = text_use_count_;
+		return &(found->second);
+	}
+
+	int w, h;
+	GetPixelTextSize(text, font_id, w, h);
+	if (w <= 0 || h <= 0) {
+		return nullptr;
+	}
+
+	size_t page = 0;
+	int px = 0;
+	int py = 0;
+	if (!AllocatePixelTextRun(w + (2 * ARC_TEXT_CACHE_PADDING), h + (2 * ARC_TEXT_CACHE_PADDING), page, px, py)) {
+		return nullptr;
+	}
+
+	PixelTextRun run;
+	run.page = page;
+	run.rect = SDL_Rect_From_Coordinates(px + ARC_TEXT_CACHE_PADDING, py + ARC_TEXT_CACHE_PADDING, w, h);
+	run.last_used = text_use_count_;
+
+	// Render into the page, then return to the current render target and draw offset.
+	// This is done now even while recording commands, as the page must be ready when they're submitted.
+	const bool recording = recording_;
+	recording_ = false;
+	FlushBatch();
+	SDL_Texture* target = SDL_GetRenderTarget(renderer_);
+	const int prev_off_x = off_x_;
+	const int prev_off_y = off_y_;
+	ClearDrawOffset();
+	SDL_SetRenderTarget(renderer_, text_pages_[page].sprite->texture());
+
+	// Without a background, the glyphs are copied as they are, to be blended when the run is drawn.
+	if (!back_color.is_transparent()) {
+		DrawRect(run.rect.x, run.rect.y, w, h, back_color);
+	} else {
+		SDL_SetTextureBlendMode(font_texture, SDL_BLENDMODE_NONE);
+	}
+	DrawPixelText(text, font_id, run.rect.x, run.rect.y, color, back_color);
+	FlushBatch();
+	SDL_SetTextureBlendMode(font_texture, font_blend);
+
+	SDL_SetRenderTarget(renderer_, target);
+	SetDrawOffset(prev_off_x, prev_off_y);
+	RestoreClipRect();
+	recording_ = recording;
+
+	return &(text_runs_.emplace(text_key_, run).first->second);
+}
+
+bool RenderModule::AllocatePixelTextRun(const int width, const int height, size_t& page, int& x, int& y) {
+	if (width > ARC_TEXT_CACHE_PAGE_SIZE || height > ARC_TEXT_CACHE_PAGE_SIZE) {
+		return false;
+	}
+
+	const size_t pages = text_pages_.size();
+	for (size_t i = 0; i < pages; i++) {
+		if (text_pages_[i].packer->pack(width, height, x, y)) {
+			page = i;
+			return true;
+		}
+	}
+
+	const size_t page_bytes = size_t{ ARC_TEXT_CACHE_PAGE_SIZE } * ARC_TEXT_CACHE_PAGE_SIZE * 4;
+	const size_t max_pages = max(size_t{ 1 }, text_cache_budget_ / page_bytes);
+
+	if (pages < max_pages) {
+		SDL_Texture* texture = SDL_CreateTexture(renderer_, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET,
+			ARC_TEXT_CACHE_PAGE_SIZE, ARC_TEXT_CACHE_PAGE_SIZE);
+		if (texture == nullptr) {
+			ARC_LOG_ERROR("RenderModule", string("Unable to create pixel text cache texture: ") + SDL_GetError());
+			return false;
+		}
+		SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+
+		PixelTextPage new_page;
+		new_page.sprite = &AddSprite(new Sprite(texture, ARC_TEXT_CACHE_PAGE_SIZE, ARC_TEXT_CACHE_PAGE_SIZE, false, true));
+		new_page.packer = new skyline_packer(ARC_TEXT_CACHE_PAGE_SIZE, ARC_TEXT_CACHE_PAGE_SIZE);
+		text_pages_.push_back(new_page);
+		page = pages;
+	} else {
+		// Evict the page that was least recently used. (Its most recently used text is the oldest.)
+		// Pages drawn by commands that are not submitted yet are skipped, as they still draw the text.
+		std::vector<uint64_t> page_last_used(pages, 0);
+		for (const auto& entry : text_runs_) {
+			page_last_used[entry.second.page] = max(page_last_used[entry.second.page], entry.second.last_used);
+		}
+		const uint32_t oldest_unsubmitted = OldestUnsubmittedRecording();
+		page = pages;
+		for (size_t i = 0; i < pages; i++) {
+			const uint32_t recording = text_pages_[i].recording;
+			if ((recording == 0 || recording < oldest_unsubmitted) &&
+				(page == pages || page_last_used[i] < page_last_used[page])) {
+				page = i;
+			}
+		}
+		if (page == pages) {
+			return false;
+		}
+		text_pages_[page].recording = 0;
+	}
+
+	ClearPixelTextPage(page);
+	return text_pages_[page].packer->pack(width, height, x, y);
+}
+
+void RenderModule::ClearPixelTextPage(const size_t page) {
+	for (auto it = text_runs_.begin(); it != text_runs_.end(); ) {
+		if (it->second.page == page) {
+			it = text_runs_.erase(it);
+		} else {
+			++it;
+		}
+	}
+	text_pages_[page].packer->reset();
+
+	FlushBatch(); // Queued draws may still use this page.
+	SDL_Texture* target = SDL_GetRenderTarget(renderer_);
+	SDL_SetRenderTarget(renderer_, text_pages_[page].sprite->texture());
+	CheckError(SDL_SetRenderDrawColor(renderer_, 0, 0, 0, 0));
+	CheckError(SDL_RenderClear(renderer_));
+	SDL_SetRenderTarget(renderer_, target);
+	RestoreClipRect();
+}
+
+void RenderModule::SetPixelTextCacheBudget(const size_t max_bytes) {
+	text_cache_budget_ = max_bytes;
+	const size_t page_bytes = size_t{ ARC_TEXT_CACHE_PAGE_SIZE } * ARC_TEXT_CACHE_PAGE_SIZE * 4;
+	if (text_pages_.size() > max(size_t{ 1 }, max_bytes / page_bytes)) {
+		ClearPixelTextCache();
+	}
+}
+
+void RenderModule::ClearPixelTextCache() {
+	FlushBatch();
+	text_runs_.clear();
+	for (PixelTextPage& page : text_pages_) {
+		ReleaseSpriteTexture(*page.sprite);
+		sprites_.remove(page.sprite->handle());
+		delete page.packer;
+	}
+	text_pages_.clear();
+}
+
+void RenderModule::MeasurePixelTextInternal(const string& text, const size_t font_id, int& width, int& height,
+											std::vector<PixelTextLine>* lines) {
 	width = 0;
 	height = 0;
 
@@ -601,53 +1075,86 @@ void RenderModule::GetPixelTextSize(const string& text, const size_t font_id, in
 		return;
 	}
 
-	const PixelFontData& font = pixel_fonts_.at(font_id);
-	const size_t fs = font.letter_data.size();
-	const int line_height = font.line_height;
-	const int line_spacing = font.line_spacing;
+	const PixelFontData& font = pixel_fonts_[font_id];
+	const int16_t* advance = pixel_font_metrics_[font_id].advance;
+	const int line_advance = font.line_height + font.line_spacing;
+	const int spacing = font.spacing;
+	const unsigned char* data = text.data();
 
 	int w = 0;
 	int tw = 0;
 	int th = 0;
+	size_t line_start = 0;
 
-	// Calculate final text size.
 	for (size_t i = 0; i < len; i++) {
-		const uint8_t rc = text.at(i);
+		const uint8_t rc = data[i];
 		if (rc == '\n') {
-			th += line_height + line_spacing;
+			if (lines != nullptr) {
+				PixelTextLine line;
+				line.start = line_start;
+				line.len = i - line_start;
+				line.width = w;
+				lines->push_back(line);
+			}
+			th += line_advance;
 			tw = max(tw, w);
 			w = 0;
-			continue;
-		} else if (rc < 32) {
-			// Do not print any special characters.
+			line_start = i + 1;
 			continue;
 		}
 
-		const uint8_t c = rc - 32;
-		if (c >= fs) {
+		// Special characters and any not in the font are -1.
+		const int a = advance[rc];
+		if (a < 0) {
 			continue;
-			// Not in the font.
 		}
-
 		if (w > 0) {
-			w += font.spacing;
-		}
-
-		const PixelFontLetter& ld = font.letter_data[c];
-		// As w and h are 0 for letters not in the font as well.
-		if (ld.w != 0 && ld.h != 0) {
-			w += ld.w;
+			w += spacing;
 		}
+		w += a;
 	}
 
 	// Add in final line
-	th += line_height;
+	if (lines != nullptr) {
+		PixelTextLine line;
+		line.start = line_start;
+		line.len = len - line_start;
+		line.width = w;
+		lines->push_back(line);
+	}
+	th += font.line_height;
 	tw = max(tw, w);
 
 	width = tw;
 	height = th;
 }
 
+void RenderModule::MeasurePixelText(const string& text, const size_t font_id, PixelTextLayout& layout) {
+	// An owned copy, so the layout can't change with the original text.
+	const size_t len = text.len();
+	layout.text = string('\0', len);
+	if (len > 0) {
+		memcpy(layout.text.mutable_data(), text.data(), len);
+	}
+	layout.font_id = font_id;
+	layout.lines.clear();
+	MeasurePixelTextInternal(text, font_id, layout.width, layout.height, &layout.lines);
+}
+
+bool RenderModule::LayoutPixelText(const string& text, const size_t font_id, PixelTextLayout& layout) {
+	const size_t len = text.len();
+	if (layout.font_id == font_id && layout.text.len() == len &&
+		(len == 0 || memcmp(layout.text.data(), text.data(), len) == 0)) {
+		return false;
+	}
+	MeasurePixelText(text, font_id, layout);
+	return true;
+}
+
+void RenderModule::GetPixelTextSize(const string& text, const size_t font_id, int& width, int& height) {
+	MeasurePixelTextInternal(text, font_id, width, height, nullptr);
+}
+
 int RenderModule::GetPixelTextWidth(const string& text, const size_t font_id) {
 	int w, h;
 	GetPixelTextSize(text, font_id, w, h);
@@ -697,7 +1204,320 @@ Sprite& RenderModule::SpriteFromPixelText(const string& text, const size_t font_
 
 void RenderModule::RenderFrameDone() {
 	if (renderer_ == nullptr) { return; }
+	FlushBatch();
 	SDL_RenderPresent(renderer_);
+	frames_done_++;
+}
+
+#define ARC_MAX_BATCH_QUADS 4096
+
+void RenderModule::FlushBatch() {
+#ifdef ARC_RENDER_BATCHING
+	if (batch_indices_.empty()) {
+		return;
+	}
+	CheckError(SDL_RenderGeometry(renderer_, batch_texture_,
+		batch_vertices_.data(), (int) batch_vertices_.size(), batch_indices_.data(), (int) batch_indices_.size()));
+	batch_vertices_.clear();
+	batch_indices_.clear();
+	batch_texture_ = nullptr;
+#endif
+}
+
+// Multiplies two 0 - 255 values, rounded, so 255 * x == x.
+static uint8_t ModulateChannel(const uint8_t a, const uint8_t b) {
+	const uint32_t product = uint32_t(a) * uint32_t(b) + 128;
+	return uint8_t((product + (product >> 8)) >> 8);
+}
+
+void RenderModule::QueueSpriteQuad(Sprite& sprite, const SDL_Rect& src, const SDL_Rect& dst, const Color& tint) {
+	if (!sprite.is_loaded()) {
+		return; // Placeholder from SpriteFromImageAsync.
+	}
+	// The blend mode is part of the texture state at the time of drawing, so it must match.
+	SDL_BlendMode blend = SDL_BLENDMODE_NONE;
+	SDL_GetTextureBlendMode(sprite.texture(), &blend);
+	QueueSpriteQuad(sprite, src, dst, tint, blend);
+}
+
+void RenderModule::QueueSpriteQuad(Sprite& sprite, const SDL_Rect& src, const SDL_Rect& dst, const Color& tint,
+	const SDL_BlendMode blend) {
+	if (!sprite.is_loaded() || tint.is_transparent()) {
+		return; // Placeholder from SpriteFromImageAsync, or nothing to draw.
+	}
+	SDL_Texture* texture = sprite.texture();
+
+	// Texture color and alpha mods are not used by SDL_RenderGeometry, so they go in the vertices.
+	// (Also so that sprites sharing a texture can have different mods, and any tint.)
+	SDL_Color color;
+	color.r = tint.r;
+	color.g = tint.g;
+	color.b = tint.b;
+	color.a = tint.a;
+	if (sprite.has_alpha_mod()) {
+		color.a = ModulateChannel(color.a, sprite.alpha_mod());
+	}
+	if (sprite.has_color_mod()) {
+		const Color mod = sprite.color_mod();
+		color.r = ModulateChannel(color.r, mod.r);
+		color.g = ModulateChannel(color.g, mod.g);
+		color.b = ModulateChannel(color.b, mod.b);
+	}
+
+	if (recording_) {
+		RenderCommand& c = RecordCommand(ARC_RENDER_SPRITE);
+		c.texture = texture;
+		c.blend = blend;
+		c.src = src;
+		c.dst = dst;
+		c.color = color;
+		return;
+	}
+	QueueTextureQuad(texture, blend, src, dst, color);
+}
+
+void RenderModule::QueueTextureQuad(SDL_Texture* texture, const SDL_BlendMode blend, const SDL_Rect& src,
+	const SDL_Rect& dst, const SDL_Color& color) {
+#ifdef ARC_RENDER_BATCHING
+	if (texture != batch_texture_ || blend != batch_blend_ || batch_indices_.size() >= ARC_MAX_BATCH_QUADS * 6) {
+		FlushBatch();
+		int tw = 0;
+		int th = 0;
+		if (SDL_QueryTexture(texture, nullptr, nullptr, &tw, &th) != 0 || tw <= 0 || th <= 0) {
+			ARC_LOG_ERROR("RenderModule", string("SDL query texture error: ") + SDL_GetError());
+			return;
+		}
+		// Recorded commands may have a different blend mode than the texture has now.
+		SDL_BlendMode current = SDL_BLENDMODE_NONE;
+		SDL_GetTextureBlendMode(texture, &current);
+		if (current != blend) {
+			SDL_SetTextureBlendMode(texture, blend);
+		}
+		batch_texture_ = texture;
+		batch_blend_ = blend;
+		batch_texture_width_ = (float) tw;
+		batch_texture_height_ = (float) th;
+	}
+
+	const float x0 = (float) dst.x;
+	const float y0 = (float) dst.y;
+	const float x1 = (float) (dst.x + dst.w);
+	const float y1 = (float) (dst.y + dst.h);
+	const float u0 = (float) src.x / batch_texture_width_;
+	const float v0 = (float) src.y / batch_texture_height_;
+	const float u1 = (float) (src.x + src.w) / batch_texture_width_;
+	const float v1 = (float) (src.y + src.h) / batch_texture_height_;
+
+	const int base = (int) batch_vertices_.size();
+	batch_vertices_.push_back({ { x0, y0 }, color, { u0, v0 } });
+	batch_vertices_.push_back({ { x1, y0 }, color, { u1, v0 } });
+	batch_vertices_.push_back({ { x1, y1 }, color, { u1, v1 } });
+	batch_vertices_.push_back({ { x0, y1 }, color, { u0, v1 } });
+
+	batch_indices_.push_back(base);
+	batch_indices_.push_back(base + 1);
+	batch_indices_.push_back(base + 2);
+	batch_indices_.push_back(base);
+	batch_indices_.push_back(base + 2);
+	batch_indices_.push_back(base + 3);
+#else
+	CheckError(SDL_SetTextureColorMod(texture, color.r, color.g, color.b));
+	CheckError(SDL_SetTextureAlphaMod(texture, color.a));
+	CheckError(SDL_SetTextureBlendMode(texture, blend));
+	CheckError(SDL_RenderCopy(renderer_, texture, &src, &dst));
+#endif
+}
+
+RenderCommand& RenderModule::RecordCommand(const uint8_t type) {
+	commands_.emplace_back();
+	RenderCommand& c = commands_.back();
+	c.type = type;
+	c.blend = SDL_BLENDMODE_NONE;
+	c.has_clip = has_clip_;
+	c.layer = draw_layer_;
+	c.sequence = (uint32_t) commands_.size() - 1;
+	c.recording = recording_count_;
+	c.texture = nullptr;
+	c.src = SDL_Rect_From_Coordinates(0, 0, 0, 0);
+	c.dst = SDL_Rect_From_Coordinates(0, 0, 0, 0);
+	c.clip = has_clip_ ? clip_rect_ : SDL_Rect_From_Coordinates(0, 0, 0, 0);
+	c.color = { 255, 255, 255, 255 };
+	return c;
+}
+
+void RenderModule::BeginCommands() {
+	if (recording_) {
+		ARC_LOG_WARN("RenderModule", "already recording commands");
+		return;
+	}
+	FlushBatch();
+	commands_.clear();
+	recording_ = true;
+	recording_count_++;
+	unsubmitted_recordings_.push_back(recording_count_);
+}
+
+void RenderModule::EndCommands(RenderCommandBuffer& commands) {
+	if (!recording_) {
+		ARC_LOG_WARN("RenderModule", "not recording commands");
+	}
+	recording_ = false;
+	commands.swap(commands_);
+	commands_.clear();
+	if (commands.empty()) {
+		RecordingSubmitted(recording_count_); // Nothing to keep for it.
+	}
+}
+
+void RenderModule::SubmitCommands() {
+	RenderCommandBuffer commands;
+	EndCommands(commands);
+	SubmitCommands(commands);
+	commands.swap(commands_); // Keep the capacity for the next frame.
+	commands_.clear();
+}
+
+void RenderModule::SubmitCommands(RenderCommandBuffer& commands) {
+	if (recording_) {
+		ARC_LOG_ERROR("RenderModule", "cannot submit commands while recording");
+		return;
+	}
+	if (renderer_ == nullptr) {
+		CommandsSubmitted(commands);
+		return;
+	}
+	std::sort(commands.begin(), commands.end(), [](const RenderCommand& a, const RenderCommand& b) {
+		if (a.layer != b.layer) return a.layer < b.layer;
+		if (a.texture != b.texture) return std::less<SDL_Texture*>()(a.texture, b.texture);
+		if (a.blend != b.blend) return a.blend < b.blend;
+		return a.sequence < b.sequence;
+	});
+
+	FlushBatch();
+	bool has_clip = has_clip_;
+	SDL_Rect clip = clip_rect_;
+	for (const RenderCommand& c : commands) {
+		if (c.has_clip != has_clip || (c.has_clip && (c.clip.x != clip.x || c.clip.y != clip.y ||
+			c.clip.w != clip.w || c.clip.h != clip.h))) {
+			FlushBatch();
+			has_clip = c.has_clip;
+			clip = c.clip;
+			SDL_RenderSetClipRect(renderer_, has_clip ? &clip : NULL);
+		}
+
+		switch (c.type) {
+		case ARC_RENDER_SPRITE:
+			QueueTextureQuad(c.texture, c.blend, c.src, c.dst, c.color);
+			break;
+		case ARC_RENDER_RECT:
+			FlushBatch();
+			CheckError(SDL_SetRenderDrawColor(renderer_, c.color.r, c.color.g, c.color.b, c.color.a));
+			CheckError(SDL_RenderFillRect(renderer_, &c.dst));
+			break;
+		case ARC_RENDER_RECT_BORDER:
+			FlushBatch();
+			CheckError(SDL_SetRenderDrawColor(renderer_, c.color.r, c.color.g, c.color.b, c.color.a));
+			CheckError(SDL_RenderDrawRect(renderer_, &c.dst));
+			break;
+		case ARC_RENDER_LINE:
+			FlushBatch();
+			CheckError(SDL_SetRenderDrawColor(renderer_, c.color.r, c.color.g, c.color.b, c.color.a));
+			CheckError(SDL_RenderDrawLine(renderer_, c.dst.x, c.dst.y, c.dst.w, c.dst.h));
+			break;
+		case ARC_RENDER_CLEAR:
+			FlushBatch();
+			CheckError(SDL_SetRenderDrawColor(renderer_, c.color.r, c.color.g, c.color.b, c.color.a));
+			CheckError(SDL_RenderClear(renderer_));
+			break;
+		default:
+			ARC_LOG_ERROR("RenderModule", "unknown render command type");
+			break;
+		}
+	}
+	FlushBatch();
+
+	// Back to the clip from before.
+	SDL_RenderSetClipRect(renderer_, has_clip_ ? &clip_rect_ : NULL);
+
+	CommandsSubmitted(commands);
+}
+
+void RenderModule::DiscardCommands(RenderCommandBuffer& commands) {
+	CommandsSubmitted(commands);
+	commands.clear();
+}
+
+void RenderModule::CommandsSubmitted(const RenderCommandBuffer& commands) {
+	// Usually all from one recording.
+	uint32_t last = 0;
+	for (const RenderCommand& c : commands) {
+		if (c.recording != last) {
+			last = c.recording;
+			RecordingSubmitted(c.recording);
+		}
+	}
+}
+
+void RenderModule::RecordingSubmitted(const uint32_t recording) {
+	auto found = std::find(unsubmitted_recordings_.begin(), unsubmitted_recordings_.end(), recording);
+	if (found == unsubmitted_recordings_.end()) {
+		return; // Already submitted.
+	}
+	unsubmitted_recordings_.erase(found);
+
+	const uint32_t oldest_unsubmitted = OldestUnsubmittedRecording();
+	for (size_t i = released_textures_.size(); i > 0; i--) {
+		if (released_textures_[i - 1].recording < oldest_unsubmitted) {
+			FlushBatch(); // In case the batch still draws it.
+			SDL_DestroyTexture(released_textures_[i - 1].texture);
+			released_textures_.erase(released_textures_.begin() + (i - 1));
+		}
+	}
+}
+
+uint32_t RenderModule::OldestUnsubmittedRecording() const {
+	uint32_t oldest = UINT32_MAX;
+	for (const uint32_t recording : unsubmitted_recordings_) {
+		oldest = min(oldest, recording);
+	}
+	return oldest;
+}
+
+void RenderModule::ReleaseTexture(SDL_Texture* texture) {
+	if (!unsubmitted_recordings_.empty()) {
+		ReleasedTexture released;
+		released.texture = texture;
+		released.recording = recording_count_;
+		released_textures_.push_back(released);
+	} else {
+		SDL_DestroyTexture(texture);
+	}
+}
+
+void RenderModule::ReleaseSpriteTexture(Sprite& sprite) {
+	if (!sprite.is_sub_ && sprite.texture_ != nullptr) {
+		ReleaseTexture(sprite.texture_);
+		sprite.texture_ = nullptr;
+	}
+}
+
+string RenderModule::CommandsToString(const RenderCommandBuffer& commands) {
+	static const char* names[] = { "?", "sprite", "rect", "border", "line", "clear" };
+	string out;
+	char line[256];
+	for (const RenderCommand& c : commands) {
+		const char* name = c.type <= ARC_RENDER_CLEAR ? names[c.type] : names[0];
+		int n = snprintf(line, sizeof(line),
+			"#%u layer %d %s texture %p blend %d src %d,%d %dx%d dst %d,%d %dx%d color %02x%02x%02x%02x",
+			c.sequence, c.layer, name, (void*) c.texture, (int) c.blend, c.src.x, c.src.y, c.src.w, c.src.h,
+			c.dst.x, c.dst.y, c.dst.w, c.dst.h, c.color.r, c.color.g, c.color.b, c.color.a);
+		if (c.has_clip && n > 0 && n < (int) sizeof(line)) {
+			snprintf(line + n, sizeof(line) - n, " clip %d,%d %dx%d", c.clip.x, c.clip.y, c.clip.w, c.clip.h);
+		}
+		out += line;
+		out += "\n";
+	}
+	return out;
 }
 
 size_t RenderModule::LoadPixelFont(const PixelFontData& font_data) {
@@ -705,6 +1525,20 @@ size_t RenderModule::LoadPixelFont(const PixelFontData& font_data) {
 		return -1;
 	} else {
 		pixel_fonts_.push_back(font_data);
+
+		PixelFontMetrics metrics;
+		const size_t fs = font_data.letter_data.size();
+		for (size_t i = 0; i < 256; i++) {
+			if (i < 32 || i - 32 >= fs) {
+				metrics.advance[i] = -1; // Special characters, or not in the font.
+			} else {
+				const PixelFontLetter& ld = font_data.letter_data[i - 32];
+				// As w and h are 0 for letters not in the font as well. (Though spacing is still added.)
+				metrics.advance[i] = (ld.w != 0 && ld.h != 0) ? (int16_t) ld.w : 0;
+			}
+		}
+		pixel_font_metrics_.push_back(metrics);
+
 		return pixel_fonts_.size() - 1;
 	}
 }
@@ -714,7 +1548,7 @@ Sprite& RenderModule::CreateBlankSpriteForRendering(const int width, const int h
 	SDL_Texture* texture = SDL_CreateTexture(renderer_, format, SDL_TEXTUREACCESS_TARGET, width, height);
 	Sprite* s = new Sprite(texture, width, height, false, true);
 	SetSpriteContext(*s);
-	return addtoslotvector(sprites_, s);
+	return AddSprite(s);
 }
 
 Sprite& RenderModule::SpriteFromBitmap(const string& file_path, const bool stream) {
@@ -724,6 +1558,9 @@ Sprite& RenderModule::SpriteFromBitmap(const string& file_path, const bool strea
 	if (surface == nullptr) {
 		throw graphics_error("Unable to load bitmap: " + file_path + SDL_GetError());
 	}
+	SDL_RendererInfo info;
+	RendererInfo(info);
+	surface = ConvertSurfaceToNative(surface, info);
 
 	SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer_, surface);
 
@@ -731,11 +1568,12 @@ Sprite& RenderModule::SpriteFromBitmap(const string& file_path, const bool strea
 		throw graphics_error("Unable to create texture from loaded bitmap: " + file_path + SDL_GetError());
 	}
 
-	Sprite* s = new Sprite(texture, surface->w, surface->h, stream); // TODO: Format + Caching for reload?
+	Sprite* s = new Sprite(texture, surface->w, surface->h, stream);
+	s->source_ = FileSpriteSource(file_path, true);
 
 	SDL_FreeSurface(surface);
 
-	return addtoslotvector(sprites_, s);
+	return AddSprite(s);
 }
 
 Sprite& RenderModule::SpriteFromImage(const string& file_path, const bool stream) { // Including PNG, etc.
@@ -745,6 +1583,9 @@ Sprite& RenderModule::SpriteFromImage(const string& file_path, const bool stream
 	if (surface == nullptr) {
 		throw graphics_error("Unable to load image: " + file_path + IMG_GetError());
 	}
+	SDL_RendererInfo info;
+	RendererInfo(info);
+	surface = ConvertSurfaceToNative(surface, info);
 
 	SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer_, surface);
 
@@ -752,36 +1593,37 @@ Sprite& RenderModule::SpriteFromImage(const string& file_path, const bool stream
 		throw graphics_error("Unable to create texture from loaded image: " + file_path + SDL_GetError());
 	}
 
-	Sprite* s = new Sprite(texture, surface->w, surface->h, stream); // TODO: Format + Caching for reload?
+	Sprite* s = new Sprite(texture, surface->w, surface->h, stream);
+	s->source_ = FileSpriteSource(file_path, false);
 
 	SDL_FreeSurface(surface);
 
-	return addtoslotvector(sprites_, s);
+	return AddSprite(s);
 }
 
 Sprite& RenderModule::SpriteFromDataBuffer(const DataBuffer& data, const bool stream) {
 	SDL_Texture* texture = SDL_CreateTexture(
-		renderer_, data.format, stream ? SDL_TEXTUREACCESS_STREAMING : SDL_TEXTUREACCESS_STATIC, data.width, data.height);
+		renderer_, NativeTextureFormat(data.format), stream ? SDL_TEXTUREACCESS_STREAMING : SDL_TEXTUREACCESS_STATIC, data.width, data.height);
 	Sprite* s = new Sprite(texture, data.width, data.height, stream);
 
 	UpdateSpriteFromDataBuffer(*s, data);
-	return addtoslotvector(sprites_, s);
+	return AddSprite(s);
 }
 
 Sprite& RenderModule::SpriteFromSubRegion(Sprite& sprite, const int sub_x, const int sub_y, const int sub_width, const int sub_height) {
 	bool ok = false;
 	Sprite* s = new Sprite(sprite, sub_x, sub_y, sub_width, sub_height, ok);
 	if (!ok) {
-		log::Error("RenderModule", "Sub region sprite has invalid coordinates");
+		ARC_LOG_ERROR("RenderModule", "Sub region sprite has invalid coordinates");
 		delete s;
 		return sprite;
 	}
-	return addtoslotvector(sprites_, s);
+	return AddSprite(s);
 }
 
 Sprite& RenderModule::SpriteFromColorMod(Sprite& sprite, const Color& color_mod) {
 	Sprite* s = new Sprite(sprite, color_mod);
-	return addtoslotvector(sprites_, s);
+	return AddSprite(s);
 }
 
 // Makes a static sprite from a rendered sprite using the render pixels from SDL_RenderReadPixels...
@@ -793,58 +1635,815 @@ Sprite& RenderModule::SpriteFromRenderSprite(Sprite& sprite) {
 
 	DataBuffer buffer;
 	const size_t bl = size_t{ 4 } * size_t(w) * size_t(h);
+	std::vector<uint8_t> staging = AcquireStagingBuffer(bl);
 	buffer.len = bl;
-	buffer.data = malloc(bl);
+	buffer.data = staging.data();
 	buffer.format = format;
 	buffer.width = w;
 	buffer.height = h;
 	buffer.set_bytes_per_row();
 	
 	// ReadPixels... make a new sprite from the DataBuffer (non-streaming).
+	FlushBatch();
 	CheckError(SDL_RenderReadPixels(renderer_, nullptr, format, buffer.data, buffer.bytes_per_row));
 
 	Sprite& s_sprite = SpriteFromDataBuffer(buffer);
 
-	free(buffer.data); // Not needed anymore.
+	ReleaseStagingBuffer(std::move(staging)); // Not needed anymore.
 
 	return s_sprite;
 }
 
+Sprite& RenderModule::SpriteFromRenderSpriteAsync(Sprite& sprite) {
+	if (!sprite.is_render()) {
+		throw graphics_error("cannot read back a non-rendering sprite");
+	}
+	// Added first, as the readback must not be queued for a sprite that is never added.
+	Sprite& s = AddSprite(new Sprite(nullptr, 0, 0));
+	PendingReadback readback;
+	readback.sprite = &s;
+	if (!QueueReadback(sprite, readback)) {
+		DeleteSprite(s);
+		throw graphics_error("Unable to copy the render sprite for readback");
+	}
+	return s;
+}
+
+bool RenderModule::ReadbackRenderSprite(Sprite& sprite, std::function<void(const DataBuffer&)> done) {
+	PendingReadback readback;
+	readback.done = std::move(done);
+	return QueueReadback(sprite, readback);
+}
+
+bool RenderModule::QueueReadback(Sprite& sprite, PendingReadback& readback) {
+	if (!sprite.is_render()) {
+		throw graphics_error("cannot read back a non-rendering sprite");
+	}
+	const int w = sprite.width();
+	const int h = sprite.height();
+	SDL_Texture* texture = sprite.texture();
+	uint32_t format = SDL_PIXELFORMAT_ARGB8888;
+	SDL_QueryTexture(texture, &format, nullptr, nullptr, nullptr);
+	readback.copy = SDL_CreateTexture(renderer_, format, SDL_TEXTUREACCESS_TARGET, w, h);
+	if (readback.copy == nullptr) {
+		ARC_LOG_ERROR("RenderModule", string("Unable to create texture for readback: ") + SDL_GetError());
+		return false;
+	}
+	readback.width = w;
+	readback.height = h;
+	readback.frame = frames_done_;
+
+	// An exact copy, so without blending or the color and alpha mods.
+	FlushBatch();
+	SDL_BlendMode blend = SDL_BLENDMODE_NONE;
+	uint8_t r = 255;
+	uint8_t g = 255;
+	uint8_t b = 255;
+	uint8_t a = 255;
+	SDL_GetTextureBlendMode(texture, &blend);
+	SDL_GetTextureColorMod(texture, &r, &g, &b);
+	SDL_GetTextureAlphaMod(texture, &a);
+	SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_NONE);
+	SDL_SetTextureColorMod(texture, 255, 255, 255);
+	SDL_SetTextureAlphaMod(texture, 255);
+
+	SDL_Texture* target = SDL_GetRenderTarget(renderer_);
+	SDL_SetRenderTarget(renderer_, readback.copy);
+	const SDL_Rect src = SDL_Rect_From_Coordinates(sprite.x(), sprite.y(), w, h);
+	CheckError(SDL_RenderCopy(renderer_, texture, &src, NULL));
+	SDL_SetRenderTarget(renderer_, target);
+	RestoreClipRect();
+
+	SDL_SetTextureBlendMode(texture, blend);
+	SDL_SetTextureColorMod(texture, r, g, b);
+	SDL_SetTextureAlphaMod(texture, a);
+
+	readbacks_.push_back(std::move(readback));
+	return true;
+}
+
+void RenderModule::FinishReadback(PendingReadback& readback) {
+	DataBuffer buffer;
+	buffer.format = SDL_PIXELFORMAT_ARGB8888;
+	buffer.width = readback.width;
+	buffer.height = readback.height;
+	buffer.set_bytes_per_row();
+	buffer.len = size_t(buffer.bytes_per_row) * size_t(buffer.height);
+	std::vector<uint8_t> staging = AcquireStagingBuffer(buffer.len);
+	buffer.data = staging.data();
+
+	FlushBatch();
+	SDL_Texture* target = SDL_GetRenderTarget(renderer_);
+	SDL_SetRenderTarget(renderer_, readback.copy);
+	const bool ok = SDL_RenderReadPixels(renderer_, nullptr, buffer.format, buffer.data, buffer.bytes_per_row) == 0;
+	if (!ok) {
+		ARC_LOG_ERROR("RenderModule", string("SDL render read pixels error: ") + SDL_GetError());
+	}
+	SDL_SetRenderTarget(renderer_, target);
+	RestoreClipRect();
+	SDL_DestroyTexture(readback.copy);
+	readback.copy = nullptr;
+
+	if (ok && readback.sprite != nullptr) {
+		SDL_Texture* texture = SDL_CreateTexture(renderer_, buffer.format, SDL_TEXTUREACCESS_STATIC,
+			buffer.width, buffer.height);
+		if (texture == nullptr) {
+			ARC_LOG_ERROR("RenderModule", string("Unable to create texture from readback: ") + SDL_GetError());
+		} else {
+			ReplaceTexture(*readback.sprite, texture, buffer.width, buffer.height);
+			UpdateSpriteFromDataBuffer(*readback.sprite, buffer);
+		}
+	} else if (ok && readback.done) {
+		readback.done(buffer);
+	}
+	ReleaseStagingBuffer(std::move(staging));
+}
+
+void RenderModule::FinishReadbacks() {
+	std::vector<PendingReadback> readbacks;
+	readbacks.swap(readbacks_);
+	for (PendingReadback& readback : readbacks) {
+		FinishReadback(readback);
+	}
+}
+
+#define ARC_MAX_STAGING_BUFFERS 4
+
+std::vector<uint8_t> RenderModule::AcquireStagingBuffer(const size_t len) {
+	// The smallest one that fits, so larger ones are kept for larger readbacks.
+	size_t best = staging_buffers_.size();
+	for (size_t i = 0; i < staging_buffers_.size(); i++) {
+		const size_t capacity = staging_buffers_[i].capacity();
+		if (capacity >= len && (best == staging_buffers_.size() || capacity < staging_buffers_[best].capacity())) {
+			best = i;
+		}
+	}
+
+	std::vector<uint8_t> buffer;
+	if (best < staging_buffers_.size()) {
+		buffer = std::move(staging_buffers_[best]);
+		if (best + 1 < staging_buffers_.size()) {
+			staging_buffers_[best] = std::move(staging_buffers_.back());
+		}
+		staging_buffers_.pop_back();
+	}
+	buffer.resize(len);
+	return buffer;
+}
+
+void RenderModule::ReleaseStagingBuffer(std::vector<uint8_t>&& buffer) {
+	if (staging_buffers_.size() < ARC_MAX_STAGING_BUFFERS) {
+		staging_buffers_.push_back(std::move(buffer));
+		return;
+	}
+	// Replaces the smallest one, if this is larger.
+	size_t smallest = 0;
+	for (size_t i = 1; i < staging_buffers_.size(); i++) {
+		if (staging_buffers_[i].capacity() < staging_buffers_[smallest].capacity()) {
+			smallest = i;
+		}
+	}
+	if (buffer.capacity() > staging_buffers_[smallest].capacity()) {
+		staging_buffers_[smallest] = std::move(buffer);
+	}
+}
+
+bool RenderModule::CaptureFrame(DataBuffer& buffer, const uint32_t format) {
+	if (renderer_ == nullptr) { return false; }
+	if (SDL_BYTESPERPIXEL(format) != 4 || SDL_ISPIXELFORMAT_FOURCC(format)) {
+		ARC_LOG_ERROR("RenderModule", "frames can only be captured in 32-bit pixel formats");
+		return false;
+	}
+
+	int w = 0;
+	int h = 0;
+	SDL_Texture* target = SDL_GetRenderTarget(renderer_);
+	const int error = target != nullptr ? SDL_QueryTexture(target, nullptr, nullptr, &w, &h)
+		: SDL_GetRendererOutputSize(renderer_, &w, &h);
+	if (error != 0 || w <= 0 || h <= 0) {
+		ARC_LOG_ERROR("RenderModule", string("SDL get render target size error: ") + SDL_GetError());
+		return false;
+	}
+
+	buffer.format = format;
+	buffer.width = w;
+	buffer.height = h;
+	buffer.set_bytes_per_row();
+	buffer.len = size_t(buffer.bytes_per_row) * size_t(h);
+	buffer.data = malloc(buffer.len);
+	if (buffer.data == nullptr) {
+		ARC_LOG_ERROR("RenderModule", "out of memory for the frame capture");
+		return false;
+	}
+
+	FlushBatch();
+	if (SDL_RenderReadPixels(renderer_, nullptr, format, buffer.data, buffer.bytes_per_row) != 0) {
+		ARC_LOG_ERROR("RenderModule", string("SDL render read pixels error: ") + SDL_GetError());
+		free(buffer.data);
+		buffer.data = nullptr;
+		return false;
+	}
+	return true;
+}
+
+bool RenderModule::SaveFrameToPNG(const string& file_path) {
+	DataBuffer buffer;
+	if (!CaptureFrame(buffer)) {
+		return false;
+	}
+
+	string png_fn = file_path;
+	bool ok = false;
+	SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormatFrom(buffer.data, buffer.width, buffer.height, 32,
+		buffer.bytes_per_row, buffer.format);
+	if (surface == nullptr) {
+		ARC_LOG_ERROR("RenderModule", string("SDL create surface error: ") + SDL_GetError());
+	} else if (IMG_SavePNG(surface, png_fn.c_str()) != 0) {
+		ARC_LOG_ERROR("RenderModule", string("SDL_image save PNG error: ") + IMG_GetError());
+	} else {
+		ok = true;
+	}
+
+	SDL_FreeSurface(surface);
+	free(buffer.data);
+	return ok;
+}
+
 void RenderModule::UpdateSpriteFromDataBuffer(Sprite& sprite, const DataBuffer& data) {
+	FlushBatch(); // Any queued draws of this sprite use the old pixels.
+	UploadPixels(sprite, nullptr, data);
+	SpriteChanged(sprite);
+	if (!sprite.is_stream()) {
+		// Keep a copy of the pixels, for reloading.
+		Sprite* root = RootSprite(sprite);
+		if (root != nullptr && !root->is_render()) {
+			if (root->source_ == nullptr) {
+				root->source_ = new SpriteSource();
+			}
+			SpriteSource& source = *root->source_;
+			source.file_path.clear();
+			source.bitmap = false;
+			source.format = data.format;
+			source.width = data.width;
+			source.height = data.height;
+			if (!SetSpriteSourcePixels(source, data.data, data.bytes_per_row)) {
+				delete root->source_;
+				root->source_ = nullptr;
+			}
+			sources_to_encode_.erase(root);
+		}
+	}
+}
+
+void RenderModule::UpdateSpriteRegionFromDataBuffer(Sprite& sprite, const int x, const int y, const DataBuffer& data) {
+	// Clipped to the sprite, so sub-sprites can't change the pixels around them.
+	const int cx = max(x, 0);
+	const int cy = max(y, 0);
+	const int w = min(x + data.width, sprite.width()) - cx;
+	const int h = min(y + data.height, sprite.height()) - cy;
+	if (w <= 0 || h <= 0) {
+		return;
+	}
+	const SDL_Rect rect = SDL_Rect_From_Coordinates(cx, cy, w, h);
+	UploadSpriteRects(sprite, data, x, y, &rect, 1);
+}
+
+void RenderModule::UploadSpriteRects(Sprite& sprite, const DataBuffer& data, const int data_x, const int data_y,
+	const SDL_Rect* rects, const size_t count) {
+	if (count == 0) {
+		return;
+	}
+	FlushBatch(); // Any queued draws of this sprite use the old pixels.
+
 	if (sprite.is_stream()) {
+		// Locked once for all of them, so the whole bounds are copied (as the old pixels aren't kept).
+		int x0 = rects[0].x;
+		int y0 = rects[0].y;
+		int x1 = rects[0].x + rects[0].w;
+		int y1 = rects[0].y + rects[0].h;
+		for (size_t i = 1; i < count; i++) {
+			x0 = min(x0, rects[i].x);
+			y0 = min(y0, rects[i].y);
+			x1 = max(x1, rects[i].x + rects[i].w);
+			y1 = max(y1, rects[i].y + rects[i].h);
+		}
+		const SDL_Rect bounds = SDL_Rect_From_Coordinates(sprite.x() + x0, sprite.y() + y0, x1 - x0, y1 - y0);
+		UploadPixels(sprite, &bounds, DataBufferRegion(data, x0 - data_x, y0 - data_y, x1 - x0, y1 - y0));
+		SpriteChanged(sprite);
+		return;
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		const SDL_Rect& r = rects[i];
+		const SDL_Rect rect = SDL_Rect_From_Coordinates(sprite.x() + r.x, sprite.y() + r.y, r.w, r.h);
+		UploadPixels(sprite, &rect, DataBufferRegion(data, r.x - data_x, r.y - data_y, r.w, r.h));
+	}
+	SpriteChanged(sprite);
+
+	// Also update the copy of the pixels, which is encoded again later (as there are often many
+	// region updates in a row, such as when filling a SpriteAtlas page).
+	Sprite* root = RootSprite(sprite);
+	if (root == nullptr || root->source_ == nullptr) {
+		return;
+	}
+	SpriteSource& source = *root->source_;
+	if (!source.file_path.empty() || source.format != data.format) {
+		ARC_LOG_WARN("RenderModule", "Sprite region update can't be reloaded, as the sprite has no pixel source.");
+		delete root->source_;
+		root->source_ = nullptr;
+		sources_to_encode_.erase(root);
+		return;
+	}
+	ExpandSpriteSource(source);
+	for (size_t i = 0; i < count; i++) {
+		const SDL_Rect& r = rects[i];
+		PatchSpriteSource(source, sprite.x() + r.x, sprite.y() + r.y,
+			DataBufferRegion(data, r.x - data_x, r.y - data_y, r.w, r.h));
+	}
+	sources_to_encode_.insert(root);
+}
+
+void RenderModule::UploadPixels(Sprite& sprite, const SDL_Rect* rect, const DataBuffer& data) {
+	SDL_Texture* texture = sprite.texture();
+	uint32_t format = data.format;
+	int tw = 0;
+	int th = 0;
+	SDL_QueryTexture(texture, &format, nullptr, &tw, &th);
+	const bool convert = format != data.format && raster::IsConvertibleFormat(format)
+		&& raster::IsConvertibleFormat(data.format);
+
+	DataBuffer src = data;
+	src.width = min(data.width, rect != nullptr ? rect->w : tw);
+	src.height = min(data.height, rect != nullptr ? rect->h : th);
+
+	if (sprite.is_stream()) {
+		// Only the locked region is copied (or converted) directly into the texture.
 		void* t_data;
 		int pitch;
-		CheckError(SDL_LockTexture(sprite.texture(), NULL, &t_data, &pitch));
-		if (pitch != data.bytes_per_row) {
-			throw graphics_error("pixel pitch (bytes_per_row) mismatch for streaming sprite texture update");
+		if (SDL_LockTexture(texture, rect, &t_data, &pitch) != 0) {
+			ARC_LOG_ERROR("RenderModule", string("SDL lock texture error: ") + SDL_GetError());
+			return;
+		}
+		if (convert) {
+			DataBuffer dst = src;
+			dst.data = t_data;
+			dst.format = format;
+			dst.bytes_per_row = pitch;
+			raster::ConvertPixels(src, dst);
+		} else if (pitch == src.bytes_per_row && src.width == tw) {
+			memcpy(t_data, src.data, size_t(pitch) * size_t(src.height)); // Guaranteed no overlap.
+		} else {
+			CopyPixelRows(t_data, pitch, src.data, src.bytes_per_row, SDL_BYTESPERPIXEL(src.format) * src.width, src.height);
+		}
+		SDL_UnlockTexture(texture); // noerror
+		return;
+	}
+
+	if (!convert) {
+		CheckError(SDL_UpdateTexture(texture, rect, data.data, data.bytes_per_row));
+		return;
+	}
+	// Converted here, as SDL's generic conversion is much slower.
+	DataBuffer converted = src;
+	converted.format = format;
+	converted.set_bytes_per_row(SDL_BYTESPERPIXEL(format));
+	converted.len = size_t(converted.bytes_per_row) * size_t(converted.height);
+	std::vector<uint8_t> staging = AcquireStagingBuffer(converted.len);
+	converted.data = staging.data();
+	raster::ConvertPixels(src, converted);
+	CheckError(SDL_UpdateTexture(texture, rect, converted.data, converted.bytes_per_row));
+	ReleaseStagingBuffer(std::move(staging));
+}
+
+bool RenderModule::RendererInfo(SDL_RendererInfo& info) {
+	if (renderer_ == nullptr || SDL_GetRendererInfo(renderer_, &info) != 0) {
+		info.num_texture_formats = 0; // So nothing is converted.
+		return false;
+	}
+	return true;
+}
+
+uint32_t RenderModule::NativeTextureFormat(const uint32_t format) {
+	SDL_RendererInfo info;
+	RendererInfo(info);
+	return arc::NativeTextureFormat(info, format);
+}
+
+void RenderModule::UpdateSpriteRectsFromDataBuffer(Sprite& sprite, const DataBuffer& data, const SDL_Rect* rects,
+	const size_t count) {
+	const int width = min(data.width, sprite.width());
+	const int height = min(data.height, sprite.height());
+	update_rects_.clear();
+	for (size_t i = 0; i < count; i++) {
+		// Clipped to the sprite and data.
+		const int x = max(rects[i].x, 0);
+		const int y = max(rects[i].y, 0);
+		const int w = min(rects[i].x + rects[i].w, width) - x;
+		const int h = min(rects[i].y + rects[i].h, height) - y;
+		if (w > 0 && h > 0) {
+			update_rects_.push_back(SDL_Rect_From_Coordinates(x, y, w, h));
+		}
+	}
+	UploadSpriteRects(sprite, data, 0, 0, update_rects_.data(), update_rects_.size());
+}
+
+bool RenderModule::LockSpriteForWrite(Sprite& sprite, DataBuffer& buffer, const SDL_Rect* rect) {
+	if (!sprite.is_stream()) {
+		throw graphics_error("cannot lock a non-streaming sprite for writing");
+	}
+	FlushBatch(); // Any queued draws of this sprite use the old pixels.
+
+	SDL_Rect lock_rect = SDL_Rect_From_Coordinates(sprite.x(), sprite.y(), sprite.width(), sprite.height());
+	if (rect != nullptr) {
+		// Clipped to the sprite, so sub-sprites can't change the pixels around them.
+		const int x = max(rect->x, 0);
+		const int y = max(rect->y, 0);
+		const int w = min(rect->x + rect->w, sprite.width()) - x;
+		const int h = min(rect->y + rect->h, sprite.height()) - y;
+		if (w <= 0 || h <= 0) {
+			ARC_LOG_ERROR("RenderModule", "Unable to lock an empty sprite region.");
+			return false;
+		}
+		lock_rect = SDL_Rect_From_Coordinates(sprite.x() + x, sprite.y() + y, w, h);
+	}
+	uint32_t format = SDL_PIXELFORMAT_ARGB8888;
+	SDL_QueryTexture(sprite.texture(), &format, nullptr, nullptr, nullptr);
+
+	void* t_data;
+	int pitch;
+	if (SDL_LockTexture(sprite.texture(), &lock_rect, &t_data, &pitch) != 0) {
+		ARC_LOG_ERROR("RenderModule", string("SDL lock texture error: ") + SDL_GetError());
+		return false;
+	}
+	buffer.data = t_data;
+	buffer.format = format;
+	buffer.width = lock_rect.w;
+	buffer.height = lock_rect.h;
+	buffer.bytes_per_row = pitch;
+	buffer.len = size_t(pitch) * size_t(lock_rect.h);
+	return true;
+}
+
+void RenderModule::UnlockSprite(Sprite& sprite) {
+	SDL_UnlockTexture(sprite.texture()); // noerror
+	SpriteChanged(sprite);
+}
+
+//
+// Async sprite loading
+//
+
+struct DecodedImage {
+	Sprite* sprite = nullptr;
+	uint64_t request = 0;
+	SDL_Surface* surface = nullptr; // Owned
+	std::string error;
+};
+
+// Shared with the decoding tasks, so it outlives the RenderModule if needed.
+class sprite_upload_queue {
+public:
+	~sprite_upload_queue() {
+		for (DecodedImage& image : decoded_) {
+			if (image.surface != nullptr) {
+				SDL_FreeSurface(image.surface);
+			}
 		}
+	}
+
+	void push(DecodedImage&& image) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		decoded_.push_back(std::move(image));
+		cv_.notify_all();
+	}
 
-		memcpy(t_data, data.data, pitch * data.height); // Guaranteed no overlap.
+	bool pop(DecodedImage& image) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (decoded_.empty()) {
+			return false;
+		}
+		image = std::move(decoded_.front());
+		decoded_.pop_front();
+		return true;
+	}
+
+	void wait() {
+		std::unique_lock<std::mutex> lock(mutex_);
+		cv_.wait(lock, [this]() { return !decoded_.empty(); });
+	}
 
-		SDL_UnlockTexture(sprite.texture()); // noerror
+protected:
+	std::mutex mutex_;
+	std::condition_variable cv_;
+	std::deque<DecodedImage> decoded_;
+};
+
+Sprite& RenderModule::SpriteFromImageAsync(const string& file_path, const bool stream) {
+	return LoadSpriteAsync(file_path, stream, false);
+}
+
+Sprite& RenderModule::SpriteFromBitmapAsync(const string& file_path, const bool stream) {
+	return LoadSpriteAsync(file_path, stream, true);
+}
+
+Sprite& RenderModule::LoadSpriteAsync(const string& file_path, const bool stream, const bool bitmap) {
+	if (!upload_queue_) {
+		upload_queue_ = std::make_shared<sprite_upload_queue>();
+	}
+
+	Sprite* s = new Sprite(nullptr, 0, 0, stream);
+	s->source_ = FileSpriteSource(file_path, bitmap);
+	AddSprite(s);
+	const uint64_t request = ++upload_request_count_;
+	pending_uploads_[s] = request;
+
+	// A copy (only the path), as the sprite can be deleted before this is loaded.
+	const SpriteSource source = *s->source_;
+	std::shared_ptr<sprite_upload_queue> queue = upload_queue_;
+	SDL_RendererInfo info;
+	RendererInfo(info);
+
+	thread_manager.Pool().run([queue, s, request, source, info]() {
+		DecodedImage image;
+		image.sprite = s;
+		image.request = request;
+		image.surface = SurfaceFromSpriteSource(source, image.error, &info);
+		queue->push(std::move(image));
+	});
+
+	return *s;
+}
+
+size_t RenderModule::ProcessSpriteUploads(const uint32_t budget_us) {
+	const auto start = std::chrono::steady_clock::now();
+	const auto budget = std::chrono::microseconds(budget_us);
+	size_t uploaded = 0;
+
+	// Readbacks copied before the last frame was done, always all of them.
+	for (size_t i = 0; i < readbacks_.size();) {
+		if (readbacks_[i].frame >= frames_done_) {
+			i++;
+			continue;
+		}
+		PendingReadback readback = std::move(readbacks_[i]);
+		readbacks_.erase(readbacks_.begin() + i);
+		if (readback.sprite != nullptr) {
+			uploaded++;
+		}
+		FinishReadback(readback);
+	}
+
+	if (upload_queue_) {
+		DecodedImage image;
+		while (upload_queue_->pop(image)) {
+			UploadDecodedImage(image);
+			uploaded++;
+			if (std::chrono::steady_clock::now() - start >= budget) {
+				return uploaded;
+			}
+		}
+	}
+
+	// Then encode one updated sprite source again, if there is time left.
+	if (!sources_to_encode_.empty()) {
+		Sprite* s = *sources_to_encode_.begin();
+		sources_to_encode_.erase(sources_to_encode_.begin());
+		if (s->source_ != nullptr) {
+			CompactSpriteSource(*s->source_);
+		}
+	}
+	return uploaded;
+}
+
+void RenderModule::FinishSpriteUploads() {
+	while (!pending_uploads_.empty()) {
+		upload_queue_->wait();
+		ProcessSpriteUploads(UINT32_MAX);
+	}
+}
+
+void RenderModule::UploadDecodedImage(DecodedImage& image) {
+	auto found = pending_uploads_.find(image.sprite);
+	if (found == pending_uploads_.end() || found->second != image.request) {
+		// The sprite was deleted before it was loaded.
+		if (image.surface != nullptr) {
+			SDL_FreeSurface(image.surface);
+		}
+		return;
+	}
+	pending_uploads_.erase(found);
+
+	if (image.surface == nullptr) {
+		ARC_LOG_ERROR("RenderModule", image.error);
+		failed_uploads_++;
+		return;
+	}
+
+	SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer_, image.surface);
+	if (texture == nullptr) {
+		ARC_LOG_ERROR("RenderModule", string("Unable to create texture from loaded image: ") + SDL_GetError());
+		failed_uploads_++;
 	} else {
-		SDL_UpdateTexture(sprite.texture(), NULL, data.data, data.bytes_per_row);
+		ReplaceTexture(*image.sprite, texture, image.surface->w, image.surface->h);
+	}
+	SDL_FreeSurface(image.surface);
+	image.surface = nullptr;
+}
+
+void RenderModule::ReplaceTexture(Sprite& sprite, SDL_Texture* texture, const int width, const int height) {
+	SDL_Texture* old_texture = sprite.texture_;
+	if (old_texture != nullptr) {
+		FlushBatch(); // In case any queued draws use the old texture.
+		SDL_BlendMode blend = SDL_BLENDMODE_NONE;
+		if (SDL_GetTextureBlendMode(old_texture, &blend) == 0) {
+			SDL_SetTextureBlendMode(texture, blend);
+		}
+		for (size_t i = 0; i < sprites_.slots(); i++) {
+			Sprite* s = sprites_[i];
+			if (s != nullptr && s->is_sub_ && s->texture_ == old_texture) {
+				s->texture_ = texture;
+			}
+		}
+		const bool is_target = SDL_GetRenderTarget(renderer_) == old_texture;
+		ReleaseTexture(old_texture);
+		if (is_target) {
+			SDL_SetRenderTarget(renderer_, texture);
+			RestoreClipRect();
+		}
 	}
+	sprite.texture_ = texture;
+	sprite.width_ = width;
+	sprite.height_ = height;
+	SpriteChanged(sprite);
+}
+
+Sprite* RenderModule::RootSprite(Sprite& sprite) {
+	if (!sprite.is_sub_) {
+		return &sprite;
+	}
+	for (size_t i = 0; i < sprites_.slots(); i++) {
+		Sprite* s = sprites_[i];
+		if (s != nullptr && !s->is_sub_ && s->texture_ == sprite.texture_) {
+			return s;
+		}
+	}
+	return nullptr;
+}
+
+void RenderModule::SpriteChanged(Sprite& sprite) {
+	sprite.version_++;
+	if (sprite.texture_ == nullptr) {
+		return;
+	}
+	for (size_t i = 0; i < sprites_.slots(); i++) {
+		Sprite* s = sprites_[i];
+		if (s != nullptr && s != &sprite && s->texture_ == sprite.texture_) {
+			s->version_++;
+		}
+	}
+}
+
+bool RenderModule::RecreateTexture(Sprite& sprite) {
+	if (!sprite.is_render_ && !sprite.is_stream_) {
+		ARC_LOG_ERROR("RenderModule", "Unable to reload a sprite with no source.");
+		return false;
+	}
+	uint32_t format = SDL_PIXELFORMAT_ARGB8888;
+	int width = sprite.width_;
+	int height = sprite.height_;
+	if (sprite.texture_ != nullptr) {
+		SDL_QueryTexture(sprite.texture_, &format, nullptr, &width, &height);
+	}
+
+	SDL_Texture* texture = SDL_CreateTexture(renderer_, format,
+		sprite.is_render_ ? SDL_TEXTUREACCESS_TARGET : SDL_TEXTUREACCESS_STREAMING, width, height);
+	if (texture == nullptr) {
+		ARC_LOG_ERROR("RenderModule", string("Unable to create texture for reloaded sprite: ") + SDL_GetError());
+		return false;
+	}
+	ReplaceTexture(sprite, texture, width, height);
+	return true;
+}
+
+bool RenderModule::ReloadSprite(Sprite& sprite) {
+	FlushBatch();
+	Sprite* root = RootSprite(sprite);
+	if (root == nullptr) {
+		ARC_LOG_ERROR("RenderModule", "Unable to find the original sprite to reload.");
+		return false;
+	}
+	if (pending_uploads_.count(root) > 0) {
+		return true; // Still loading, so it gets a new texture anyways.
+	}
+	if (root->source_ == nullptr) {
+		return RecreateTexture(*root);
+	}
+
+	DecodedImage image;
+	image.sprite = root;
+	image.request = ++upload_request_count_;
+	SDL_RendererInfo info;
+	RendererInfo(info);
+	image.surface = SurfaceFromSpriteSource(*root->source_, image.error, &info);
+	pending_uploads_[root] = image.request;
+
+	const size_t failures = failed_uploads_;
+	UploadDecodedImage(image);
+	return failed_uploads_ == failures;
 }
 
 void RenderModule::DeleteSprite(Sprite& sprite) { // DANGER: Never use a deleted sprite! (or any sub-sprites!)
-	deletefromslotvector(sprites_, &sprite);
+	FlushBatch();
+	pending_uploads_.erase(&sprite);
+	sources_to_encode_.erase(&sprite);
+	for (size_t i = readbacks_.size(); i > 0; i--) {
+		if (readbacks_[i - 1].sprite == &sprite) {
+			SDL_DestroyTexture(readbacks_[i - 1].copy);
+			readbacks_.erase(readbacks_.begin() + (i - 1));
+		}
+	}
+	if (sprites_.get(sprite.handle()) == &sprite) {
+		ReleaseSpriteTexture(sprite);
+	}
+	if (!sprites_.remove(sprite.handle())) {
+		ARC_LOG_ERROR("RenderModule", "Unable to delete a sprite that was not made by the RenderModule.");
+	}
+}
+
+bool RenderModule::DeleteSprite(const SpriteHandle handle) {
+	Sprite* sprite = sprites_.get(handle);
+	if (sprite == nullptr) {
+		return false; // Already deleted.
+	}
+	DeleteSprite(*sprite);
+	return true;
 }
 
 Sprite& RenderModule::AddSpriteFromSDLTexture(SDL_Texture* texture, const int width, const int height) {
 	Sprite* s = new Sprite(texture, width, height);
-	return addtoslotvector(sprites_, s);
+	return AddSprite(s);
+}
+
+Sprite& RenderModule::AddSprite(Sprite* sprite) {
+	const SpriteHandle handle = sprites_.add(sprite);
+	if (handle == ARC_NULL_HANDLE) {
+		delete sprite;
+		throw graphics_error("Too many sprites");
+	}
+	sprite->handle_ = handle;
+	return *sprite;
 }
 
-void RenderModule::ReloadAllTextures() {
-	for (size_t i = 0; i < sprites_.size(); i++) {
+bool RenderModule::ReloadAllTextures() {
+	ClearPixelTextCache(); // Render targets lose their contents, so this is rendered again when needed.
+	FlushBatch();
+	RenderTargetsLost();
+	if (!upload_queue_) {
+		upload_queue_ = std::make_shared<sprite_upload_queue>();
+	}
+	std::shared_ptr<sprite_upload_queue> queue = upload_queue_;
+	SDL_RendererInfo info;
+	RendererInfo(info);
+
+	// Encoded now, as the uploads below are processed (which encodes one of these) while the sources
+	// are still being read by the other threads.
+	for (Sprite* s : sources_to_encode_) {
+		if (s->source_ != nullptr) {
+			CompactSpriteSource(*s->source_);
+		}
+	}
+	sources_to_encode_.clear();
+
+	bool ok = true;
+	const size_t failures = failed_uploads_;
+	for (size_t i = 0; i < sprites_.slots(); i++) {
 		Sprite* s = sprites_[i];
-		if (s != nullptr) {
-			if (!s->reload()) { // TODO: Fix any failures here! //
-				log::Error("RenderModule", "unable to reload sprite texture");
+		if (s == nullptr || s->is_sub_ || pending_uploads_.count(s) > 0) {
+			continue; // Sub-sprites are updated with the original, and pending sprites are still loading.
+		}
+		if (s->source_ == nullptr) {
+			if (s->texture_ != nullptr) { // Otherwise still waiting for a readback.
+				ok = RecreateTexture(*s) && ok;
 			}
+			continue;
 		}
+
+		const uint64_t request = ++upload_request_count_;
+		pending_uploads_[s] = request;
+		// Not changed or deleted until all of these are uploaded below.
+		const SpriteSource* source = s->source_;
+
+		thread_manager.Pool().run([queue, s, request, source, info]() {
+			DecodedImage image;
+			image.sprite = s;
+			image.request = request;
+			image.surface = SurfaceFromSpriteSource(*source, image.error, &info);
+			queue->push(std::move(image));
+		});
 	}
+
+	FinishSpriteUploads();
+	return ok && failed_uploads_ == failures;
 }
 
 
@@ -862,17 +2461,21 @@ GraphicsModule::~GraphicsModule() {
 	}
 }
 
-bool GraphicsModule::Init() {
+bool GraphicsModule::Init(const bool headless) {
 	if (initialized_) {
 		return true;
 	}
 
+	if (headless) {
+		SDL_setenv("SDL_VIDEODRIVER", "dummy", 0); // Not replaced if set, such as to use a virtual display.
+	}
+
 	if (SDL_Init(SDL_INIT_VIDEO) < 0) {
 		log::Fatal("GraphicsModule", string("SDL initalization error: ") + SDL_GetError());
 	} else {
 		initialized_ = true;
 		if (!SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "1")) { // Linear scaling.
-			log::Error("Linear texture scaling not supported!");
+			ARC_LOG_ERROR("Linear texture scaling not supported!");
 		}
 	}
 
@@ -950,6 +2553,10 @@ Screen& GraphicsModule::CreateCustomScreen(const ScreenProperties& properties) {
 		throw graphics_error("SDL graphics subsystem not initalized");
 	}
 
+	if (properties.type == SCREEN_HEADLESS) {
+		return AddHeadlessScreen(properties);
+	}
+
 	ScreenProperties props = properties;
 	
 #ifdef ARC_MOBILE
@@ -959,7 +2566,7 @@ Screen& GraphicsModule::CreateCustomScreen(const ScreenProperties& properties) {
 			props.width = displayDim.w;
 			props.height = displayDim.h;
 		} else {
-			log::Error("Graphics", "Unable to get the current screen resolution!");
+			ARC_LOG_ERROR("Graphics", "Unable to get the current screen resolution!");
 		}
 	}
 #endif
@@ -973,6 +2580,16 @@ Screen& GraphicsModule::CreateCustomScreen(const ScreenProperties& properties) {
 	return AddScreenFromPropertiesAndSDLWindow(props, window);
 }
 
+// SCREEN_HEADLESS
+Screen& GraphicsModule::CreateHeadlessScreen(const string& title, const int width, const int height) {
+	ScreenProperties props;
+	props.title = title;
+	props.type = SCREEN_HEADLESS;
+	props.width = width;
+	props.height = height;
+	return CreateCustomScreen(props);
+}
+
 void GraphicsModule::DeleteScreen(Screen& screen) { // DANGER: Never use a deleted screen!
 	deletefromslotvector(screens_, &screen);
 }
@@ -986,4 +2603,19 @@ Screen& GraphicsModule::AddScreenFromPropertiesAndSDLWindow(const ScreenProperti
 	return addtoslotvector(screens_, s);
 }
 
+Screen& GraphicsModule::AddHeadlessScreen(const ScreenProperties& props) {
+	SDL_Surface* surface = nullptr;
+	if (props.width > 0 && props.height > 0) {
+		surface = SDL_CreateRGBSurfaceWithFormat(0, props.width, props.height, 32, SDL_PIXELFORMAT_ARGB8888);
+	} else {
+		SDL_SetError("the width and height must be set");
+	}
+	if (surface == nullptr) {
+		log::Fatal("GraphicsModule", string("SDL headless screen creation error: ") + SDL_GetError());
+	}
+
+	Screen* s = new Screen(props, surface);
+	return addtoslotvector(screens_, s);
+}
+
 } // namespace arc
@@ -1,6 +1,11 @@
 #pragma once
 
 #include <exception>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #ifdef __APPLE__
@@ -40,6 +45,11 @@
 #endif
 //endif
 
+// SDL_RenderGeometry (2.0.18+) is used to draw queued sprites together, see RenderModule::FlushBatch
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+	#define ARC_RENDER_BATCHING 1
+#endif
+
 #include "log.h"
 #include "slot_vector.h"
 
@@ -48,10 +58,15 @@
 #define SCREEN_FULLMOBILE_WINDOWDESKTOP 0 /* Default */
 #define SCREEN_FULLSCREEN 1
 #define SCREEN_WINDOW 2 /* Doesn't work on mobile! */
+#define SCREEN_HEADLESS 3 /* No window, draws into an offscreen surface (for benchmarks and tests) */
 
 
 namespace arc {
 
+class skyline_packer; // See atlas.h
+class sprite_upload_queue; // See graphics.cpp
+struct DecodedImage;
+
 // Used for creating custom screens
 struct ScreenProperties {
 	string title;
@@ -89,6 +104,8 @@ inline SDL_Rect SDL_Rect_From_Coordinates(const int x, const int y, const int w,
 class Screen {
 public:
 	Screen(const ScreenProperties& properties, SDL_Window* window) : properties_(properties), window_(window) {}
+	// Headless (SCREEN_HEADLESS), the surface is drawn to with a software renderer.
+	Screen(const ScreenProperties& properties, SDL_Surface* surface) : properties_(properties), surface_(surface) {}
 	~Screen();
 
 	const string& title() const { return properties_.title; }
@@ -117,12 +134,16 @@ public:
 	void center();
 	void moveTo(const int xpos, const int ypos);
 
+	bool headless() const { return surface_ != nullptr; }
+	SDL_Surface* surface() { return surface_; } // Only for headless screens, the drawn pixels (after RenderFrameDone).
+
 protected:
 	void RecalculateWidthHeightFromRendererAspectRatio();
 
 	ScreenProperties properties_;
 	// ALL Owned
 	SDL_Window* window_ = nullptr;
+	SDL_Surface* surface_ = nullptr; // Instead of the window when headless.
 	SDL_Renderer* renderer_ = nullptr;
 	SDL_Renderer* sprite_renderer_ = nullptr;
 
@@ -192,6 +213,24 @@ const Color fuchsia(0xFF00FF);
 const Color purple(0x800080);
 // TODO: support the rest of the web/x11 colors!
 
+// A CPU-side copy of a sprite's pixels (or the file they were loaded from), so that the texture
+// can be made again if it is lost. Kept for static (non-streaming, non-render) sprites.
+struct SpriteSource {
+	std::string file_path; // If set, reloaded from this file instead.
+	bool bitmap = false;
+
+	uint32_t format = SDL_PIXELFORMAT_UNKNOWN;
+	int width = 0;
+	int height = 0;
+	// Only one of these is used: Rows without padding, or for 32-bit formats, the pixels
+	// run-length encoded as (count, pixel) pairs, when that is smaller.
+	std::vector<uint8_t> pixels;
+	std::vector<uint32_t> runs;
+};
+
+// Identifies a sprite of the RenderModule, see RenderModule::GetSprite.
+typedef uint32_t SpriteHandle;
+
 // Should always be used as a Sprite&
 class Sprite {
 public:
@@ -204,14 +243,21 @@ public:
 
 	SDL_Texture* texture() { return texture_; }
 	uint32_t format() { return format_; }
+	// False for sprites from SpriteFromImageAsync until uploaded. (These are not drawn, and are 0x0 until then.)
+	bool is_loaded() const { return texture_ != nullptr; }
 	bool is_sub() const { return is_sub_; }
 	bool is_stream() const { return is_stream_; }
 	bool is_render() const { return is_render_; }
+	// ARC_NULL_HANDLE if not made by the RenderModule.
+	SpriteHandle handle() const { return handle_; }
 
 	int x() const { return sub_x_; }
 	int y() const { return sub_y_; }
 	int width() const { return width_; }
 	int height() const { return height_; }
+	// Changed whenever the pixels or size change (also those of the original sprite, for sub-sprites),
+	// to know when anything drawing this must be drawn again.
+	uint32_t version() const { return version_; }
 
 	bool has_color_mod() const { return !color_mod_.is_transparent(); }
 	Color color_mod() const { return color_mod_; }
@@ -224,29 +270,35 @@ public:
 	bool sub_region(SDL_Rect& rect) const;
 	bool sub_region(SDL_Rect& rect, const int x, const int y, const int width, const int height, bool& ok, bool allow_crop = false) const;
 
-	bool reload() { return false; } // Reloads from the data cache in case the texture is lost. // TODO! //
+	// Makes the texture again (from the source) in case it is lost. Render and streaming sprites
+	// are made again empty, so they must be drawn again. Sub-sprites reload the original sprite.
+	bool reload();
+	const SpriteSource* source() const { return source_; }
 
 	// This only needs to be called for non-image (PNG) textures.
-	void enableAlphaBlending() {
-		SDL_SetTextureBlendMode(texture_, SDL_BLENDMODE_BLEND);
-	}
+	void enableAlphaBlending();
 
 	void SetRenderParams(); // Sets any neccessary color mod, or other transforms.
 
 protected:
 	SDL_Texture* texture_ = nullptr; // Owned, if sub_x/y are 0, otherwise NOT Owned.
-	Color color_mod_; // TODO: Multiple sprites sharing the same texture with a mix of color mod and none doesn't work yet! //
-	// TODO: Format/DataBuffer or Surface for caching/reloading of textures + to-sprite rendering.
+	// Applied per draw (as vertex colors when batching, otherwise set on the shared texture for each draw).
+	Color color_mod_;
+	SpriteSource* source_ = nullptr; // Owned, nullptr if none (or a sub-sprite).
 	uint32_t format_ = SDL_PIXELFORMAT_UNKNOWN;
+	SpriteHandle handle_ = ARC_NULL_HANDLE;
 	int sub_x_ = 0;
 	int sub_y_ = 0;
 	int width_ = 0;
 	int height_ = 0;
+	uint32_t version_ = 0;
 	uint8_t alpha_mod_ = 0;
 	bool is_sub_ = false;
 	bool is_stream_ = false;
 	bool is_render_ = false;
 
+	friend class RenderModule; // For async loading and reloading.
+
 	DELETE_COPY_AND_ASSIGN(Sprite);
 };
 
@@ -292,6 +344,45 @@ struct PixelFontData {
 	int line_spacing = 0; // Pixels between lines.
 };
 
+struct PixelTextLine {
+	size_t start = 0; // Index in the text.
+	size_t len = 0; // Not including the newline.
+	int width = 0;
+};
+
+// The size and lines of some pixel text, from a single pass over it.
+struct PixelTextLayout {
+	string text; // An owned copy of the text this was measured from.
+	size_t font_id = -1;
+	int width = 0;
+	int height = 0;
+	std::vector<PixelTextLine> lines;
+};
+
+// Render command types:
+#define ARC_RENDER_SPRITE 1
+#define ARC_RENDER_RECT 2
+#define ARC_RENDER_RECT_BORDER 3
+#define ARC_RENDER_LINE 4
+#define ARC_RENDER_CLEAR 5
+
+// A recorded draw, see RenderModule::BeginCommands. All in render coordinates (with the draw offset).
+struct RenderCommand {
+	uint8_t type;
+	SDL_BlendMode blend; // Of the texture, when recorded.
+	bool has_clip;
+	int32_t layer;
+	uint32_t sequence; // Recording order, so draws are otherwise kept in order when sorting.
+	uint32_t recording; // Which BeginCommands, so the textures it used are kept until it is submitted.
+	SDL_Texture* texture; // Only for sprites, NOT Owned
+	SDL_Rect src; // Texture region for sprites
+	SDL_Rect dst; // For lines, x, y is the start and w, h is the end.
+	SDL_Rect clip;
+	SDL_Color color; // The color, or the color and alpha mod for sprites.
+};
+
+typedef std::vector<RenderCommand> RenderCommandBuffer;
+
 // TODO: Multiple window support simulataneously with threads.
 // TODO: Render to sprites (may currently fail!)
 class RenderModule {
@@ -304,6 +395,25 @@ public:
 	void SetSpriteContext(Sprite& sprite); // Render to a sprite instead of the screen.
 	void ClearSpriteContext(); // Render to the screen again.
 
+	// Only draws inside this rectangle (in render coordinates, the draw offset is not added).
+	// Changing the screen or sprite context clears it.
+	void SetClipRect(const int x, const int y, const int width, const int height);
+	void ClearClipRect();
+
+	// Nested clipping (such as for canvases): Only draws inside this rectangle (relative to the draw
+	// offset) and the current clip rect, until the matching PopClip. Pop all of them before changing
+	// the screen or sprite context.
+	void PushClip(const int x, const int y, const int width, const int height);
+	void PopClip();
+	// True if nothing of this rectangle (relative to the draw offset) would be drawn due to the clip
+	// rect, so drawing it can be skipped.
+	bool IsClippedOut(const int x, const int y, const int width, const int height) const;
+
+	// Called by the event loop when the contents of all render sprites are lost, so anything kept
+	// in them must be drawn again. Also counted when reloading all textures.
+	void RenderTargetsLost() { render_targets_lost_++; }
+	uint32_t RenderTargetsLostCount() const { return render_targets_lost_; }
+
 	//bool SetDefaultFont(const string& font); // TODO: Returns if font was successfully found and loaded.
 	void SetDefaultFontSize(const uint32_t font_size_px) { font_size_px_ = font_size_px; }
 
@@ -330,20 +440,28 @@ public:
 	void DrawLine(const int x_start, const int y_start, const int x_end, const int y_end);
 	void DrawLine(const int x_start, const int y_start, const int x_end, const int y_end, const Color& color);
 
+	// Blending uses the pixel's straight alpha, the same as raster::BlendSpan32.
 	void DrawLineIntoBuffer32(DataBuffer& buffer,
 		const int x_start, const int y_start, const int x_end, const int y_end,
 		const int thickness, const uint32_t pixel_value, const bool blending = false);
 
-	void DrawSprite(Sprite& sprite, const int x = 0, const int y = 0); // Default = 0 allows for offset drawing.
+	// The tint is multiplied with the sprite's colors (and its alpha with the alpha) for only this draw,
+	// on top of any color or alpha mod of the sprite, so white draws it unchanged. Tinted draws of the
+	// same texture are still batched together, and the texture itself is not changed.
+	void DrawSprite(Sprite& sprite, const int x = 0, const int y = 0) { DrawSprite(sprite, x, y, white); } // Default = 0 allows for offset drawing.
+	void DrawSprite(Sprite& sprite, const int x, const int y, const Color& tint);
 	void DrawSpriteSubRegion(Sprite& sprite, const int x, const int y, const int sub_x, const int sub_y,
-		const int sub_width, const int sub_height, const bool allow_crop = false);
-	void DrawSpriteScaling(Sprite& sprite, const int x, const int y, const double scale_factor);
+		const int sub_width, const int sub_height, const bool allow_crop = false) {
+		DrawSpriteSubRegion(sprite, x, y, sub_x, sub_y, sub_width, sub_height, white, allow_crop); }
+	void DrawSpriteSubRegion(Sprite& sprite, const int x, const int y, const int sub_x, const int sub_y,
+		const int sub_width, const int sub_height, const Color& tint, const bool allow_crop = false);
+	void DrawSpriteScaling(Sprite& sprite, const int x, const int y, const double scale_factor, const Color& tint = white);
 
 	void DrawSpriteStretch(Sprite& sprite, const int width, const int height) { DrawSpriteStretch(sprite, 0, 0, width, height); }
-	void DrawSpriteStretch(Sprite& sprite, const int x, const int y, const int width, const int height);
+	void DrawSpriteStretch(Sprite& sprite, const int x, const int y, const int width, const int height, const Color& tint = white);
 
 	void DrawSpriteTiled(Sprite& sprite, const int width, const int height) { DrawSpriteTiled(sprite, 0, 0, width, height); }
-	void DrawSpriteTiled(Sprite& sprite, const int x, const int y, const int width, const int height);
+	void DrawSpriteTiled(Sprite& sprite, const int x, const int y, const int width, const int height, const Color& tint = white);
 
 	void DrawPixelText(const string& text, const size_t font_id, int x, int y, const Color& color, const Color& back_color = transparent);
 	void DrawPixelText(const string& text, const size_t font_id, const int x, const int y) { DrawPixelText(text, font_id, x, y, draw_color_, transparent); }
@@ -352,6 +470,29 @@ public:
 	void DrawPixelText(const string& text, const size_t font_id) { DrawPixelText(text, font_id, 0, 0, draw_color_, transparent); }
 	void DrawPixelText(const string& text) { DrawPixelText(text, 0, 0, 0, draw_color_, transparent); }
 
+	// Draws the text from a cached sprite (rendered when first drawn), so unchanged text is a single
+	// draw with the same pixels as drawing it directly. Cached per text, font and background color (not the text color, which DrawPixelText
+	// doesn't apply yet). Use for text that rarely changes.
+	void DrawPixelTextCached(const string& text, const size_t font_id, const int x, const int y,
+		const Color& color, const Color& back_color = transparent);
+	void DrawPixelTextCached(const string& text, const size_t font_id, const int x = 0, const int y = 0) {
+		DrawPixelTextCached(text, font_id, x, y, draw_color_, transparent); }
+
+	// The least recently used cached text is removed (a page at a time) to stay within the budget.
+	void SetPixelTextCacheBudget(const size_t max_bytes);
+	void ClearPixelTextCache(); // Needed if a pixel font sprite has changed.
+
+	// Measures the width, height, and lines all at once.
+	void MeasurePixelText(const string& text, const size_t font_id, PixelTextLayout& layout);
+	PixelTextLayout MeasurePixelText(const string& text, const size_t font_id = 0) {
+		PixelTextLayout layout;
+		MeasurePixelText(text, font_id, layout);
+		return layout;
+	}
+	// Only measures again if the text or font has changed since this layout was measured, so keeping
+	// a layout per text makes repeated layout passes cheap. Returns true if it was measured again.
+	bool LayoutPixelText(const string& text, const size_t font_id, PixelTextLayout& layout);
+
 	void GetPixelTextSize(const string& text, const size_t font_id, int& width, int& height);
 	void GetPixelTextSize(const string& text, int& width, int& height) { GetPixelTextSize(text, 0, width, height); }
 	int GetPixelTextWidth(const string& text, const size_t font_id = 0);
@@ -359,6 +500,32 @@ public:
 
 	void RenderFrameDone(); // Presents the frame to the screen.
 
+	// Sprite draws are queued while they use the same texture and blend mode, and then drawn all at
+	// once. Any other drawing (or render target change) through the RenderModule flushes the queue
+	// first, so this only needs to be called before drawing with SDL directly.
+	void FlushBatch();
+
+	// Command buffer mode: While recording, all draws (and clears) are saved as commands instead,
+	// which are sorted by layer, then texture, then blend mode when submitted, so that more of them
+	// can be batched. Draws in the same layer may be reordered, so put overlapping draws on
+	// separate layers. The render target must not be changed while recording.
+	// Commands can also be kept to submit later (such as while the next frame is recorded), as long
+	// as the textures they use are not deleted. Submitting must still be on the rendering thread.
+	// Until the commands are submitted (or discarded), textures of deleted or reloaded sprites are
+	// kept, and the pixel text cache pages they draw are not evicted (text that doesn't fit is drawn
+	// uncached instead), so the recorded commands still draw the same pixels. So every ended buffer
+	// must be submitted or discarded.
+	void BeginCommands();
+	void EndCommands(RenderCommandBuffer& commands); // Replaces commands with the recorded ones.
+	void SubmitCommands(); // Ends recording, then submits the recorded commands.
+	void SubmitCommands(RenderCommandBuffer& commands); // Sorted in place, then drawn.
+	void DiscardCommands(RenderCommandBuffer& commands); // Clears ended commands without drawing them.
+	bool IsRecordingCommands() const { return recording_; }
+	void SetDrawLayer(const int layer) { draw_layer_ = layer; } // Lower layers are drawn first.
+	int GetDrawLayer() const { return draw_layer_; }
+	// One line per command, for debugging.
+	static string CommandsToString(const RenderCommandBuffer& commands);
+
 	//bool LoadFont(const string& font); // TODO: Returns if succesful.
 	size_t LoadPixelFont(const PixelFontData& font_data); // Returns the font ID.
 
@@ -371,6 +538,16 @@ public:
 	Sprite& SpriteFromImage(const string& file_path, const bool stream = false); // Including PNG, etc.
 	Sprite& SpriteFromDataBuffer(const DataBuffer& data, const bool stream = false);
 
+	// The image is decoded on the worker thread pool, and then the texture is created on the render
+	// thread by ProcessSpriteUploads. Until then the sprite is only a placeholder, see is_loaded().
+	Sprite& SpriteFromImageAsync(const string& file_path, const bool stream = false);
+	Sprite& SpriteFromBitmapAsync(const string& file_path, const bool stream = false);
+	// Call once per frame: Creates textures for decoded images until budget_us (microseconds) is used.
+	// (At least one is always created, if any are ready.) Returns the number of sprites created.
+	size_t ProcessSpriteUploads(const uint32_t budget_us = 2000);
+	size_t PendingSpriteUploads() const { return pending_uploads_.size(); }
+	void FinishSpriteUploads(); // Waits for and creates all of them. (e.g. For a loading screen)
+
 	// WARNING: Leaves out any letters not in the pixel font!
 	// Also note that transparent == default sprite color.
 	Sprite& SpriteFromPixelText(const string& text, const size_t font_id,
@@ -378,31 +555,155 @@ public:
 
 	Sprite& SpriteFromSubRegion(Sprite& sprite, const int sub_x, const int sub_y, const int sub_width, const int sub_height);
 
+	// Note that drawing with a tint (see DrawSprite) does the same without another sprite.
 	Sprite& SpriteFromColorMod(Sprite& sprite, const Color& color_mod);
 
 	// Makes a static sprite from a rendered sprite using the render pixels from SDL_RenderReadPixels... (so it doesn't have to be drawn again)
 	Sprite& SpriteFromRenderSprite(Sprite& sprite);
 
+	// Deferred readback: The render sprite is copied now (which doesn't wait for the GPU), and the pixels
+	// are read back from the copy by ProcessSpriteUploads after the next RenderFrameDone, when the copy
+	// is (usually) finished, so drawing doesn't stall on it.
+	// The sprite is a placeholder until then, as with SpriteFromImageAsync.
+	Sprite& SpriteFromRenderSpriteAsync(Sprite& sprite);
+	// The pixels are only valid during the call of done, which is on the rendering thread.
+	// Returns false (and done is never called) if the render sprite could not be copied.
+	bool ReadbackRenderSprite(Sprite& sprite, std::function<void(const DataBuffer&)> done);
+	size_t PendingReadbacks() const { return readbacks_.size(); }
+	void FinishReadbacks(); // Reads back all of them now. (Stalls until the GPU is done!)
+
+	// Reads the pixels of the current render target (the screen or sprite context) into buffer.data,
+	// which is allocated with malloc, so it must be freed with free(). Returns false on failure.
+	bool CaptureFrame(DataBuffer& buffer, const uint32_t format = SDL_PIXELFORMAT_ARGB8888);
+	bool SaveFrameToPNG(const string& file_path); // Captures the current render target to a PNG file.
+
 	void UpdateSpriteFromDataBuffer(Sprite& sprite, const DataBuffer& data);
+	// Only updates the data.width x data.height region at x, y (in sprite coordinates), clipped to the sprite.
+	void UpdateSpriteRegionFromDataBuffer(Sprite& sprite, const int x, const int y, const DataBuffer& data);
+	// data is the whole sprite, but only the changed (dirty) rects of it are uploaded.
+	void UpdateSpriteRectsFromDataBuffer(Sprite& sprite, const DataBuffer& data, const SDL_Rect* rects, const size_t count);
+
+	// Streaming sprites only: Hands out the texture's own memory (of rect clipped to the sprite, or the whole
+	// sprite if nullptr) as buffer, to draw into directly without another copy. Returns false if the rect is empty. Note that the old pixels are NOT kept,
+	// so all of it must be drawn again (before any blending). Call UnlockSprite when done, before drawing.
+	bool LockSpriteForWrite(Sprite& sprite, DataBuffer& buffer, const SDL_Rect* rect = nullptr);
+	void UnlockSprite(Sprite& sprite);
 
 	void DeleteSprite(Sprite& sprite); // DANGER: Never use a deleted sprite! (Or any sub-sprites!)
+	// Sprites can also be kept by handle instead, which is safe to use after the sprite is deleted:
+	// Deleting it again returns false, and GetSprite returns nullptr.
+	bool DeleteSprite(const SpriteHandle handle);
+	Sprite* GetSprite(const SpriteHandle handle) const { return sprites_.get(handle); }
+	bool IsSpriteValid(const SpriteHandle handle) const { return sprites_.get(handle) != nullptr; }
+	size_t SpriteCount() const { return sprites_.size(); } // Including sub-sprites.
 
 	// Only necessary to enable this when using background blending, not just texture blending.
 	void EnableAlphaBlending() { SDL_SetRenderDrawBlendMode(renderer_, SDL_BLENDMODE_BLEND); }
 	void DisableAlphaBlending() { SDL_SetRenderDrawBlendMode(renderer_, SDL_BLENDMODE_NONE); }
 
-	// Generally only called by the event processing loop, when the draw device/video memory is lost. // TODO //
-	void ReloadAllTextures();
+	// Generally only called by the event processing loop, when the draw device/video memory is lost.
+	// Sprites with a source are decoded again on the worker threads, then all are uploaded before
+	// returning. Returns false if any sprite could not be reloaded.
+	bool ReloadAllTextures();
+	bool ReloadSprite(Sprite& sprite); // See Sprite::reload()
 
 private:
 	Sprite& AddSpriteFromSDLTexture(SDL_Texture* texture, const int width, const int height);
+	// Takes ownership of sprite, and gives it a handle.
+	Sprite& AddSprite(Sprite* sprite);
+
+	// Lines are only added if lines is not null.
+	void MeasurePixelTextInternal(const string& text, const size_t font_id, int& width, int& height,
+		std::vector<PixelTextLine>* lines);
+
+	// src is in texture pixels, dst in render pixels (including the draw offset).
+	void QueueSpriteQuad(Sprite& sprite, const SDL_Rect& src, const SDL_Rect& dst, const Color& tint = white);
+	// With the given blend mode, instead of the texture's.
+	void QueueSpriteQuad(Sprite& sprite, const SDL_Rect& src, const SDL_Rect& dst, const Color& tint, const SDL_BlendMode blend);
+	void QueueTextureQuad(SDL_Texture* texture, const SDL_BlendMode blend, const SDL_Rect& src, const SDL_Rect& dst,
+		const SDL_Color& color);
+	// Returns a new command (with the current layer and clip) to fill in.
+	RenderCommand& RecordCommand(const uint8_t type);
+
+	struct PixelTextRun {
+		size_t page = 0;
+		SDL_Rect rect;
+		uint64_t last_used = 0;
+	};
+	struct PixelTextPage {
+		Sprite* sprite = nullptr; // NOT Owned (in sprites_)
+		skyline_packer* packer = nullptr; // Owned
+		uint32_t recording = 0; // The last recording that drew from this page, 0 if none.
+	};
+
+	Sprite& LoadSpriteAsync(const string& file_path, const bool stream, const bool bitmap);
+	// Also replaces the texture of a sprite being reloaded.
+	void UploadDecodedImage(DecodedImage& image);
+	// Replaces the texture of the sprite and all of its sub-sprites.
+	void ReplaceTexture(Sprite& sprite, SDL_Texture* texture, const int width, const int height);
+	// The sprite that owns the texture (this one if not a sub-sprite), or nullptr if not found.
+	Sprite* RootSprite(Sprite& sprite);
+	// Changes the version of the sprite, and of all others sharing its texture.
+	void SpriteChanged(Sprite& sprite);
+	// For render and streaming sprites without a source, makes a new empty texture.
+	bool RecreateTexture(Sprite& sprite);
+
+	// Deferred readbacks, see SpriteFromRenderSpriteAsync:
+	struct PendingReadback {
+		SDL_Texture* copy = nullptr; // Owned
+		int width = 0;
+		int height = 0;
+		uint64_t frame = 0; // Ready after this frame is done.
+		Sprite* sprite = nullptr; // Placeholder to fill in, or nullptr to call done instead.
+		std::function<void(const DataBuffer&)> done;
+	};
+	bool QueueReadback(Sprite& sprite, PendingReadback& readback);
+	void FinishReadback(PendingReadback& readback);
+	// Copies data to rect of the sprite's texture (or all of it if nullptr), converting the pixels
+	// first if the texture has another format.
+	void UploadPixels(Sprite& sprite, const SDL_Rect* rect, const DataBuffer& data);
+	// Uploads the rects (in sprite coordinates, inside the sprite and data) of data, which starts at
+	// data_x, data_y of the sprite, and updates its pixel source. Streaming sprites are locked once.
+	void UploadSpriteRects(Sprite& sprite, const DataBuffer& data, const int data_x, const int data_y,
+		const SDL_Rect* rects, const size_t count);
+	// The format to create textures in for pixels in format, see NativeTextureFormat in graphics.cpp.
+	uint32_t NativeTextureFormat(const uint32_t format);
+	// Of the current renderer, returns false (with no texture formats) if there is none.
+	bool RendererInfo(SDL_RendererInfo& info);
+	// A free staging buffer of at least len bytes (from the pool if possible), to return when done.
+	std::vector<uint8_t> AcquireStagingBuffer(const size_t len);
+	void ReleaseStagingBuffer(std::vector<uint8_t>&& buffer);
+	// After switching the render target back (such as for the pixel text cache).
+	void RestoreClipRect() { if (has_clip_) SDL_RenderSetClipRect(renderer_, &clip_rect_); }
+	// Only changes the clip rect if different, as that ends the current batch.
+	void ApplyClip(const bool has_clip, const SDL_Rect& rect);
+
+	// Returns nullptr if the text can't be cached.
+	const PixelTextRun* FindOrRenderPixelTextRun(const string& text, const size_t font_id, const Color& color, const Color& back_color);
+	// Returns false if the page could not be made.
+	bool AllocatePixelTextRun(const int width, const int height, size_t& page, int& x, int& y);
+	void ClearPixelTextPage(const size_t page);
+	// Destroys the texture, or keeps it until the recorded commands are submitted.
+	void ReleaseTexture(SDL_Texture* texture);
+	void ReleaseSpriteTexture(Sprite& sprite); // Before removing the sprite.
+	// Marks the recordings of the commands as submitted, then destroys the textures no longer used.
+	void CommandsSubmitted(const RenderCommandBuffer& commands);
+	void RecordingSubmitted(const uint32_t recording);
+	// Recordings before this are all submitted (UINT32_MAX if all are).
+	uint32_t OldestUnsubmittedRecording() const;
 
 	// Owned, for automatic memory management.
-	std::vector<Sprite*> sprites_;
+	slot_pool<Sprite> sprites_;
 
 	// Loaded pixel fonts:
 	std::vector<PixelFontData> pixel_fonts_;
 
+	// Precomputed when loading each pixel font (same index as pixel_fonts_):
+	struct PixelFontMetrics {
+		int16_t advance[256]; // Width of each character (byte), or -1 if it is skipped.
+	};
+	std::vector<PixelFontMetrics> pixel_font_metrics_;
+
 	Screen* screen_ = nullptr;
 	SDL_Renderer* renderer_ = nullptr; // Whatever renderer is being used currently.
 	// Defaults:
@@ -410,8 +711,61 @@ private:
 	Color draw_color_;
 	int off_x_ = 0;
 	int off_y_ = 0;
+	SDL_Rect clip_rect_;
+	bool has_clip_ = false;
+	struct ClipState {
+		SDL_Rect rect;
+		bool has_clip;
+	};
+	std::vector<ClipState> clip_stack_; // Before each PushClip.
+
+	// Command buffer mode:
+	RenderCommandBuffer commands_;
+	int draw_layer_ = 0;
+	bool recording_ = false;
+	uint32_t recording_count_ = 0; // Each BeginCommands is numbered, starting at 1.
+	std::vector<uint32_t> unsubmitted_recordings_; // Including the current one.
+	struct ReleasedTexture {
+		SDL_Texture* texture; // Owned
+		uint32_t recording; // The last recording when released, which may still use it.
+	};
+	std::vector<ReleasedTexture> released_textures_; // See ReleaseTexture
+	uint32_t render_targets_lost_ = 0;
 	string font_ = "";
 	uint32_t font_size_px_ = 0;
+
+	// Async loading: Decoded images from the workers, and the sprites waiting for them (with the
+	// request id, in case a sprite is deleted and another is allocated at the same address).
+	std::shared_ptr<sprite_upload_queue> upload_queue_;
+	std::unordered_map<Sprite*, uint64_t> pending_uploads_;
+	uint64_t upload_request_count_ = 0;
+	size_t failed_uploads_ = 0;
+	// Sprite sources expanded for region updates, encoded again during ProcessSpriteUploads.
+	std::unordered_set<Sprite*> sources_to_encode_;
+
+	// Deferred readbacks, see SpriteFromRenderSpriteAsync:
+	std::vector<PendingReadback> readbacks_;
+	uint64_t frames_done_ = 0;
+	// Reused pixel buffers for readbacks:
+	std::vector<std::vector<uint8_t>> staging_buffers_;
+	std::vector<SDL_Rect> update_rects_; // Reused by UpdateSpriteRectsFromDataBuffer.
+
+	// Cached pixel text, keyed by the text, font id, and colors:
+	std::unordered_map<std::string, PixelTextRun> text_runs_;
+	std::vector<PixelTextPage> text_pages_;
+	std::string text_key_; // Reused for lookups.
+	uint64_t text_use_count_ = 0;
+	size_t text_cache_budget_ = 4 * 512 * 512 * 4; // 4 pages
+
+#ifdef ARC_RENDER_BATCHING
+	// Queued sprite quads, 4 vertices and 6 indices each:
+	std::vector<SDL_Vertex> batch_vertices_;
+	std::vector<int> batch_indices_;
+	SDL_Texture* batch_texture_ = nullptr; // NOT Owned
+	SDL_BlendMode batch_blend_ = SDL_BLENDMODE_NONE;
+	float batch_texture_width_ = 1.0f;
+	float batch_texture_height_ = 1.0f;
+#endif
 };
 
 extern RenderModule render;
@@ -423,7 +777,9 @@ public:
 	GraphicsModule() {}
 	~GraphicsModule();
 
-	bool Init();
+	// Headless uses the SDL dummy video driver (unless SDL_VIDEODRIVER is set), so no display is needed.
+	// (Only for SCREEN_HEADLESS screens.)
+	bool Init(const bool headless = false);
 
 	Screen& CreateFullScreen(const string& title, const int width = 0, const int height = 0); // SCREEN_FULLSCREEN
 	Screen& CreateExactScreen(const string& title, const int width, const int height,
@@ -431,11 +787,13 @@ public:
 	Screen& CreateWindowScreen(const string& title, const int width, const int height,
 							   const int xpos = SDL_WINDOWPOS_UNDEFINED, const int ypos = SDL_WINDOWPOS_UNDEFINED); // SCREEN_WINDOW
 	Screen& CreateCustomScreen(const ScreenProperties& properties);
+	Screen& CreateHeadlessScreen(const string& title, const int width, const int height); // SCREEN_HEADLESS
 
 	void DeleteScreen(Screen& screen); // DANGER: Never use a deleted screen!
 
 private:
 	Screen& AddScreenFromPropertiesAndSDLWindow(const ScreenProperties& props, SDL_Window* window);
+	Screen& AddHeadlessScreen(const ScreenProperties& props);
 
 	std::vector<Screen*> screens_; // For automatic memory management.
 	bool initialized_ = false;
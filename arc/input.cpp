@@ -1,5 +1,7 @@
 #include "input.h"
 
+#include "trace.h"
+
 namespace arc {
 
 inline int32_t float_to_int32_round(float x) {
@@ -14,13 +16,15 @@ int SDLCALL InternalHandleInterruptEvent(void*, SDL_Event* event) { // (First po
 }
 
 int InputModule::ExecEventHandlerLoop() { // Doesn't return until quit!
+	ARC_TRACE_THREAD_NAME("main (event loop)");
+
 	uint64_t last_frame_start_ticks = 0;
 	uint64_t frame_start_ticks = SDL_GetPerformanceCounter();
 	const uint64_t ticks_per_sec = SDL_GetPerformanceFrequency();
 	ticks_per_frame_ = ticks_per_sec / uint64_t(max_framerate_);
 	const double ticks_per_msec_double = double(ticks_per_sec) / 1000.0;
+	uint64_t frame_deadline = frame_start_ticks + ticks_per_frame_;
 
-	uint64_t frame_count = 0;
 	double frame_msec_per_60 = 0.0;
 
 	// Interrupt Handler
@@ -29,7 +33,9 @@ int InputModule::ExecEventHandlerLoop() { // Doesn't return until quit!
 	while (!quit_.load(std::memory_order_relaxed)) {
 		last_frame_start_ticks = frame_start_ticks;
 		frame_start_ticks = SDL_GetPerformanceCounter();
-		const double frame_delta_time_msec = double(frame_start_ticks - last_frame_start_ticks) / ticks_per_msec_double;
+		const bool fixed_time = fixed_frame_msec_ > 0.0;
+		const double frame_delta_time_msec = fixed_time ? fixed_frame_msec_
+			: double(frame_start_ticks - last_frame_start_ticks) / ticks_per_msec_double;
 
 		// Handle Events
 		SDL_Event event;
@@ -223,24 +229,28 @@ int InputModule::ExecEventHandlerLoop() { // Doesn't return until quit!
 				break;
 				*/
 				case SDL_RENDER_TARGETS_RESET:
-				// Ignore as all render targets are automatically cached, or redrawn every frame anyways.
+				// So anything kept in render sprites (such as the Blocks frame) is drawn again.
+				render.RenderTargetsLost();
+				render.ClearPixelTextCache();
 				break;
 				case SDL_RENDER_DEVICE_RESET:
-                // TODO: Also ignore for same reason as above?
-				//render.ReloadAllTextures();
+				// All textures are lost, so make them again from their sources.
+				if (!render.ReloadAllTextures()) {
+					ARC_LOG_ERROR("Input", "Unable to reload all textures after the render device was reset.");
+				}
 				break;
 				case SDL_KEYMAPCHANGED:
 				// Ignore currently.
 				break;
 				case SDL_CLIPBOARDUPDATE:
 				// TODO!
-				log::Warn("Clipboard not yet supported!");
+				ARC_LOG_WARN("Clipboard not yet supported!");
 				break;
 				case SDL_DROPFILE:
 				case SDL_DROPTEXT:
 				case SDL_DROPBEGIN:
 				case SDL_DROPCOMPLETE:
-				log::Warn("Drag and drop data not yet supported!");
+				ARC_LOG_WARN("Drag and drop data not yet supported!");
 				break;
                 case SDL_APP_WILLENTERBACKGROUND:
                 case SDL_APP_WILLENTERFOREGROUND:
@@ -254,7 +264,7 @@ int InputModule::ExecEventHandlerLoop() { // Doesn't return until quit!
                 case SDL_DOLLARRECORD:
 				case SDL_SYSWMEVENT:
 				default:
-				log::Warn("Unsupported event was sent to the event processing loop");
+				ARC_LOG_WARN("Unsupported event was sent to the event processing loop");
 				break;
 			}
 			if (e.type != Invalid) {
@@ -276,14 +286,14 @@ int InputModule::ExecEventHandlerLoop() { // Doesn't return until quit!
 			frame_draw_func_(frame_delta_time_msec);
 		}
 
-		frame_count++;
+		frame_count_++;
 		frame_msec_per_60 += frame_delta_time_msec;
-		if (frame_count % 60 == 0) {
+		if (frame_count_ % 60 == 0) {
 			const unsigned int fps = (unsigned int) ((60000.0 / frame_msec_per_60) + 0.5);
 			frame_msec_per_60 = 0.0;
-            if (fps < 60) {
+            if (fps < 60 && !fixed_time) {
             	// TODO: Disable this if debugging not needed.
-                log::Info("Input", "Frame " + string::itoa(frame_count) + (drawing ? " drawing" : " not drawing")
+                ARC_LOG_INFO("Input", "Frame " + string::itoa(frame_count_) + (drawing ? " drawing" : " not drawing")
                           + string(", fps: ") + string::itoa(fps));
             }
 		}
@@ -292,12 +302,29 @@ int InputModule::ExecEventHandlerLoop() { // Doesn't return until quit!
 			return 0;
 		}
 
+		if (quit_after_frame_ != 0 && frame_count_ >= quit_after_frame_) {
+			quit_after_frame_ = 0;
+			return 0;
+		}
+		if (fixed_time) {
+			continue;
+		}
+
 		// Wait if we're controlling maximum framerate manually/vsync not on.
 		// (Otherwise this is handled by the renderer/OpenGL which is used in the frame_draw_func_)
-		const uint64_t frame_ticks = SDL_GetPerformanceCounter() - frame_start_ticks;
-		if (frame_ticks < ticks_per_frame_) {
-			SDL_Delay( (uint32_t) (((ticks_per_frame_ - frame_ticks) * 1000) / ticks_per_sec) );
+		// Deadlines are every ticks_per_frame_ from the first frame, so the waits don't drift.
+		if (frame_deadline < frame_start_ticks) {
+			frame_deadline = frame_start_ticks + ticks_per_frame_; // After fixed frame times.
+		}
+		uint64_t frame_end_ticks = SDL_GetPerformanceCounter();
+		const bool missed = frame_end_ticks > frame_deadline;
+		if (missed) {
+			frame_deadline = frame_end_ticks; // Too late, so start again from now instead of rushing the next frames.
+		} else {
+			frame_end_ticks = pacer_.WaitUntil(frame_deadline);
 		}
+		frame_deadline += ticks_per_frame_;
+		frame_times_.Add(double(frame_end_ticks - frame_start_ticks) / ticks_per_msec_double, missed);
 	}
 	return 0;
 }
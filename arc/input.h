@@ -4,6 +4,7 @@
 #include <map>
 #include <atomic>
 
+#include "frame_timing.h"
 #include "graphics.h"
 
 namespace arc {
@@ -32,6 +33,21 @@ public:
 	void SetMaximumFrameRate(const unsigned int max_framerate) {
 		max_framerate_ = max_framerate; ticks_per_frame_ = SDL_GetPerformanceFrequency() / uint64_t(max_framerate);
 	}
+
+	// Deterministic frame clock (for benchmarks and tests): Every frame is given exactly frame_msec as
+	// its delta time, and frames are not waited for. 0 returns to the real time.
+	void SetFixedFrameTime(const double frame_msec) { fixed_frame_msec_ = frame_msec; }
+	// Exits the event loop after this many more frames, 0 to run until quit.
+	void QuitAfterFrames(const uint64_t frames) { quit_after_frame_ = frames > 0 ? frame_count_ + frames : 0; }
+	uint64_t FrameCount() const { return frame_count_; } // Frames run by the event loop so far.
+
+	// Frame pacing telemetry (of the real frame times, not fixed ones): The time between the starts
+	// of each frame, and if it missed the deadline of the maximum frame rate. Read these from the
+	// event loop thread, such as in the frame draw function.
+	const FrameTimeStats& FrameTimes() const { return frame_times_; }
+	void ClearFrameTimes() { frame_times_.Clear(); }
+	// How long before each frame deadline sleeping stops, and spinning starts.
+	double FrameSleepMarginMsec() const { return pacer_.SleepMarginMsec(); }
 	
 	// All Quit-related functions are Thread Safe
 	// Exit the event loop.
@@ -226,6 +242,13 @@ protected:
 	unsigned int max_framerate_ = 120;
 	bool vsync_on_ = true;
 
+	double fixed_frame_msec_ = 0.0;
+	uint64_t frame_count_ = 0;
+	uint64_t quit_after_frame_ = 0;
+
+	FramePacer pacer_;
+	FrameTimeStats frame_times_;
+
 	std::atomic_bool screen_drawing_; // TODO: Per-screen support! (When the window is hidden, frame_draw_func_ is not called)
 	
 	std::atomic_bool quit_immediately_;
@@ -0,0 +1,400 @@
+#include "io_ring.h"
+
+#include "log.h"
+#include "trace.h"
+#include "string.h"
+
+#ifdef __linux__
+	#include <linux/io_uring.h>
+	#include <sys/syscall.h>
+	#include <sys/mman.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <errno.h>
+#endif
+
+namespace arc {
+
+#ifdef __linux__
+
+struct io_ring::io_ring_sqe_internal {
+	io_uring_sqe sqe;
+};
+
+inline int sys_io_uring_setup(const unsigned int entries, io_uring_params* params) {
+	return (int) syscall(__NR_io_uring_setup, entries, params);
+}
+
+inline int sys_io_uring_enter(const int fd, const unsigned int to_submit, const unsigned int min_complete, const unsigned int flags) {
+	return (int) syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0);
+}
+
+inline int sys_io_uring_register(const int fd, const unsigned int opcode, void* arg, const unsigned int nr_args) {
+	return (int) syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+// Checks that all operations used by the queue functions are supported by this kernel.
+bool internal_io_ring_probe(const int fd) {
+	const size_t probe_len = sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op);
+	io_uring_probe* probe = (io_uring_probe*) calloc(1, probe_len);
+	if (probe == nullptr) {
+		return false;
+	}
+	bool ok = false;
+	if (sys_io_uring_register(fd, IORING_REGISTER_PROBE, probe, 256) == 0) {
+		const uint8_t needed[] = { IORING_OP_NOP, IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_WRITE, IORING_OP_CLOSE, IORING_OP_STATX };
+		ok = true;
+		for (size_t i = 0; i < sizeof(needed); i++) {
+			const uint8_t op = needed[i];
+			if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) {
+				ok = false;
+				break;
+			}
+		}
+	}
+	free(probe);
+	return ok;
+}
+
+bool io_ring::init(const unsigned int entries) {
+	if (available()) {
+		return true;
+	}
+
+	io_uring_params params;
+	memset(&params, 0, sizeof(params));
+	params.flags = IORING_SETUP_CQSIZE;
+	params.cq_entries = entries * 4; // Room for completions that are not reaped yet.
+
+	const int fd = sys_io_uring_setup(entries, &params);
+	if (fd < 0) {
+		return false; // Not supported (or not permitted) here, use the fallback.
+	}
+
+	if (!internal_io_ring_probe(fd)) {
+		close(fd);
+		return false;
+	}
+
+	sq_entries_ = params.sq_entries;
+	cq_entries_ = params.cq_entries;
+	sq_map_len_ = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+	cq_map_len_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+	sqes_map_len_ = params.sq_entries * sizeof(io_uring_sqe);
+
+	const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+	if (single_mmap) {
+		sq_map_len_ = max(sq_map_len_, cq_map_len_);
+		cq_map_len_ = sq_map_len_;
+	}
+
+	sq_ptr_ = mmap(nullptr, sq_map_len_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	if (sq_ptr_ == MAP_FAILED) {
+		sq_ptr_ = nullptr;
+		close(fd);
+		return false;
+	}
+	if (single_mmap) {
+		cq_ptr_ = sq_ptr_;
+	} else {
+		cq_ptr_ = mmap(nullptr, cq_map_len_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+		if (cq_ptr_ == MAP_FAILED) {
+			cq_ptr_ = nullptr;
+			munmap(sq_ptr_, sq_map_len_);
+			sq_ptr_ = nullptr;
+			close(fd);
+			return false;
+		}
+	}
+	sqes_ptr_ = mmap(nullptr, sqes_map_len_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+	if (sqes_ptr_ == MAP_FAILED) {
+		sqes_ptr_ = nullptr;
+		if (cq_ptr_ != sq_ptr_) {
+			munmap(cq_ptr_, cq_map_len_);
+		}
+		munmap(sq_ptr_, sq_map_len_);
+		sq_ptr_ = nullptr;
+		cq_ptr_ = nullptr;
+		close(fd);
+		return false;
+	}
+
+	uint8_t* sq = (uint8_t*) sq_ptr_;
+	sq_head_ = (uint32_t*) (sq + params.sq_off.head);
+	sq_tail_ = (uint32_t*) (sq + params.sq_off.tail);
+	sq_mask_ = (uint32_t*) (sq + params.sq_off.ring_mask);
+	sq_array_ = (uint32_t*) (sq + params.sq_off.array);
+
+	uint8_t* cq = (uint8_t*) cq_ptr_;
+	cq_head_ = (uint32_t*) (cq + params.cq_off.head);
+	cq_tail_ = (uint32_t*) (cq + params.cq_off.tail);
+	cq_mask_ = (uint32_t*) (cq + params.cq_off.ring_mask);
+	cqes_ = cq + params.cq_off.cqes;
+
+	to_submit_ = 0;
+	in_flight_.store(0);
+	stopping_ = false;
+	ring_fd_.store(fd);
+
+	completion_thread_ = std::thread(&io_ring::CompletionMain, this);
+
+	return true;
+}
+
+void io_ring::WaitForSpace() {
+	if (!available() || std::this_thread::get_id() == completion_thread_.get_id()) {
+		in_flight_++; // Follow-up operations, while the one completing still holds its slot.
+		return;
+	}
+	std::unique_lock<std::mutex> lock(space_mutex_);
+	space_cv_.wait(lock, [this]() {
+		// Reserved here, so concurrent callers can't all pass the check at once.
+		uint32_t n = in_flight_.load();
+		while (n < cq_entries_) {
+			if (in_flight_.compare_exchange_weak(n, n + 1)) {
+				return true;
+			}
+		}
+		return false;
+	});
+}
+
+void io_ring::ReleaseSpace() {
+	in_flight_--;
+	{
+		std::lock_guard<std::mutex> lock(space_mutex_);
+	}
+	space_cv_.notify_all();
+}
+
+// Requires mutex_
+io_ring::io_ring_sqe_internal* io_ring::NextSqe(io_ring_request* req) {
+	uint32_t tail = available() ? *sq_tail_ : 0;
+	if (available() && tail - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) >= sq_entries_) {
+		SubmitLocked(); // Full, so hand the queued entries to the kernel first.
+	}
+	if (!available() || tail - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) >= sq_entries_) {
+		if (req != nullptr) {
+			ReleaseSpace(); // Reserved by WaitForSpace, but nothing was queued.
+		}
+		return nullptr;
+	}
+
+	const uint32_t index = tail & *sq_mask_;
+	io_ring_sqe_internal* entry = ((io_ring_sqe_internal*) sqes_ptr_) + index;
+	memset(entry, 0, sizeof(io_ring_sqe_internal));
+	entry->sqe.user_data = (uint64_t) (uintptr_t) req;
+
+	sq_array_[index] = index;
+	__atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+	to_submit_++;
+	return entry;
+}
+
+bool io_ring::queueOpenAt(io_ring_request* req, const char* path, const int flags, const mode_t mode) {
+	WaitForSpace();
+	std::lock_guard<std::mutex> lock(mutex_);
+	io_ring_sqe_internal* entry = NextSqe(req);
+	if (entry == nullptr) {
+		return false;
+	}
+	entry->sqe.opcode = IORING_OP_OPENAT;
+	entry->sqe.fd = AT_FDCWD;
+	entry->sqe.addr = (uint64_t) (uintptr_t) path;
+	entry->sqe.len = mode;
+	entry->sqe.open_flags = (uint32_t) flags;
+	return true;
+}
+
+bool io_ring::queueRead(io_ring_request* req, const int fd, void* buffer, const uint32_t len, const uint64_t offset) {
+	WaitForSpace();
+	std::lock_guard<std::mutex> lock(mutex_);
+	io_ring_sqe_internal* entry = NextSqe(req);
+	if (entry == nullptr) {
+		return false;
+	}
+	entry->sqe.opcode = IORING_OP_READ;
+	entry->sqe.fd = fd;
+	entry->sqe.addr = (uint64_t) (uintptr_t) buffer;
+	entry->sqe.len = len;
+	entry->sqe.off = offset;
+	return true;
+}
+
+bool io_ring::queueWrite(io_ring_request* req, const int fd, const void* buffer, const uint32_t len, const uint64_t offset) {
+	WaitForSpace();
+	std::lock_guard<std::mutex> lock(mutex_);
+	io_ring_sqe_internal* entry = NextSqe(req);
+	if (entry == nullptr) {
+		return false;
+	}
+	entry->sqe.opcode = IORING_OP_WRITE;
+	entry->sqe.fd = fd;
+	entry->sqe.addr = (uint64_t) (uintptr_t) buffer;
+	entry->sqe.len = len;
+	entry->sqe.off = offset;
+	return true;
+}
+
+bool io_ring::queueClose(io_ring_request* req, const int fd) {
+	WaitForSpace();
+	std::lock_guard<std::mutex> lock(mutex_);
+	io_ring_sqe_internal* entry = NextSqe(req);
+	if (entry == nullptr) {
+		return false;
+	}
+	entry->sqe.opcode = IORING_OP_CLOSE;
+	entry->sqe.fd = fd;
+	return true;
+}
+
+bool io_ring::queueStatx(io_ring_request* req, const char* path, const int flags, const uint32_t mask, struct statx* st) {
+	WaitForSpace();
+	std::lock_guard<std::mutex> lock(mutex_);
+	io_ring_sqe_internal* entry = NextSqe(req);
+	if (entry == nullptr) {
+		return false;
+	}
+	entry->sqe.opcode = IORING_OP_STATX;
+	entry->sqe.fd = AT_FDCWD;
+	entry->sqe.addr = (uint64_t) (uintptr_t) path;
+	entry->sqe.len = mask;
+	entry->sqe.off = (uint64_t) (uintptr_t) st;
+	entry->sqe.statx_flags = (uint32_t) flags;
+	return true;
+}
+
+bool io_ring::submit() {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return SubmitLocked();
+}
+
+// Requires mutex_
+bool io_ring::SubmitLocked() {
+	const int fd = ring_fd_.load();
+	while (fd >= 0 && to_submit_ > 0) {
+		const int submitted = sys_io_uring_enter(fd, to_submit_, 0, 0);
+		if (submitted < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			// EAGAIN/EBUSY: the completion thread resubmits whatever is left after draining.
+			if (errno != EAGAIN && errno != EBUSY) {
+				ARC_LOG_ERROR("io_ring", string("Submit failed: ") + strerror(errno));
+			}
+			return false;
+		}
+		to_submit_ -= (uint32_t) submitted;
+	}
+	return true;
+}
+
+void io_ring::CompletionMain() {
+	ARC_TRACE_THREAD_NAME("io_ring completions");
+	const int fd = ring_fd_.load();
+	const uint32_t mask = *cq_mask_;
+	bool stop_requested = false;
+
+	while (true) {
+		uint32_t head = *cq_head_;
+		const uint32_t tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+
+		if (head == tail) {
+			if (stop_requested && in_flight_.load() == 0) {
+				break;
+			}
+			bool leftover = false;
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				leftover = to_submit_ > 0;
+				if (leftover) {
+					SubmitLocked();
+				}
+			}
+			if (sys_io_uring_enter(fd, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+				ARC_LOG_ERROR("io_ring", string("Wait for completions failed: ") + strerror(errno));
+				break;
+			}
+			continue;
+		}
+
+		while (head != tail) {
+			const io_uring_cqe* cqe = ((const io_uring_cqe*) cqes_) + (head & mask);
+			io_ring_request* req = (io_ring_request*) (uintptr_t) cqe->user_data;
+			const int result = cqe->res;
+			head++;
+			__atomic_store_n(cq_head_, head, __ATOMIC_RELEASE); // Frees the slot before running the request.
+
+			if (req == nullptr) {
+				stop_requested = true; // From shutdown()
+				continue;
+			}
+
+			{
+				ARC_TRACE_SCOPE("io_ring complete");
+				req->complete(result);
+			}
+			ReleaseSpace(); // After, so any follow-up operations take this one's place.
+		}
+	}
+}
+
+void io_ring::shutdown() {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (!available() || stopping_) {
+			return;
+		}
+		stopping_ = true;
+		io_ring_sqe_internal* entry = NextSqe(nullptr);
+		if (entry != nullptr) {
+			entry->sqe.opcode = IORING_OP_NOP;
+		}
+		SubmitLocked();
+	}
+
+	if (completion_thread_.joinable()) {
+		completion_thread_.join();
+	}
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	munmap(sqes_ptr_, sqes_map_len_);
+	if (cq_ptr_ != sq_ptr_) {
+		munmap(cq_ptr_, cq_map_len_);
+	}
+	munmap(sq_ptr_, sq_map_len_);
+	sqes_ptr_ = nullptr;
+	cq_ptr_ = nullptr;
+	sq_ptr_ = nullptr;
+	close(ring_fd_.load());
+	ring_fd_.store(-1);
+}
+
+#else // Not Linux: io_uring is never available, so all callers use their fallback.
+
+struct io_ring::io_ring_sqe_internal {};
+
+bool io_ring::init(const unsigned int) { return false; }
+void io_ring::WaitForSpace() {}
+void io_ring::ReleaseSpace() {}
+io_ring::io_ring_sqe_internal* io_ring::NextSqe(io_ring_request*) { return nullptr; }
+bool io_ring::queueOpenAt(io_ring_request*, const char*, const int, const mode_t) { return false; }
+bool io_ring::queueRead(io_ring_request*, const int, void*, const uint32_t, const uint64_t) { return false; }
+bool io_ring::queueWrite(io_ring_request*, const int, const void*, const uint32_t, const uint64_t) { return false; }
+bool io_ring::queueClose(io_ring_request*, const int) { return false; }
+bool io_ring::queueStatx(io_ring_request*, const char*, const int, const uint32_t, struct statx*) { return false; }
+bool io_ring::submit() { return false; }
+bool io_ring::SubmitLocked() { return false; }
+void io_ring::CompletionMain() {}
+void io_ring::shutdown() {}
+
+#endif
+
+// Shared by the file/path modules, created on first use.
+io_ring* SharedIoRing() {
+	static io_ring ring;
+	static const bool available = ring.init();
+	return available ? &ring : nullptr;
+}
+
+} // namespace arc
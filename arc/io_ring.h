@@ -0,0 +1,99 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+#include "arc.h"
+
+#include <sys/types.h>
+
+struct statx;
+
+namespace arc {
+
+// Override complete() to receive the result of an io_ring operation.
+// The result is the syscall return value (>= 0) or -errno on failure.
+// Completion runs on the io_ring completion thread, and may queue follow-up operations.
+// As there is only one completion thread, complete() must be quick and must never wait on
+// another io_ring operation (which would deadlock).
+class io_ring_request {
+public:
+	virtual ~io_ring_request() {}
+
+	virtual void complete(const int result) = 0;
+};
+
+// Minimal io_uring submission/completion queue (Linux 5.6+), with a single completion thread.
+// All queue functions are thread safe, and only submit to the kernel on submit().
+// init() returns false when io_uring (or one of the needed operations) is not supported, so
+// callers should fall back to the thread pool.
+class io_ring {
+public:
+	io_ring() { ring_fd_.store(-1); in_flight_.store(0); }
+	~io_ring() { shutdown(); }
+
+	bool init(const unsigned int entries = 128);
+	bool available() const { return ring_fd_.load() >= 0; }
+
+	// The request must stay valid until complete() is called on it.
+	bool queueOpenAt(io_ring_request* req, const char* path, const int flags, const mode_t mode = 0);
+	bool queueRead(io_ring_request* req, const int fd, void* buffer, const uint32_t len, const uint64_t offset);
+	bool queueWrite(io_ring_request* req, const int fd, const void* buffer, const uint32_t len, const uint64_t offset);
+	bool queueClose(io_ring_request* req, const int fd);
+	bool queueStatx(io_ring_request* req, const char* path, const int flags, const uint32_t mask, struct statx* st);
+
+	// Submits all queued operations to the kernel.
+	bool submit();
+
+	void shutdown(); // Waits for all in-flight operations to complete.
+
+protected:
+	struct io_ring_sqe_internal;
+
+	// Reserves an in-flight operation, limited to the completion queue size. Must be called before
+	// NextSqe, which releases it if nothing was queued.
+	void WaitForSpace();
+	void ReleaseSpace();
+	io_ring_sqe_internal* NextSqe(io_ring_request* req); // Requires mutex_
+	bool SubmitLocked(); // Requires mutex_
+	void CompletionMain();
+
+	std::atomic<int> ring_fd_;
+	uint32_t sq_entries_ = 0;
+	uint32_t cq_entries_ = 0;
+
+	// Ring memory, all mmap'd from the kernel:
+	void* sq_ptr_ = nullptr;
+	void* cq_ptr_ = nullptr;
+	void* sqes_ptr_ = nullptr;
+	size_t sq_map_len_ = 0;
+	size_t cq_map_len_ = 0;
+	size_t sqes_map_len_ = 0;
+
+	uint32_t* sq_head_ = nullptr;
+	uint32_t* sq_tail_ = nullptr;
+	uint32_t* sq_mask_ = nullptr;
+	uint32_t* sq_array_ = nullptr;
+	uint32_t* cq_head_ = nullptr;
+	uint32_t* cq_tail_ = nullptr;
+	uint32_t* cq_mask_ = nullptr;
+	void* cqes_ = nullptr;
+
+	uint32_t to_submit_ = 0; // Queued but not yet submitted.
+	std::atomic<uint32_t> in_flight_; // Queued but not yet completed.
+	bool stopping_ = false;
+
+	std::mutex mutex_; // For the submission queue.
+	std::mutex space_mutex_;
+	std::condition_variable space_cv_;
+	std::thread completion_thread_;
+
+	DELETE_COPY_AND_ASSIGN(io_ring);
+};
+
+// Ring shared by the file and path modules, returns nullptr when io_uring is unavailable.
+io_ring* SharedIoRing();
+
+} // namespace arc
@@ -0,0 +1,473 @@
+#include "log.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <stdio.h>
+#include <string.h>
+
+namespace arc { namespace log {
+
+// Single producer (the owning thread), single consumer (whoever holds the backend's sink mutex).
+// Each record is: uint32_t length, uint8_t level, then the line itself.
+class LogBufferInternal {
+public:
+	static const uint64_t kSize = 1 << 16; // Power of 2
+	static const uint64_t kHeaderSize = 5;
+
+	bool tryPush(const int level, const char* line, const size_t len) {
+		const uint64_t tail = tail_.load(std::memory_order_relaxed);
+		const uint64_t head = head_.load(std::memory_order_acquire);
+		if (tail - head + kHeaderSize + len > kSize) {
+			return false; // Full
+		}
+		const uint32_t len32 = (uint32_t) len;
+		const uint8_t level8 = (uint8_t) level;
+		CopyIn(tail, &len32, 4);
+		CopyIn(tail + 4, &level8, 1);
+		CopyIn(tail + kHeaderSize, line, len);
+		tail_.store(tail + kHeaderSize + len, std::memory_order_release);
+		return true;
+	}
+
+	// Calls f(level, line, len) for each record, returns the number of records.
+	template<class Function>
+	size_t drain(Function&& f, std::string& scratch) {
+		uint64_t head = head_.load(std::memory_order_relaxed);
+		const uint64_t tail = tail_.load(std::memory_order_acquire);
+		size_t count = 0;
+		while (head < tail) {
+			uint32_t len32 = 0;
+			uint8_t level8 = 0;
+			CopyOut(head, &len32, 4);
+			CopyOut(head + 4, &level8, 1);
+			scratch.resize(len32);
+			CopyOut(head + kHeaderSize, &scratch[0], len32);
+			head += kHeaderSize + len32;
+			head_.store(head, std::memory_order_release); // Frees the space as soon as possible.
+			f((int) level8, scratch.data(), (size_t) len32);
+			count++;
+		}
+		return count;
+	}
+
+	bool empty() const { return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire); }
+
+	std::atomic<bool> owner_exited_{ false };
+	std::atomic<uint64_t> dropped_{ 0 };
+
+protected:
+	void CopyIn(const uint64_t pos, const void* src, const size_t len) {
+		const size_t start = (size_t) (pos & (kSize - 1));
+		const size_t first = len < kSize - start ? len : kSize - start;
+		memcpy(data_ + start, src, first);
+		memcpy(data_, (const char*) src + first, len - first);
+	}
+
+	void CopyOut(const uint64_t pos, void* dest, const size_t len) const {
+		const size_t start = (size_t) (pos & (kSize - 1));
+		const size_t first = len < kSize - start ? len : kSize - start;
+		memcpy(dest, data_ + start, first);
+		memcpy((char*) dest + first, data_, len - first);
+	}
+
+	std::atomic<uint64_t> head_{ 0 }; // Read position
+	std::atomic<uint64_t> tail_{ 0 }; // Write position
+	char data_[kSize];
+};
+
+// Marks the thread's buffer for removal once drained, when the thread exits.
+struct ThreadLogBufferInternal {
+	~ThreadLogBufferInternal() {
+		if (buffer) {
+			buffer->owner_exited_.store(true);
+		}
+	}
+
+	std::shared_ptr<LogBufferInternal> buffer;
+};
+
+static thread_local ThreadLogBufferInternal thread_log_buffer;
+
+class LogBackendInternal {
+public:
+	// Never deleted, so logging still works during static destruction. (Synchronously, after StopAtExit.)
+	static LogBackendInternal& Get() {
+		static LogBackendInternal* backend = new LogBackendInternal();
+		return *backend;
+	}
+
+	void Write(const int level, const char* line, const size_t len);
+
+	void AddSink(log_sink* sink);
+	void ClearSinks();
+	void SetAsync(const bool async) { async_.store(async); }
+	void Flush();
+
+	void AddLimiter(log_rate_limiter* limiter);
+	void RemoveLimiter(log_rate_limiter* limiter);
+	// Writes the pending summaries of the limiters idle since idle_since (see log_rate_limiter).
+	void FlushSuppressed(const std::chrono::steady_clock::time_point idle_since = std::chrono::steady_clock::time_point::max());
+
+protected:
+	LogBackendInternal();
+
+	static void StopAtExit();
+
+	LogBufferInternal* ThreadBuffer();
+	void StartWriter();
+	void WriterMain();
+	bool DrainLocked(); // Requires sink_mutex_, returns true if anything was written.
+	void WriteToSinksLocked(const int level, const char* line, const size_t len); // Requires sink_mutex_
+	void FlushSinksLocked(); // Requires sink_mutex_
+
+	std::mutex sink_mutex_; // For the sinks, and for draining the buffers.
+	std::vector<log_sink*> sinks_; // Owned
+	std::string scratch_;
+
+	std::mutex buffers_mutex_;
+	std::vector<std::shared_ptr<LogBufferInternal>> buffers_;
+
+	std::mutex limiters_mutex_; // Taken before sink_mutex_, never while holding it.
+	std::vector<log_rate_limiter*> limiters_; // NOT Owned
+
+	std::atomic<bool> async_{ true };
+	std::once_flag writer_once_;
+	std::mutex wake_mutex_;
+	std::condition_variable wake_cv_;
+	bool stopping_ = false;
+	std::thread writer_;
+
+	DELETE_COPY_AND_ASSIGN(LogBackendInternal);
+};
+
+LogBackendInternal::LogBackendInternal() {
+	sinks_.push_back(new stdout_log_sink());
+	atexit(StopAtExit);
+}
+
+// Writes everything still queued, then continues synchronously.
+void LogBackendInternal::StopAtExit() {
+	LogBackendInternal& backend = Get();
+	backend.FlushSuppressed();
+	backend.async_.store(false);
+	{
+		std::lock_guard<std::mutex> lock(backend.wake_mutex_);
+		backend.stopping_ = true;
+	}
+	backend.wake_cv_.notify_all();
+	if (backend.writer_.joinable()) {
+		backend.writer_.join();
+	}
+	backend.Flush();
+}
+
+LogBufferInternal* LogBackendInternal::ThreadBuffer() {
+	if (!thread_log_buffer.buffer) {
+		thread_log_buffer.buffer = std::make_shared<LogBufferInternal>();
+		std::lock_guard<std::mutex> lock(buffers_mutex_);
+		buffers_.push_back(thread_log_buffer.buffer);
+	}
+	return thread_log_buffer.buffer.get();
+}
+
+void LogBackendInternal::StartWriter() {
+	std::call_once(writer_once_, [this]() {
+		writer_ = std::thread(&LogBackendInternal::WriterMain, this);
+	});
+}
+
+void LogBackendInternal::Write(const int level, const char* line, const size_t len) {
+	if (!async_.load(std::memory_order_relaxed) || level >= ARC_LOG_LEVEL_FATAL) {
+		std::lock_guard<std::mutex> lock(sink_mutex_);
+		DrainLocked(); // So this stays in order after any queued lines.
+		WriteToSinksLocked(level, line, len);
+		FlushSinksLocked();
+		return;
+	}
+
+	StartWriter();
+	LogBufferInternal* buffer = ThreadBuffer();
+	if (!buffer->tryPush(level, line, len)) {
+		// Errors (and lines too long to ever fit) are never dropped, so write it here instead.
+		if (level >= ARC_LOG_LEVEL_ERROR || len + LogBufferInternal::kHeaderSize > LogBufferInternal::kSize) {
+			std::lock_guard<std::mutex> lock(sink_mutex_);
+			DrainLocked();
+			WriteToSinksLocked(level, line, len);
+		} else {
+			buffer->dropped_.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+	wake_cv_.notify_one();
+}
+
+void LogBackendInternal::WriterMain() {
+	std::chrono::steady_clock::time_point last_suppressed_check = std::chrono::steady_clock::now();
+	std::unique_lock<std::mutex> wake_lock(wake_mutex_);
+	while (!stopping_) {
+		// Notifies can be missed (as they are sent without the lock), so this also wakes periodically.
+		wake_cv_.wait_for(wake_lock, std::chrono::milliseconds(50));
+		wake_lock.unlock();
+		// Summaries for rate limited sites that went quiet, queued here and written below.
+		const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		if (now - last_suppressed_check >= std::chrono::seconds(1)) {
+			FlushSuppressed(now - std::chrono::seconds(1));
+			last_suppressed_check = now;
+		}
+		{
+			std::lock_guard<std::mutex> lock(sink_mutex_);
+			if (DrainLocked()) {
+				FlushSinksLocked();
+			}
+		}
+		wake_lock.lock();
+	}
+}
+
+bool LogBackendInternal::DrainLocked() {
+	size_t written = 0;
+	std::lock_guard<std::mutex> lock(buffers_mutex_);
+	for (size_t i = 0; i < buffers_.size();) {
+		LogBufferInternal& buffer = *buffers_[i];
+		written += buffer.drain([this](const int level, const char* line, const size_t len) {
+			WriteToSinksLocked(level, line, len);
+		}, scratch_);
+
+		const uint64_t dropped = buffer.dropped_.exchange(0, std::memory_order_relaxed);
+		if (dropped > 0) {
+			const std::string message = "Warning [log] " + std::to_string(dropped) + " log lines dropped (buffer full)\n";
+			WriteToSinksLocked(ARC_LOG_LEVEL_WARN, message.data(), message.size());
+			written++;
+		}
+
+		if (buffer.owner_exited_.load() && buffer.empty()) {
+			buffers_[i] = std::move(buffers_.back());
+			buffers_.pop_back();
+		} else {
+			i++;
+		}
+	}
+	return written > 0;
+}
+
+void LogBackendInternal::WriteToSinksLocked(const int level, const char* line, const size_t len) {
+	for (log_sink* sink : sinks_) {
+		if (level >= sink->min_level()) {
+			sink->write(line, len);
+		}
+	}
+}
+
+void LogBackendInternal::FlushSinksLocked() {
+	for (log_sink* sink : sinks_) {
+		sink->flush();
+	}
+}
+
+void LogBackendInternal::AddSink(log_sink* sink) {
+	std::lock_guard<std::mutex> lock(sink_mutex_);
+	sinks_.push_back(sink);
+}
+
+void LogBackendInternal::ClearSinks() {
+	std::lock_guard<std::mutex> lock(sink_mutex_);
+	DrainLocked(); // Queued lines still go to the old sinks.
+	FlushSinksLocked();
+	for (log_sink* sink : sinks_) {
+		delete sink;
+	}
+	sinks_.clear();
+}
+
+void LogBackendInternal::Flush() {
+	FlushSuppressed();
+	std::lock_guard<std::mutex> lock(sink_mutex_);
+	DrainLocked();
+	FlushSinksLocked();
+}
+
+void LogBackendInternal::AddLimiter(log_rate_limiter* limiter) {
+	std::lock_guard<std::mutex> lock(limiters_mutex_);
+	limiters_.push_back(limiter);
+}
+
+void LogBackendInternal::RemoveLimiter(log_rate_limiter* limiter) {
+	std::lock_guard<std::mutex> lock(limiters_mutex_);
+	for (size_t i = 0; i < limiters_.size(); i++) {
+		if (limiters_[i] == limiter) {
+			limiters_[i] = limiters_.back();
+			limiters_.pop_back();
+			return;
+		}
+	}
+}
+
+void LogBackendInternal::FlushSuppressed(const std::chrono::steady_clock::time_point idle_since) {
+	std::lock_guard<std::mutex> lock(limiters_mutex_);
+	for (log_rate_limiter* limiter : limiters_) {
+		limiter->flushSuppressed(idle_since);
+	}
+}
+
+void stdout_log_sink::write(const char* data, const size_t len) {
+	fwrite(data, 1, len, stdout);
+}
+
+void stdout_log_sink::flush() {
+	fflush(stdout);
+}
+
+file_log_sink::file_log_sink(const char* filename, const bool append, const int min_level) : log_sink(min_level) {
+	file_ = fopen(filename, append ? "ab" : "wb");
+	if (file_ == nullptr) {
+		perror("ERROR [log] Failed to open log file");
+	}
+}
+
+file_log_sink::~file_log_sink() {
+	if (file_ != nullptr) {
+		fclose(file_);
+	}
+}
+
+void file_log_sink::write(const char* data, const size_t len) {
+	if (file_ != nullptr) {
+		fwrite(data, 1, len, file_);
+	}
+}
+
+void file_log_sink::flush() {
+	if (file_ != nullptr) {
+		fflush(file_);
+	}
+}
+
+rotating_file_log_sink::rotating_file_log_sink(const char* filename, const size_t max_bytes, const uint32_t max_files, const int min_level)
+	: log_sink(min_level), filename_(filename), max_bytes_(max_bytes), max_files_(max_files) {
+	file_ = fopen(filename, "ab");
+	if (file_ == nullptr) {
+		perror("ERROR [log] Failed to open log file");
+		return;
+	}
+	fseek(file_, 0, SEEK_END);
+	const long size = ftell(file_);
+	size_ = size > 0 ? (size_t) size : 0;
+}
+
+rotating_file_log_sink::~rotating_file_log_sink() {
+	if (file_ != nullptr) {
+		fclose(file_);
+	}
+}
+
+void rotating_file_log_sink::Rotate() {
+	if (file_ != nullptr) {
+		fclose(file_);
+	}
+	if (max_files_ > 0) {
+		for (uint32_t i = max_files_ - 1; i > 0; i--) {
+			const std::string from = filename_ + "." + std::to_string(i);
+			const std::string to = filename_ + "." + std::to_string(i + 1);
+			rename(from.c_str(), to.c_str()); // Fails if it doesn't exist yet, which is fine.
+		}
+		rename(filename_.c_str(), (filename_ + ".1").c_str());
+	}
+	file_ = fopen(filename_.c_str(), "wb");
+	if (file_ == nullptr) {
+		perror("ERROR [log] Failed to open log file");
+	}
+	size_ = 0;
+}
+
+void rotating_file_log_sink::write(const char* data, const size_t len) {
+	if (size_ > 0 && size_ + len > max_bytes_) {
+		Rotate();
+	}
+	if (file_ != nullptr) {
+		fwrite(data, 1, len, file_);
+		size_ += len;
+	}
+}
+
+void rotating_file_log_sink::flush() {
+	if (file_ != nullptr) {
+		fflush(file_);
+	}
+}
+
+// Registering also creates the backend first, so its StopAtExit runs after this is destroyed.
+log_rate_limiter::log_rate_limiter(const int level, const char* file, const int line, const double per_second, const uint32_t burst)
+	: level_(level), file_(file), line_(line), per_second_(per_second), burst_(burst), tokens_(burst) {
+	LogBackendInternal::Get().AddLimiter(this);
+}
+
+log_rate_limiter::~log_rate_limiter() {
+	LogBackendInternal::Get().RemoveLimiter(this);
+	flushSuppressed();
+}
+
+bool log_rate_limiter::allow(uint64_t& suppressed) {
+	const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (started_) {
+		const double elapsed = std::chrono::duration<double>(now - last_).count();
+		tokens_ = min(burst_, tokens_ + elapsed * per_second_);
+	}
+	started_ = true;
+	last_ = now;
+
+	if (tokens_ < 1.0) {
+		suppressed_++;
+		return false;
+	}
+	tokens_ -= 1.0;
+	suppressed = suppressed_;
+	suppressed_ = 0;
+	return true;
+}
+
+void log_rate_limiter::flushSuppressed(const std::chrono::steady_clock::time_point idle_since) {
+	uint64_t suppressed = 0;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (suppressed_ == 0 || last_ > idle_since) {
+			return;
+		}
+		suppressed = suppressed_;
+		suppressed_ = 0;
+	}
+	WriteSuppressed(level_, file_, line_, suppressed);
+}
+
+void WriteSuppressed(const int level, const char* file, const int line, const uint64_t suppressed) {
+	const char* filename = strrchr(file, '/');
+	filename = filename == nullptr ? file : filename + 1;
+	WriteLevel(level, "log", "Suppressed " + std::to_string(suppressed) + " similar lines from " + filename + ":" + std::to_string(line));
+}
+
+void AddSink(log_sink* sink) {
+	LogBackendInternal::Get().AddSink(sink);
+}
+
+void ClearSinks() {
+	LogBackendInternal::Get().ClearSinks();
+}
+
+void SetAsync(const bool async) {
+	LogBackendInternal::Get().SetAsync(async);
+}
+
+void Flush() {
+	LogBackendInternal::Get().Flush();
+}
+
+void Write(const int level, const char* line, const size_t len) {
+	LogBackendInternal::Get().Write(level, line, len);
+}
+
+} } // namespace arc::log
@@ -1,74 +1,287 @@
 #pragma once
 
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <string>
+
 #include "arc.h"
 #include "string.h"
 
+// Levels below ARC_LOG_MIN_LEVEL are compiled out. (Fatal is always logged.)
+#define ARC_LOG_LEVEL_INFO 0
+#define ARC_LOG_LEVEL_WARN 1
+#define ARC_LOG_LEVEL_ERROR 2
+#define ARC_LOG_LEVEL_FATAL 3
+
+#ifndef ARC_LOG_MIN_LEVEL
+	#define ARC_LOG_MIN_LEVEL ARC_LOG_LEVEL_INFO
+#endif
+
+// Same as log::Info/Warn/Error, but when compiled out the arguments are not evaluated either.
+#if ARC_LOG_MIN_LEVEL <= ARC_LOG_LEVEL_INFO
+	#define ARC_LOG_INFO(...) ::arc::log::Info(__VA_ARGS__)
+#else
+	#define ARC_LOG_INFO(...) ((void) 0)
+#endif
+#if ARC_LOG_MIN_LEVEL <= ARC_LOG_LEVEL_WARN
+	#define ARC_LOG_WARN(...) ::arc::log::Warn(__VA_ARGS__)
+#else
+	#define ARC_LOG_WARN(...) ((void) 0)
+#endif
+#if ARC_LOG_MIN_LEVEL <= ARC_LOG_LEVEL_ERROR
+	#define ARC_LOG_ERROR(...) ::arc::log::Error(__VA_ARGS__)
+#else
+	#define ARC_LOG_ERROR(...) ((void) 0)
+#endif
+
+// Rate limited logging, keyed by call site: each site may log a burst of lines at once, and then
+// only per_second lines per second. The next line logged after any were suppressed is preceded by
+// a summary with the number of lines suppressed. (If the site goes quiet instead, the summary is
+// written about a second later, or by log::Flush or at exit.)
+// Levels below ARC_LOG_MIN_LEVEL are compiled out.
+#define ARC_LOG_RATE_LIMITED(level, per_second, burst, ...) do { \
+		if (!::arc::log::LevelEnabled(level)) break; \
+		static ::arc::log::log_rate_limiter arc_log_limiter_(level, __FILE__, __LINE__, per_second, burst); \
+		uint64_t arc_log_suppressed_ = 0; \
+		if (arc_log_limiter_.allow(arc_log_suppressed_)) { \
+			if (arc_log_suppressed_ > 0) { \
+				::arc::log::WriteSuppressed(level, __FILE__, __LINE__, arc_log_suppressed_); \
+			} \
+			::arc::log::WriteLevel(level, __VA_ARGS__); \
+		} \
+	} while (0)
+
+// Defaults: Bursts of up to 5 lines, then 1 line per second.
+#if ARC_LOG_MIN_LEVEL <= ARC_LOG_LEVEL_INFO
+	#define ARC_LOG_INFO_LIMITED(...) ARC_LOG_RATE_LIMITED(ARC_LOG_LEVEL_INFO, 1.0, 5, __VA_ARGS__)
+#else
+	#define ARC_LOG_INFO_LIMITED(...) ((void) 0)
+#endif
+#if ARC_LOG_MIN_LEVEL <= ARC_LOG_LEVEL_WARN
+	#define ARC_LOG_WARN_LIMITED(...) ARC_LOG_RATE_LIMITED(ARC_LOG_LEVEL_WARN, 1.0, 5, __VA_ARGS__)
+#else
+	#define ARC_LOG_WARN_LIMITED(...) ((void) 0)
+#endif
+#if ARC_LOG_MIN_LEVEL <= ARC_LOG_LEVEL_ERROR
+	#define ARC_LOG_ERROR_LIMITED(...) ARC_LOG_RATE_LIMITED(ARC_LOG_LEVEL_ERROR, 1.0, 5, __VA_ARGS__)
+#else
+	#define ARC_LOG_ERROR_LIMITED(...) ((void) 0)
+#endif
+
 namespace arc { namespace log {
 
-// TODO: Allow for redirecting to a logfile, etc.
-/*
-class LogModule {
+// Constant, so checks of this are compiled out.
+constexpr bool LevelEnabled(const int level) {
+	return level >= ARC_LOG_MIN_LEVEL || level >= ARC_LOG_LEVEL_FATAL;
+}
+
+// Log lines are queued in a per-thread lock-free buffer, and written to all of the sinks by a
+// background thread, so logging never waits on terminal/file I/O. (Unless SetAsync(false))
+// Each sink receives complete lines, in order per thread.
+class log_sink {
+public:
+	explicit log_sink(const int min_level = ARC_LOG_LEVEL_INFO) : min_level_(min_level) {}
+	virtual ~log_sink() {}
+
+	int min_level() const { return min_level_; }
+
+	virtual void write(const char* data, const size_t len) = 0;
+	virtual void flush() {}
+
+protected:
+	const int min_level_;
+};
+
+class stdout_log_sink : public log_sink {
+public:
+	explicit stdout_log_sink(const int min_level = ARC_LOG_LEVEL_INFO) : log_sink(min_level) {}
+
+	void write(const char* data, const size_t len) override;
+	void flush() override;
+};
+
+// Appends to the file (or truncates it first if append is false).
+class file_log_sink : public log_sink {
+public:
+	file_log_sink(const char* filename, const bool append = true, const int min_level = ARC_LOG_LEVEL_INFO);
+	~file_log_sink();
+
+	void write(const char* data, const size_t len) override;
+	void flush() override;
+
+protected:
+	// Owned:
+	FILE* file_ = nullptr;
+
+	DELETE_COPY_AND_ASSIGN(file_log_sink);
+};
+
+// Once the file reaches max_bytes it is renamed to filename.1 (and filename.1 to filename.2, etc.),
+// keeping at most max_files old files.
+class rotating_file_log_sink : public log_sink {
+public:
+	rotating_file_log_sink(const char* filename, const size_t max_bytes, const uint32_t max_files = 3,
+		const int min_level = ARC_LOG_LEVEL_INFO);
+	~rotating_file_log_sink();
+
+	void write(const char* data, const size_t len) override;
+	void flush() override;
+
+protected:
+	void Rotate();
+
+	std::string filename_;
+	const size_t max_bytes_;
+	const uint32_t max_files_;
+	size_t size_ = 0;
+
+	// Owned:
+	FILE* file_ = nullptr;
+
+	DELETE_COPY_AND_ASSIGN(rotating_file_log_sink);
+};
+
+// Takes ownership of the sink. By default there is only a stdout sink.
+void AddSink(log_sink* sink);
+void ClearSinks(); // Including the default stdout sink.
+
+// When false, lines are written on the calling thread (under a lock) before returning.
+void SetAsync(const bool async = true);
+
+// Waits until all lines logged so far (from all threads) are written and flushed, including the
+// summaries of any rate limited lines suppressed so far.
+void Flush();
+
+// Used by all of the functions below.
+void Write(const int level, const char* line, const size_t len);
+
+// Token bucket for ARC_LOG_RATE_LIMITED, thread safe.
+// Registered with the logger while it exists, so pending summaries are not lost.
+class log_rate_limiter {
 public:
-	LogModule() {}
-*/
+	log_rate_limiter(const int level, const char* file, const int line, const double per_second, const uint32_t burst);
+	~log_rate_limiter(); // Writes any pending summary.
+
+	// Returns true if the line should be logged, and then sets suppressed to the number of lines
+	// suppressed since the last one logged.
+	bool allow(uint64_t& suppressed);
+
+	// Writes the summary of the lines suppressed since the last one logged (if any), but only if
+	// nothing was logged (or suppressed) from this site since idle_since.
+	void flushSuppressed(const std::chrono::steady_clock::time_point idle_since = std::chrono::steady_clock::time_point::max());
+
+protected:
+	const int level_;
+	const char* const file_;
+	const int line_;
+	const double per_second_;
+	const double burst_;
+
+	std::mutex mutex_; // For everything below.
+	double tokens_;
+	uint64_t suppressed_ = 0;
+	bool started_ = false;
+	std::chrono::steady_clock::time_point last_;
+
+	DELETE_COPY_AND_ASSIGN(log_rate_limiter);
+};
+
+void WriteSuppressed(const int level, const char* file, const int line, const uint64_t suppressed);
+
+inline void AppendText(std::string& line, const char* str) { line.append(str); }
+inline void AppendText(std::string& line, const unsigned char* str) { line.append((const char*) str); }
+inline void AppendText(std::string& line, const char c) { line.push_back(c); }
+inline void AppendText(std::string& line, const unsigned char c) { line.push_back((char) c); }
+inline void AppendText(std::string& line, const string& str) { line.append((const char*) str.data(), str.len()); }
+inline void AppendText(std::string& line, const std::string& str) { line.append(str); }
+
+template<typename T1, typename T2>
+void WriteLine(const int level, const char* prefix, const T1& class_func_name, const T2& message) {
+	std::string line(prefix);
+	AppendText(line, class_func_name);
+	line.append("] ");
+	AppendText(line, message);
+	line.push_back('\n');
+	Write(level, line.data(), line.size());
+}
+
+template<typename T>
+void WriteLine(const int level, const char* prefix, const T& message) {
+	std::string line(prefix);
+	AppendText(line, message);
+	line.push_back('\n');
+	Write(level, line.data(), line.size());
+}
+
+template<typename T1, typename T2>
+void WriteLevel(const int level, const T1& class_func_name, const T2& message) {
+	if (!LevelEnabled(level)) return;
+	static const char* const prefixes[] = { "[", "Warning [", "ERROR [", "FATAL ERROR [" };
+	WriteLine(level, prefixes[level], class_func_name, message);
+}
+
+template<typename T>
+void WriteLevel(const int level, const T& message) {
+	if (!LevelEnabled(level)) return;
+	static const char* const prefixes[] = { "", "Warning: ", "ERROR: ", "FATAL ERROR: " };
+	WriteLine(level, prefixes[level], message);
+}
 
 template<typename T1, typename T2>
 void Info(const T1& class_func_name, const T2& message) {
-	arc::print('[');
-	arc::print(class_func_name);
-	arc::print("] ");
-	arc::println(message);
+	if (ARC_LOG_MIN_LEVEL <= ARC_LOG_LEVEL_INFO) {
+		WriteLine(ARC_LOG_LEVEL_INFO, "[", class_func_name, message);
+	}
 }
 
 template<typename T1, typename T2>
 void Warn(const T1& class_func_name, const T2& message) {
-	arc::print("Warning [");
-	arc::print(class_func_name);
-	arc::print("] ");
-	arc::println(message);
+	if (ARC_LOG_MIN_LEVEL <= ARC_LOG_LEVEL_WARN) {
+		WriteLine(ARC_LOG_LEVEL_WARN, "Warning [", class_func_name, message);
+	}
 }
 
 template<typename T1, typename T2>
 void Error(const T1& class_func_name, const T2& message) {
-	arc::print("ERROR [");
-	arc::print(class_func_name);
-	arc::print("] ");
-	arc::println(message);
+	if (ARC_LOG_MIN_LEVEL <= ARC_LOG_LEVEL_ERROR) {
+		WriteLine(ARC_LOG_LEVEL_ERROR, "ERROR [", class_func_name, message);
+	}
 }
 
 template<typename T1, typename T2>
 void Fatal(const T1& class_func_name, const T2& message) {
-	arc::print("FATAL ERROR [");
-	arc::print(class_func_name);
-	arc::print("] ");
-	arc::println(message);
+	WriteLine(ARC_LOG_LEVEL_FATAL, "FATAL ERROR [", class_func_name, message);
+	Flush();
 	exit(1);
 }
 
 template<typename T>
 void Info(const T& message) {
-	arc::println(message);
+	if (ARC_LOG_MIN_LEVEL <= ARC_LOG_LEVEL_INFO) {
+		WriteLine(ARC_LOG_LEVEL_INFO, "", message);
+	}
 }
 
 template<typename T>
 void Warn(const T& message) {
-	arc::print("Warning: ");
-	arc::println(message);
+	if (ARC_LOG_MIN_LEVEL <= ARC_LOG_LEVEL_WARN) {
+		WriteLine(ARC_LOG_LEVEL_WARN, "Warning: ", message);
+	}
 }
 
 template<typename T>
 void Error(const T& message) {
-	arc::print("ERROR: ");
-	arc::println(message);
+	if (ARC_LOG_MIN_LEVEL <= ARC_LOG_LEVEL_ERROR) {
+		WriteLine(ARC_LOG_LEVEL_ERROR, "ERROR: ", message);
+	}
 }
 
 template<typename T>
 void Fatal(const T& message) {
-	arc::print("FATAL ERROR: ");
-	arc::println(message);
+	WriteLine(ARC_LOG_LEVEL_FATAL, "FATAL ERROR: ", message);
+	Flush();
 	exit(1);
 }
 
-//} log;
-
 } } // namespace arc::log
@@ -1,5 +1,13 @@
 #include "path.h"
 
+#include "io_ring.h"
+
+#include <condition_variable>
+#include <vector>
+
+#include <errno.h>
+#include <fcntl.h>
+
 #ifdef _WIN32
 	#error "Windows directory/stat not implemented."
 	#include <direct.h>
@@ -104,6 +112,7 @@ bool PathModule::CD(const char* path) {
 		return false;
 	}
 	working_dir_ = path;
+	InvalidateStatCache(); // Relative paths now refer to different files.
 	return true;
 }
 
@@ -114,6 +123,7 @@ bool PathModule::CD(const string& path) {
 		return false;
 	}
 	working_dir_ = new_working_dir;
+	InvalidateStatCache(); // Relative paths now refer to different files.
 	return true;
 }
 
@@ -141,50 +151,244 @@ const string& PathModule::CurrentWorkingDir() {
 
 // Note that this also returns false if inaccessible.
 bool PathModule::Exists(const string& path) {
+	return Stat(path).exists;
+}
+
+// Note that this also returns false if inaccessible.
+bool PathModule::IsDir(const string& path) {
+	return Stat(path).is_dir;
+}
+
+// Note that this also returns false if inaccessible.
+bool PathModule::IsFile(const string& path) {
+	return Stat(path).is_file;
+}
+
+static void PrintStatError(const int error) {
+	if (error != 0 && error != ENOENT && error != ENOTDIR) {
+		errno = error;
+		perror("ERROR [PathModule] Failed to stat path");
+	}
+}
+
+static PathStat StatInternal(const char* path) {
+	PathStat result;
 	struct stat st;
 	errno = 0;
-	string cpath(path);
 
-	if (stat(cpath.c_str(), &st) == -1) {
-		if (errno != ENOENT && errno != ENOTDIR) {
-			perror("ERROR [PathModule] Failed to stat path");
-		}
-		return false;
+	if (stat(path, &st) == -1) {
+		result.error = errno;
+		PrintStatError(result.error);
+		return result;
 	}
 
-	return true;
+	result.exists = true;
+	result.is_dir = S_ISDIR(st.st_mode);
+	result.is_file = S_ISREG(st.st_mode);
+	result.size = st.st_size;
+	result.modified_time = st.st_mtime;
+	return result;
 }
 
-// Note that this also returns false if inaccessible.
-bool PathModule::IsDir(const string& path) {
-	struct stat st;
-	errno = 0;
-	string cpath(path);
+PathStat PathModule::Stat(const string& path) {
+	const std::string cpath((const char*) path.data(), path.len());
 
-	if (stat(cpath.c_str(), &st) == -1) {
-		if (errno != ENOENT && errno != ENOTDIR) {
-			perror("ERROR [DirModule] Failed to stat path");
-		}
-		return false;
+	const uint64_t generation = StatCacheGeneration();
+	PathStat result;
+	if (StatCacheLookup(cpath, result)) {
+		return result;
 	}
 
-	return S_ISDIR(st.st_mode);
+	result = StatInternal(cpath.c_str());
+	StatCacheStore(cpath, result, generation);
+	return result;
 }
 
-// Note that this also returns false if inaccessible.
-bool PathModule::IsFile(const string& path) {
-	struct stat st;
-	errno = 0;
-	string cpath(path);
+#if defined(__linux__) && defined(STATX_TYPE)
+// Shared by all statx requests of one StatMany call, which waits until remaining is 0.
+struct StatBatchInternal {
+	std::mutex mutex;
+	std::condition_variable done_cv;
+	size_t remaining = 0;
+};
+
+class StatxRequest : public io_ring_request {
+public:
+	void complete(const int result) override {
+		result_ = result;
+		std::lock_guard<std::mutex> lock(batch_->mutex);
+		batch_->remaining--;
+		if (batch_->remaining == 0) {
+			batch_->done_cv.notify_all();
+		}
+	}
+
+	PathStat ToPathStat() const {
+		PathStat result;
+		if (result_ < 0) {
+			result.error = -result_;
+			return result;
+		}
+		result.exists = true;
+		result.is_dir = S_ISDIR(stx_.stx_mode);
+		result.is_file = S_ISREG(stx_.stx_mode);
+		result.size = stx_.stx_size;
+		result.modified_time = stx_.stx_mtime.tv_sec;
+		return result;
+	}
+
+	// NOT Owned:
+	StatBatchInternal* batch_ = nullptr;
+
+	struct statx stx_;
+	int result_ = 0;
+};
+#endif
+
+array<PathStat> PathModule::StatMany(const array<string>& paths) {
+	const size_t count = paths.len();
+	std::vector<std::string> cpaths(count);
+	std::vector<PathStat> results(count);
+	std::vector<size_t> misses; // Indexes not found in the cache, only the first of each path.
+	misses.reserve(count);
+	std::vector<std::pair<size_t, size_t>> duplicates; // Index, and the first index of the same path.
+	std::unordered_map<std::string, size_t> first_index;
+	const uint64_t generation = StatCacheGeneration();
+
+	for (size_t i = 0; i < count; i++) {
+		cpaths[i].assign((const char*) paths[i].data(), paths[i].len());
+		auto inserted = first_index.emplace(cpaths[i], i);
+		if (!inserted.second) {
+			duplicates.push_back(std::make_pair(i, inserted.first->second));
+			continue;
+		}
+		if (!StatCacheLookup(cpaths[i], results[i])) {
+			misses.push_back(i);
+		}
+	}
+
+	size_t next = 0; // First miss not handled by io_uring.
+#if defined(__linux__) && defined(STATX_TYPE)
+	io_ring* ring = SharedIoRing();
+	if (ring != nullptr && misses.size() > 1) {
+		StatBatchInternal batch;
+		std::vector<StatxRequest> requests(misses.size());
+		for (; next < misses.size(); next++) {
+			StatxRequest& req = requests[next];
+			req.batch_ = &batch;
+			{
+				std::lock_guard<std::mutex> lock(batch.mutex);
+				batch.remaining++;
+			}
+			if (!ring->queueStatx(&req, cpaths[misses[next]].c_str(), AT_STATX_SYNC_AS_STAT,
+				STATX_TYPE | STATX_MODE | STATX_SIZE | STATX_MTIME, &req.stx_)) {
+				std::lock_guard<std::mutex> lock(batch.mutex);
+				batch.remaining--;
+				break; // The rest are stat'd below.
+			}
+		}
+		ring->submit();
+
+		{
+			std::unique_lock<std::mutex> lock(batch.mutex);
+			batch.done_cv.wait(lock, [&batch]() { return batch.remaining == 0; });
+		}
 
-	if (stat(cpath.c_str(), &st) == -1) {
-		if (errno != ENOENT && errno != ENOTDIR) {
-			perror("ERROR [DirModule] Failed to stat path");
+		for (size_t m = 0; m < next; m++) {
+			const size_t i = misses[m];
+			results[i] = requests[m].ToPathStat();
+			PrintStatError(results[i].error);
+			StatCacheStore(cpaths[i], results[i], generation);
 		}
+	}
+#endif
+
+	for (; next < misses.size(); next++) {
+		const size_t i = misses[next];
+		results[i] = StatInternal(cpaths[i].c_str());
+		StatCacheStore(cpaths[i], results[i], generation);
+	}
+
+	for (const std::pair<size_t, size_t>& duplicate : duplicates) {
+		results[duplicate.first] = results[duplicate.second];
+	}
+
+	array<PathStat> stats;
+	stats.reserve(count);
+	for (size_t i = 0; i < count; i++) {
+		stats.append(results[i]);
+	}
+	return stats;
+}
+
+void PathModule::EnableStatCache(const uint32_t ttl_ms) {
+	std::lock_guard<std::mutex> lock(stat_cache_mutex_);
+	stat_cache_ttl_ = std::chrono::milliseconds(ttl_ms);
+	stat_cache_enabled_.store(true);
+}
+
+void PathModule::DisableStatCache() {
+	std::lock_guard<std::mutex> lock(stat_cache_mutex_);
+	stat_cache_enabled_.store(false);
+	stat_cache_.clear();
+	stat_cache_generation_++;
+}
+
+void PathModule::InvalidateStatCache() {
+	if (!stat_cache_enabled_.load()) {
+		return;
+	}
+	std::lock_guard<std::mutex> lock(stat_cache_mutex_);
+	stat_cache_.clear();
+	stat_cache_generation_++;
+}
+
+void PathModule::InvalidateStatCache(const string& path) {
+	if (!stat_cache_enabled_.load()) {
+		return;
+	}
+	std::lock_guard<std::mutex> lock(stat_cache_mutex_);
+	stat_cache_.erase(std::string((const char*) path.data(), path.len()));
+	stat_cache_generation_++;
+}
+
+uint64_t PathModule::StatCacheGeneration() {
+	if (!stat_cache_enabled_.load()) {
+		return 0;
+	}
+	std::lock_guard<std::mutex> lock(stat_cache_mutex_);
+	return stat_cache_generation_;
+}
+
+bool PathModule::StatCacheLookup(const std::string& path, PathStat& result) {
+	if (!stat_cache_enabled_.load()) {
 		return false;
 	}
+	std::lock_guard<std::mutex> lock(stat_cache_mutex_);
+	auto it = stat_cache_.find(path);
+	if (it == stat_cache_.end()) {
+		return false;
+	}
+	if (stat_cache_ttl_.count() > 0 && std::chrono::steady_clock::now() >= it->second.expires) {
+		stat_cache_.erase(it);
+		return false;
+	}
+	result = it->second.stat;
+	return true;
+}
 
-	return S_ISREG(st.st_mode);
+void PathModule::StatCacheStore(const std::string& path, const PathStat& result, const uint64_t generation) {
+	if (!stat_cache_enabled_.load()) {
+		return;
+	}
+	std::lock_guard<std::mutex> lock(stat_cache_mutex_);
+	if (result.error != 0 && result.error != ENOENT && result.error != ENOTDIR) {
+		return; // Don't cache unexpected failures (e.g. EMFILE/EIO), only the normal results.
+	}
+	if (generation != stat_cache_generation_) {
+		return; // Invalidated while this was being stat'd, so it may already be out of date.
+	}
+	stat_cache_[path] = CachedStat{ result, std::chrono::steady_clock::now() + stat_cache_ttl_ };
 }
 
 } // namespace arc
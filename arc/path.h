@@ -1,5 +1,11 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
 #include "string.h"
 
 #ifdef _WIN32
@@ -14,6 +20,15 @@
 
 namespace arc {
 
+struct PathStat {
+	bool exists = false;
+	bool is_dir = false;
+	bool is_file = false;
+	uint64_t size = 0;
+	int64_t modified_time = 0; // Seconds since the epoch.
+	int error = 0; // The errno when the stat failed (exists is false).
+};
+
 class PathModule {
 public:
 	PathModule() {}
@@ -45,13 +60,42 @@ public:
 	bool IsDir(const string& path);
 	bool IsFile(const string& path);
 
+	PathStat Stat(const string& path);
+	// Stats all of the paths as one batch (statx through io_uring when available), in the same order.
+	array<PathStat> StatMany(const array<string>& paths);
+
+	// Optional cache of stat results, used by all of the above (and so also FileModule::Exists).
+	// Entries expire after ttl_ms (0 to never expire). Changes made through the file/dir/path
+	// modules invalidate the changed paths, but other changes are only seen once the entry expires
+	// or is invalidated. Entries are keyed by the path as given, so invalidate each form used.
+	void EnableStatCache(const uint32_t ttl_ms = 1000);
+	void DisableStatCache(); // Also clears the cache.
+	void InvalidateStatCache(); // All paths.
+	void InvalidateStatCache(const string& path);
+
 	static constexpr unsigned char const PathSeparator = ARC_PATH_SEP_CHAR;
 
 private:
 	void InternalJoin(string& joined, const string& to_join) const;
 
+	struct CachedStat {
+		PathStat stat;
+		std::chrono::steady_clock::time_point expires;
+	};
+
+	// Read before stat'ing, so a result is not stored if the cache was invalidated since.
+	uint64_t StatCacheGeneration();
+	bool StatCacheLookup(const std::string& path, PathStat& result);
+	void StatCacheStore(const std::string& path, const PathStat& result, const uint64_t generation);
+
 	string working_dir_;
 
+	std::atomic<bool> stat_cache_enabled_{ false };
+	std::chrono::steady_clock::duration stat_cache_ttl_{ 0 };
+	std::unordered_map<std::string, CachedStat> stat_cache_;
+	uint64_t stat_cache_generation_ = 0; // Incremented by every invalidation.
+	std::mutex stat_cache_mutex_; // For all of the above.
+
 	DELETE_COPY_AND_ASSIGN(PathModule);
 } path;
 
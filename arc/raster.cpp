@@ -0,0 +1,833 @@
+#include "raster.h"
+
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+	#define ARC_RASTER_X86 1
+	#include <emmintrin.h>
+	#include <immintrin.h>
+	#if defined(__GNUC__) || defined(__clang__)
+		#define ARC_TARGET_AVX2 __attribute__((target("avx2")))
+	#else
+		#define ARC_TARGET_AVX2
+	#endif
+#endif
+
+namespace arc { namespace raster {
+
+//
+// Scalar kernels
+//
+
+// x / 255, rounded, exact for 0 <= x <= 255 * 255. (Same as the SIMD kernels.)
+inline uint32_t div255(uint32_t x) {
+	x += 128;
+	return (x + (x >> 8)) >> 8;
+}
+
+inline uint32_t blend_pixel(const uint32_t dst, const uint32_t src) {
+	const uint32_t a = src >> 24;
+	const uint32_t ia = 255 - a;
+	const uint32_t b = div255((src & 0xFF) * a + (dst & 0xFF) * ia);
+	const uint32_t g = div255(((src >> 8) & 0xFF) * a + ((dst >> 8) & 0xFF) * ia);
+	const uint32_t r = div255(((src >> 16) & 0xFF) * a + ((dst >> 16) & 0xFF) * ia);
+	const uint32_t out_a = div255(255 * a + (dst >> 24) * ia);
+	return (out_a << 24) | (r << 16) | (g << 8) | b;
+}
+
+inline uint32_t premultiplied_pixel(const uint32_t dst, const uint32_t src) {
+	const uint32_t ia = 255 - (src >> 24);
+	uint32_t out = 0;
+	for (uint32_t shift = 0; shift < 32; shift += 8) {
+		uint32_t c = ((src >> shift) & 0xFF) + div255(((dst >> shift) & 0xFF) * ia);
+		if (c > 255) {
+			c = 255;
+		}
+		out |= c << shift;
+	}
+	return out;
+}
+
+void scalar_fill(uint32_t* dst, size_t n, const uint32_t pixel) {
+	for (size_t i = 0; i < n; i++) {
+		dst[i] = pixel;
+	}
+}
+
+void scalar_blend_fill(uint32_t* dst, size_t n, const uint32_t pixel) {
+	for (size_t i = 0; i < n; i++) {
+		dst[i] = blend_pixel(dst[i], pixel);
+	}
+}
+
+void scalar_blend(uint32_t* dst, const uint32_t* src, size_t n) {
+	for (size_t i = 0; i < n; i++) {
+		dst[i] = blend_pixel(dst[i], src[i]);
+	}
+}
+
+void scalar_premultiplied(uint32_t* dst, const uint32_t* src, size_t n) {
+	for (size_t i = 0; i < n; i++) {
+		dst[i] = premultiplied_pixel(dst[i], src[i]);
+	}
+}
+
+// Format conversions (src and dst may be the same):
+
+void scalar_swap_rb(uint32_t* dst, const uint32_t* src, size_t n) { // ARGB <-> ABGR
+	for (size_t i = 0; i < n; i++) {
+		const uint32_t p = src[i];
+		dst[i] = (p & 0xFF00FF00) | ((p >> 16) & 0xFF) | ((p & 0xFF) << 16);
+	}
+}
+
+void scalar_rotl8(uint32_t* dst, const uint32_t* src, size_t n) { // ARGB -> RGBA
+	for (size_t i = 0; i < n; i++) {
+		dst[i] = (src[i] << 8) | (src[i] >> 24);
+	}
+}
+
+void scalar_rotr8(uint32_t* dst, const uint32_t* src, size_t n) { // RGBA -> ARGB
+	for (size_t i = 0; i < n; i++) {
+		dst[i] = (src[i] >> 8) | (src[i] << 24);
+	}
+}
+
+void scalar_to_rgb565(uint16_t* dst, const uint32_t* src, size_t n) { // ARGB -> RGB565
+	for (size_t i = 0; i < n; i++) {
+		const uint32_t p = src[i];
+		dst[i] = (uint16_t) (((p >> 8) & 0xF800) | ((p >> 5) & 0x07E0) | ((p >> 3) & 0x001F));
+	}
+}
+
+// The bits are repeated, so 0 stays 0, and the maximum becomes 255.
+void scalar_from_rgb565(uint32_t* dst, const uint16_t* src, size_t n) { // RGB565 -> ARGB (opaque)
+	for (size_t i = 0; i < n; i++) {
+		const uint32_t p = src[i];
+		const uint32_t r = ((p >> 8) & 0xF8) | (p >> 13);
+		const uint32_t g = ((p >> 3) & 0xFC) | ((p >> 9) & 0x03);
+		const uint32_t b = ((p << 3) & 0xF8) | ((p >> 2) & 0x07);
+		dst[i] = 0xFF000000 | (r << 16) | (g << 8) | b;
+	}
+}
+
+void scalar_premultiply(uint32_t* p, size_t n) { // ARGB, colors * alpha
+	for (size_t i = 0; i < n; i++) {
+		const uint32_t a = p[i] >> 24;
+		p[i] = (a << 24) | (div255(((p[i] >> 16) & 0xFF) * a) << 16) | (div255(((p[i] >> 8) & 0xFF) * a) << 8)
+			| div255((p[i] & 0xFF) * a);
+	}
+}
+
+// Rounded, the same as the SIMD kernels (where this is done with float division, which is exact here).
+inline uint32_t unpremultiply_channel(const uint32_t c, const uint32_t a) {
+	const uint32_t v = (c * 255 + (a >> 1)) / a;
+	return v > 255 ? 255 : v;
+}
+
+void scalar_unpremultiply(uint32_t* p, size_t n) { // ARGB, colors / alpha (and 0 if alpha is 0)
+	for (size_t i = 0; i < n; i++) {
+		const uint32_t a = p[i] >> 24;
+		if (a == 0) {
+			p[i] = 0;
+			continue;
+		}
+		p[i] = (a << 24) | (unpremultiply_channel((p[i] >> 16) & 0xFF, a) << 16)
+			| (unpremultiply_channel((p[i] >> 8) & 0xFF, a) << 8) | unpremultiply_channel(p[i] & 0xFF, a);
+	}
+}
+
+#ifdef ARC_RASTER_X86
+
+//
+// SSE2 kernels (4 pixels at a time)
+// Each pixel is unpacked to 4 16-bit lanes in memory order: B, G, R, A
+//
+
+inline __m128i sse2_div255(__m128i x) {
+	x = _mm_add_epi16(x, _mm_set1_epi16(128));
+	return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+inline __m128i sse2_alpha(const __m128i unpacked) {
+	return _mm_shufflehi_epi16(_mm_shufflelo_epi16(unpacked, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+}
+
+// The src alpha lanes are set to 255, so the alpha result is a + dst_alpha * (1 - a).
+inline __m128i sse2_blend_half(const __m128i s, const __m128i d) {
+	const __m128i a = sse2_alpha(s);
+	const __m128i ia = _mm_sub_epi16(_mm_set1_epi16(255), a);
+	const __m128i s_opaque = _mm_or_si128(s, _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0));
+	return sse2_div255(_mm_add_epi16(_mm_mullo_epi16(s_opaque, a), _mm_mullo_epi16(d, ia)));
+}
+
+inline __m128i sse2_blend4(const __m128i src, const __m128i dst) {
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i lo = sse2_blend_half(_mm_unpacklo_epi8(src, zero), _mm_unpacklo_epi8(dst, zero));
+	const __m128i hi = sse2_blend_half(_mm_unpackhi_epi8(src, zero), _mm_unpackhi_epi8(dst, zero));
+	return _mm_packus_epi16(lo, hi);
+}
+
+inline __m128i sse2_premultiplied4(const __m128i src, const __m128i dst) {
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i c255 = _mm_set1_epi16(255);
+	const __m128i ia_lo = _mm_sub_epi16(c255, sse2_alpha(_mm_unpacklo_epi8(src, zero)));
+	const __m128i ia_hi = _mm_sub_epi16(c255, sse2_alpha(_mm_unpackhi_epi8(src, zero)));
+	const __m128i lo = sse2_div255(_mm_mullo_epi16(_mm_unpacklo_epi8(dst, zero), ia_lo));
+	const __m128i hi = sse2_div255(_mm_mullo_epi16(_mm_unpackhi_epi8(dst, zero), ia_hi));
+	return _mm_adds_epu8(src, _mm_packus_epi16(lo, hi));
+}
+
+void sse2_fill(uint32_t* dst, size_t n, const uint32_t pixel) {
+	const __m128i p = _mm_set1_epi32((int) pixel);
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		_mm_storeu_si128((__m128i*) (dst + i), p);
+	}
+	scalar_fill(dst + i, n - i, pixel);
+}
+
+void sse2_blend_fill(uint32_t* dst, size_t n, const uint32_t pixel) {
+	const __m128i p = _mm_set1_epi32((int) pixel);
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const __m128i d = _mm_loadu_si128((const __m128i*) (dst + i));
+		_mm_storeu_si128((__m128i*) (dst + i), sse2_blend4(p, d));
+	}
+	scalar_blend_fill(dst + i, n - i, pixel);
+}
+
+void sse2_blend(uint32_t* dst, const uint32_t* src, size_t n) {
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const __m128i s = _mm_loadu_si128((const __m128i*) (src + i));
+		const __m128i d = _mm_loadu_si128((const __m128i*) (dst + i));
+		_mm_storeu_si128((__m128i*) (dst + i), sse2_blend4(s, d));
+	}
+	scalar_blend(dst + i, src + i, n - i);
+}
+
+void sse2_premultiplied(uint32_t* dst, const uint32_t* src, size_t n) {
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const __m128i s = _mm_loadu_si128((const __m128i*) (src + i));
+		const __m128i d = _mm_loadu_si128((const __m128i*) (dst + i));
+		_mm_storeu_si128((__m128i*) (dst + i), sse2_premultiplied4(s, d));
+	}
+	scalar_premultiplied(dst + i, src + i, n - i);
+}
+
+inline __m128i sse2_swap_rb4(const __m128i p) {
+	const __m128i m = _mm_set1_epi32(0xFF);
+	return _mm_or_si128(_mm_and_si128(p, _mm_set1_epi32((int) 0xFF00FF00)),
+		_mm_or_si128(_mm_and_si128(_mm_srli_epi32(p, 16), m), _mm_slli_epi32(_mm_and_si128(p, m), 16)));
+}
+
+void sse2_swap_rb(uint32_t* dst, const uint32_t* src, size_t n) {
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		_mm_storeu_si128((__m128i*) (dst + i), sse2_swap_rb4(_mm_loadu_si128((const __m128i*) (src + i))));
+	}
+	scalar_swap_rb(dst + i, src + i, n - i);
+}
+
+void sse2_rotl8(uint32_t* dst, const uint32_t* src, size_t n) {
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const __m128i p = _mm_loadu_si128((const __m128i*) (src + i));
+		_mm_storeu_si128((__m128i*) (dst + i), _mm_or_si128(_mm_slli_epi32(p, 8), _mm_srli_epi32(p, 24)));
+	}
+	scalar_rotl8(dst + i, src + i, n - i);
+}
+
+void sse2_rotr8(uint32_t* dst, const uint32_t* src, size_t n) {
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const __m128i p = _mm_loadu_si128((const __m128i*) (src + i));
+		_mm_storeu_si128((__m128i*) (dst + i), _mm_or_si128(_mm_srli_epi32(p, 8), _mm_slli_epi32(p, 24)));
+	}
+	scalar_rotr8(dst + i, src + i, n - i);
+}
+
+inline __m128i sse2_to_rgb565_4(const __m128i p) {
+	const __m128i v = _mm_or_si128(_mm_and_si128(_mm_srli_epi32(p, 8), _mm_set1_epi32(0xF800)),
+		_mm_or_si128(_mm_and_si128(_mm_srli_epi32(p, 5), _mm_set1_epi32(0x07E0)),
+			_mm_and_si128(_mm_srli_epi32(p, 3), _mm_set1_epi32(0x001F))));
+	// Packing is signed, so offset to the signed range and back.
+	return _mm_sub_epi32(v, _mm_set1_epi32(0x8000));
+}
+
+void sse2_to_rgb565(uint16_t* dst, const uint32_t* src, size_t n) {
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m128i lo = sse2_to_rgb565_4(_mm_loadu_si128((const __m128i*) (src + i)));
+		const __m128i hi = sse2_to_rgb565_4(_mm_loadu_si128((const __m128i*) (src + i + 4)));
+		_mm_storeu_si128((__m128i*) (dst + i), _mm_xor_si128(_mm_packs_epi32(lo, hi), _mm_set1_epi16((short) 0x8000)));
+	}
+	scalar_to_rgb565(dst + i, src + i, n - i);
+}
+
+inline __m128i sse2_from_rgb565_4(const __m128i p) {
+	const __m128i r = _mm_or_si128(_mm_and_si128(_mm_srli_epi32(p, 8), _mm_set1_epi32(0xF8)), _mm_srli_epi32(p, 13));
+	const __m128i g = _mm_or_si128(_mm_and_si128(_mm_srli_epi32(p, 3), _mm_set1_epi32(0xFC)),
+		_mm_and_si128(_mm_srli_epi32(p, 9), _mm_set1_epi32(0x03)));
+	const __m128i b = _mm_or_si128(_mm_and_si128(_mm_slli_epi32(p, 3), _mm_set1_epi32(0xF8)),
+		_mm_and_si128(_mm_srli_epi32(p, 2), _mm_set1_epi32(0x07)));
+	return _mm_or_si128(_mm_set1_epi32((int) 0xFF000000),
+		_mm_or_si128(_mm_slli_epi32(r, 16), _mm_or_si128(_mm_slli_epi32(g, 8), b)));
+}
+
+void sse2_from_rgb565(uint32_t* dst, const uint16_t* src, size_t n) {
+	const __m128i zero = _mm_setzero_si128();
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m128i p = _mm_loadu_si128((const __m128i*) (src + i));
+		_mm_storeu_si128((__m128i*) (dst + i), sse2_from_rgb565_4(_mm_unpacklo_epi16(p, zero)));
+		_mm_storeu_si128((__m128i*) (dst + i + 4), sse2_from_rgb565_4(_mm_unpackhi_epi16(p, zero)));
+	}
+	scalar_from_rgb565(dst + i, src + i, n - i);
+}
+
+// The alpha lanes keep the original alpha.
+inline __m128i sse2_premultiply_half(const __m128i c) {
+	const __m128i alpha_lanes = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+	const __m128i m = sse2_div255(_mm_mullo_epi16(c, sse2_alpha(c)));
+	return _mm_or_si128(_mm_andnot_si128(alpha_lanes, m), _mm_and_si128(alpha_lanes, c));
+}
+
+void sse2_premultiply(uint32_t* p, size_t n) {
+	const __m128i zero = _mm_setzero_si128();
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const __m128i v = _mm_loadu_si128((const __m128i*) (p + i));
+		const __m128i lo = sse2_premultiply_half(_mm_unpacklo_epi8(v, zero));
+		const __m128i hi = sse2_premultiply_half(_mm_unpackhi_epi8(v, zero));
+		_mm_storeu_si128((__m128i*) (p + i), _mm_packus_epi16(lo, hi));
+	}
+	scalar_premultiply(p + i, n - i);
+}
+
+// c is in the low byte of each 32-bit lane, a_half is a / 2.
+inline __m128i sse2_unpremultiply_channel(const __m128i c, const __m128 a, const __m128i a_half) {
+	const __m128i num = _mm_add_epi32(_mm_sub_epi32(_mm_slli_epi32(c, 8), c), a_half); // c * 255 + a / 2
+	const __m128i v = _mm_cvttps_epi32(_mm_div_ps(_mm_cvtepi32_ps(num), a));
+	const __m128i over = _mm_cmpgt_epi32(v, _mm_set1_epi32(255));
+	return _mm_or_si128(_mm_andnot_si128(over, v), _mm_and_si128(over, _mm_set1_epi32(255)));
+}
+
+void sse2_unpremultiply(uint32_t* p, size_t n) {
+	const __m128i m = _mm_set1_epi32(0xFF);
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const __m128i v = _mm_loadu_si128((const __m128i*) (p + i));
+		const __m128i ai = _mm_srli_epi32(v, 24);
+		const __m128 a = _mm_cvtepi32_ps(ai);
+		const __m128i a_half = _mm_srli_epi32(ai, 1);
+		const __m128i r = sse2_unpremultiply_channel(_mm_and_si128(_mm_srli_epi32(v, 16), m), a, a_half);
+		const __m128i g = sse2_unpremultiply_channel(_mm_and_si128(_mm_srli_epi32(v, 8), m), a, a_half);
+		const __m128i b = sse2_unpremultiply_channel(_mm_and_si128(v, m), a, a_half);
+		const __m128i out = _mm_or_si128(_mm_slli_epi32(ai, 24),
+			_mm_or_si128(_mm_slli_epi32(r, 16), _mm_or_si128(_mm_slli_epi32(g, 8), b)));
+		// Where alpha is 0, the division is invalid, so those are 0.
+		const __m128i transparent = _mm_cmpeq_epi32(ai, _mm_setzero_si128());
+		_mm_storeu_si128((__m128i*) (p + i), _mm_andnot_si128(transparent, out));
+	}
+	scalar_unpremultiply(p + i, n - i);
+}
+
+//
+// AVX2 kernels (8 pixels at a time, the same as SSE2 in each 128-bit lane)
+//
+
+ARC_TARGET_AVX2 inline __m256i avx2_div255(__m256i x) {
+	x = _mm256_add_epi16(x, _mm256_set1_epi16(128));
+	return _mm256_srli_epi16(_mm256_add_epi16(x, _mm256_srli_epi16(x, 8)), 8);
+}
+
+ARC_TARGET_AVX2 inline __m256i avx2_alpha(const __m256i unpacked) {
+	return _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(unpacked, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+}
+
+ARC_TARGET_AVX2 inline __m256i avx2_blend_half(const __m256i s, const __m256i d) {
+	const __m256i a = avx2_alpha(s);
+	const __m256i ia = _mm256_sub_epi16(_mm256_set1_epi16(255), a);
+	const __m256i s_opaque = _mm256_or_si256(s, _mm256_set_epi16(255, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0));
+	return avx2_div255(_mm256_add_epi16(_mm256_mullo_epi16(s_opaque, a), _mm256_mullo_epi16(d, ia)));
+}
+
+ARC_TARGET_AVX2 inline __m256i avx2_blend8(const __m256i src, const __m256i dst) {
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i lo = avx2_blend_half(_mm256_unpacklo_epi8(src, zero), _mm256_unpacklo_epi8(dst, zero));
+	const __m256i hi = avx2_blend_half(_mm256_unpackhi_epi8(src, zero), _mm256_unpackhi_epi8(dst, zero));
+	return _mm256_packus_epi16(lo, hi);
+}
+
+ARC_TARGET_AVX2 inline __m256i avx2_premultiplied8(const __m256i src, const __m256i dst) {
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i c255 = _mm256_set1_epi16(255);
+	const __m256i ia_lo = _mm256_sub_epi16(c255, avx2_alpha(_mm256_unpacklo_epi8(src, zero)));
+	const __m256i ia_hi = _mm256_sub_epi16(c255, avx2_alpha(_mm256_unpackhi_epi8(src, zero)));
+	const __m256i lo = avx2_div255(_mm256_mullo_epi16(_mm256_unpacklo_epi8(dst, zero), ia_lo));
+	const __m256i hi = avx2_div255(_mm256_mullo_epi16(_mm256_unpackhi_epi8(dst, zero), ia_hi));
+	return _mm256_adds_epu8(src, _mm256_packus_epi16(lo, hi));
+}
+
+ARC_TARGET_AVX2 void avx2_fill(uint32_t* dst, size_t n, const uint32_t pixel) {
+	const __m256i p = _mm256_set1_epi32((int) pixel);
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		_mm256_storeu_si256((__m256i*) (dst + i), p);
+	}
+	sse2_fill(dst + i, n - i, pixel);
+}
+
+ARC_TARGET_AVX2 void avx2_blend_fill(uint32_t* dst, size_t n, const uint32_t pixel) {
+	const __m256i p = _mm256_set1_epi32((int) pixel);
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m256i d = _mm256_loadu_si256((const __m256i*) (dst + i));
+		_mm256_storeu_si256((__m256i*) (dst + i), avx2_blend8(p, d));
+	}
+	sse2_blend_fill(dst + i, n - i, pixel);
+}
+
+ARC_TARGET_AVX2 void avx2_blend(uint32_t* dst, const uint32_t* src, size_t n) {
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m256i s = _mm256_loadu_si256((const __m256i*) (src + i));
+		const __m256i d = _mm256_loadu_si256((const __m256i*) (dst + i));
+		_mm256_storeu_si256((__m256i*) (dst + i), avx2_blend8(s, d));
+	}
+	sse2_blend(dst + i, src + i, n - i);
+}
+
+ARC_TARGET_AVX2 void avx2_premultiplied(uint32_t* dst, const uint32_t* src, size_t n) {
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m256i s = _mm256_loadu_si256((const __m256i*) (src + i));
+		const __m256i d = _mm256_loadu_si256((const __m256i*) (dst + i));
+		_mm256_storeu_si256((__m256i*) (dst + i), avx2_premultiplied8(s, d));
+	}
+	sse2_premultiplied(dst + i, src + i, n - i);
+}
+
+ARC_TARGET_AVX2 void avx2_swap_rb(uint32_t* dst, const uint32_t* src, size_t n) {
+	const __m256i m = _mm256_set1_epi32(0xFF);
+	const __m256i ag = _mm256_set1_epi32((int) 0xFF00FF00);
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m256i p = _mm256_loadu_si256((const __m256i*) (src + i));
+		_mm256_storeu_si256((__m256i*) (dst + i), _mm256_or_si256(_mm256_and_si256(p, ag),
+			_mm256_or_si256(_mm256_and_si256(_mm256_srli_epi32(p, 16), m), _mm256_slli_epi32(_mm256_and_si256(p, m), 16))));
+	}
+	sse2_swap_rb(dst + i, src + i, n - i);
+}
+
+ARC_TARGET_AVX2 void avx2_rotl8(uint32_t* dst, const uint32_t* src, size_t n) {
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m256i p = _mm256_loadu_si256((const __m256i*) (src + i));
+		_mm256_storeu_si256((__m256i*) (dst + i), _mm256_or_si256(_mm256_slli_epi32(p, 8), _mm256_srli_epi32(p, 24)));
+	}
+	sse2_rotl8(dst + i, src + i, n - i);
+}
+
+ARC_TARGET_AVX2 void avx2_rotr8(uint32_t* dst, const uint32_t* src, size_t n) {
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m256i p = _mm256_loadu_si256((const __m256i*) (src + i));
+		_mm256_storeu_si256((__m256i*) (dst + i), _mm256_or_si256(_mm256_srli_epi32(p, 8), _mm256_slli_epi32(p, 24)));
+	}
+	sse2_rotr8(dst + i, src + i, n - i);
+}
+
+ARC_TARGET_AVX2 inline __m256i avx2_premultiply_half(const __m256i c) {
+	const __m256i alpha_lanes = _mm256_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0, -1, 0, 0, 0, -1, 0, 0, 0);
+	const __m256i m = avx2_div255(_mm256_mullo_epi16(c, avx2_alpha(c)));
+	return _mm256_or_si256(_mm256_andnot_si256(alpha_lanes, m), _mm256_and_si256(alpha_lanes, c));
+}
+
+ARC_TARGET_AVX2 void avx2_premultiply(uint32_t* p, size_t n) {
+	const __m256i zero = _mm256_setzero_si256();
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m256i v = _mm256_loadu_si256((const __m256i*) (p + i));
+		const __m256i lo = avx2_premultiply_half(_mm256_unpacklo_epi8(v, zero));
+		const __m256i hi = avx2_premultiply_half(_mm256_unpackhi_epi8(v, zero));
+		_mm256_storeu_si256((__m256i*) (p + i), _mm256_packus_epi16(lo, hi));
+	}
+	sse2_premultiply(p + i, n - i);
+}
+
+ARC_TARGET_AVX2 inline __m256i avx2_unpremultiply_channel(const __m256i c, const __m256 a, const __m256i a_half) {
+	const __m256i num = _mm256_add_epi32(_mm256_sub_epi32(_mm256_slli_epi32(c, 8), c), a_half);
+	const __m256i v = _mm256_cvttps_epi32(_mm256_div_ps(_mm256_cvtepi32_ps(num), a));
+	return _mm256_min_epi32(v, _mm256_set1_epi32(255));
+}
+
+ARC_TARGET_AVX2 void avx2_unpremultiply(uint32_t* p, size_t n) {
+	const __m256i m = _mm256_set1_epi32(0xFF);
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m256i v = _mm256_loadu_si256((const __m256i*) (p + i));
+		const __m256i ai = _mm256_srli_epi32(v, 24);
+		const __m256 a = _mm256_cvtepi32_ps(ai);
+		const __m256i a_half = _mm256_srli_epi32(ai, 1);
+		const __m256i r = avx2_unpremultiply_channel(_mm256_and_si256(_mm256_srli_epi32(v, 16), m), a, a_half);
+		const __m256i g = avx2_unpremultiply_channel(_mm256_and_si256(_mm256_srli_epi32(v, 8), m), a, a_half);
+		const __m256i b = avx2_unpremultiply_channel(_mm256_and_si256(v, m), a, a_half);
+		const __m256i out = _mm256_or_si256(_mm256_slli_epi32(ai, 24),
+			_mm256_or_si256(_mm256_slli_epi32(r, 16), _mm256_or_si256(_mm256_slli_epi32(g, 8), b)));
+		const __m256i transparent = _mm256_cmpeq_epi32(ai, _mm256_setzero_si256());
+		_mm256_storeu_si256((__m256i*) (p + i), _mm256_andnot_si256(transparent, out));
+	}
+	sse2_unpremultiply(p + i, n - i);
+}
+
+#endif // ARC_RASTER_X86
+
+//
+// Kernel selection
+//
+
+struct raster_kernels {
+	const char* name;
+	void (*fill)(uint32_t* dst, size_t n, const uint32_t pixel);
+	void (*blend_fill)(uint32_t* dst, size_t n, const uint32_t pixel);
+	void (*blend)(uint32_t* dst, const uint32_t* src, size_t n);
+	void (*premultiplied)(uint32_t* dst, const uint32_t* src, size_t n);
+	// Pixel formats:
+	void (*swap_rb)(uint32_t* dst, const uint32_t* src, size_t n);
+	void (*rotl8)(uint32_t* dst, const uint32_t* src, size_t n);
+	void (*rotr8)(uint32_t* dst, const uint32_t* src, size_t n);
+	void (*to_rgb565)(uint16_t* dst, const uint32_t* src, size_t n);
+	void (*from_rgb565)(uint32_t* dst, const uint16_t* src, size_t n);
+	void (*premultiply)(uint32_t* p, size_t n);
+	void (*unpremultiply)(uint32_t* p, size_t n);
+};
+
+const raster_kernels scalar_kernels = { "scalar", scalar_fill, scalar_blend_fill, scalar_blend, scalar_premultiplied,
+	scalar_swap_rb, scalar_rotl8, scalar_rotr8, scalar_to_rgb565, scalar_from_rgb565, scalar_premultiply, scalar_unpremultiply };
+#ifdef ARC_RASTER_X86
+const raster_kernels sse2_kernels = { "sse2", sse2_fill, sse2_blend_fill, sse2_blend, sse2_premultiplied,
+	sse2_swap_rb, sse2_rotl8, sse2_rotr8, sse2_to_rgb565, sse2_from_rgb565, sse2_premultiply, sse2_unpremultiply };
+// RGB565 packing crosses the 128-bit lanes, so it stays SSE2.
+const raster_kernels avx2_kernels = { "avx2", avx2_fill, avx2_blend_fill, avx2_blend, avx2_premultiplied,
+	avx2_swap_rb, avx2_rotl8, avx2_rotr8, sse2_to_rgb565, sse2_from_rgb565, avx2_premultiply, avx2_unpremultiply };
+#endif
+
+const raster_kernels* BestKernels() {
+#ifdef ARC_RASTER_X86
+	if (SDL_HasAVX2()) {
+		return &avx2_kernels;
+	}
+	if (SDL_HasSSE2()) {
+		return &sse2_kernels;
+	}
+#endif
+	return &scalar_kernels;
+}
+
+bool use_simd = true;
+
+const raster_kernels& Kernels() {
+	static const raster_kernels* best = BestKernels();
+	return use_simd ? *best : scalar_kernels;
+}
+
+void UseSimd(const bool enabled) {
+	use_simd = enabled;
+}
+
+const char* KernelName() {
+	return Kernels().name;
+}
+
+//
+// Drawing
+//
+
+inline uint32_t* PixelRow(DataBuffer& buffer, const int x, const int y) {
+	return (uint32_t*) ((uint8_t*) buffer.data + (size_t(y) * size_t(buffer.bytes_per_row))) + x;
+}
+
+inline const uint32_t* PixelRow(const DataBuffer& buffer, const int x, const int y) {
+	return (const uint32_t*) ((const uint8_t*) buffer.data + (size_t(y) * size_t(buffer.bytes_per_row))) + x;
+}
+
+// Returns false if nothing is left after clipping to the buffer.
+inline bool ClipRect(const DataBuffer& buffer, int& x, int& y, int& width, int& height) {
+	if (x < 0) {
+		width += x;
+		x = 0;
+	}
+	if (y < 0) {
+		height += y;
+		y = 0;
+	}
+	if (x + width > buffer.width) {
+		width = buffer.width - x;
+	}
+	if (y + height > buffer.height) {
+		height = buffer.height - y;
+	}
+	return width > 0 && height > 0;
+}
+
+void FillSpan32(DataBuffer& buffer, const int x, const int y, const int width, const uint32_t pixel) {
+	FillRect32(buffer, x, y, width, 1, pixel);
+}
+
+void FillRect32(DataBuffer& buffer, const int x, const int y, const int width, const int height, const uint32_t pixel) {
+	int cx = x;
+	int cy = y;
+	int cw = width;
+	int ch = height;
+	if (!ClipRect(buffer, cx, cy, cw, ch)) {
+		return;
+	}
+	const raster_kernels& k = Kernels();
+	for (int row = cy; row < cy + ch; row++) {
+		k.fill(PixelRow(buffer, cx, row), size_t(cw), pixel);
+	}
+}
+
+void BlendSpan32(DataBuffer& buffer, const int x, const int y, const int width, const uint32_t pixel) {
+	BlendRect32(buffer, x, y, width, 1, pixel);
+}
+
+void BlendRect32(DataBuffer& buffer, const int x, const int y, const int width, const int height, const uint32_t pixel) {
+	const uint32_t alpha = pixel >> 24;
+	if (alpha == 0) {
+		return;
+	} else if (alpha == 255) {
+		FillRect32(buffer, x, y, width, height, pixel);
+		return;
+	}
+	int cx = x;
+	int cy = y;
+	int cw = width;
+	int ch = height;
+	if (!ClipRect(buffer, cx, cy, cw, ch)) {
+		return;
+	}
+	const raster_kernels& k = Kernels();
+	for (int row = cy; row < cy + ch; row++) {
+		k.blend_fill(PixelRow(buffer, cx, row), size_t(cw), pixel);
+	}
+}
+
+// Calls func(dst_row, src_row, width) for each row of src that is inside dst at x, y.
+template<typename F>
+void ForEachBlitRow(DataBuffer& dst, const DataBuffer& src, const int x, const int y, F func) {
+	int cx = x;
+	int cy = y;
+	int cw = src.width;
+	int ch = src.height;
+	if (!ClipRect(dst, cx, cy, cw, ch)) {
+		return;
+	}
+	const int sx = cx - x;
+	const int sy = cy - y;
+	for (int row = 0; row < ch; row++) {
+		func(PixelRow(dst, cx, cy + row), PixelRow(src, sx, sy + row), size_t(cw));
+	}
+}
+
+void Blit32(DataBuffer& dst, const DataBuffer& src, const int x, const int y) {
+	ForEachBlitRow(dst, src, x, y, [](uint32_t* d, const uint32_t* s, const size_t n) {
+		memmove(d, s, n * 4);
+	});
+}
+
+void BlitAlpha32(DataBuffer& dst, const DataBuffer& src, const int x, const int y) {
+	const raster_kernels& k = Kernels();
+	ForEachBlitRow(dst, src, x, y, k.blend);
+}
+
+void BlitPremultiplied32(DataBuffer& dst, const DataBuffer& src, const int x, const int y) {
+	const raster_kernels& k = Kernels();
+	ForEachBlitRow(dst, src, x, y, k.premultiplied);
+}
+
+void DrawLine32(DataBuffer& buffer, const int x_start, const int y_start, const int x_end, const int y_end,
+				const int thickness, const uint32_t pixel, const bool blend) {
+	const int t = thickness < 1 ? 1 : thickness;
+
+	// Only the rows inside the buffer are tracked.
+	const int top = max(min(y_start, y_end), 0);
+	const int bottom = min(max(y_start, y_end) + t - 1, buffer.height - 1);
+	if (top > bottom) {
+		return;
+	}
+	const int rows = bottom - top + 1;
+
+	// The covered columns of each row.
+	thread_local std::vector<int> span_start;
+	thread_local std::vector<int> span_end;
+	span_start.assign(size_t(rows), INT_MAX);
+	span_end.assign(size_t(rows), INT_MIN);
+
+	// Bresenham, the same points as RenderModule::DrawLineIntoBuffer32
+	const int dx = abs(x_end - x_start);
+	const int dy = abs(y_end - y_start);
+	const int sx = x_end < x_start ? -1 : 1;
+	const int sy = y_end < y_start ? -1 : 1;
+	int error = (dx > dy ? dx : -dy) / 2;
+
+	int x = x_start;
+	int y = y_start;
+	while (true) {
+		const int first = max(y, top);
+		const int last = min(y + t - 1, bottom);
+		for (int row = first; row <= last; row++) {
+			const size_t r = size_t(row - top);
+			span_start[r] = min(span_start[r], x);
+			span_end[r] = max(span_end[r], x + t - 1);
+		}
+		if (x == x_end && y == y_end) {
+			break;
+		}
+		const int error2 = error;
+		if (error2 > -dx) {
+			error -= dy;
+			x += sx;
+		}
+		if (error2 < dy) {
+			error += dx;
+			y += sy;
+		}
+	}
+
+	for (int r = 0; r < rows; r++) {
+		if (span_start[r] <= span_end[r]) {
+			const int w = span_end[r] - span_start[r] + 1;
+			if (blend) {
+				BlendSpan32(buffer, span_start[r], top + r, w, pixel);
+			} else {
+				FillSpan32(buffer, span_start[r], top + r, w, pixel);
+			}
+		}
+	}
+}
+
+//
+// Pixel formats
+//
+
+bool IsConvertibleFormat(const uint32_t format) {
+	return format == SDL_PIXELFORMAT_ARGB8888 || format == SDL_PIXELFORMAT_ABGR8888
+		|| format == SDL_PIXELFORMAT_RGBA8888 || format == SDL_PIXELFORMAT_RGB565;
+}
+
+typedef void (*convert_func)(uint32_t* dst, const uint32_t* src, size_t n);
+
+// The conversion of a 32-bit format to and from ARGB8888, or nullptr if it is already ARGB8888.
+inline convert_func ToARGB(const raster_kernels& k, const uint32_t format) {
+	if (format == SDL_PIXELFORMAT_ABGR8888) {
+		return k.swap_rb;
+	} else if (format == SDL_PIXELFORMAT_RGBA8888) {
+		return k.rotr8;
+	}
+	return nullptr;
+}
+
+inline convert_func FromARGB(const raster_kernels& k, const uint32_t format) {
+	if (format == SDL_PIXELFORMAT_ABGR8888) {
+		return k.swap_rb;
+	} else if (format == SDL_PIXELFORMAT_RGBA8888) {
+		return k.rotl8;
+	}
+	return nullptr;
+}
+
+bool ConvertPixels(const DataBuffer& src, DataBuffer& dst) {
+	if (!IsConvertibleFormat(src.format) || !IsConvertibleFormat(dst.format)
+		|| src.width != dst.width || src.height != dst.height) {
+		return false;
+	}
+	const bool src_565 = src.format == SDL_PIXELFORMAT_RGB565;
+	const bool dst_565 = dst.format == SDL_PIXELFORMAT_RGB565;
+	if (src.data == dst.data && src_565 != dst_565) {
+		return false; // Different sizes can't be converted in place.
+	}
+	const size_t n = size_t(max(src.width, 0));
+	const raster_kernels& k = Kernels();
+
+	thread_local std::vector<uint32_t> row; // ARGB8888, when converting to RGB565 from another format.
+	for (int y = 0; y < src.height; y++) {
+		const uint8_t* s = (const uint8_t*) src.data + (size_t(y) * size_t(src.bytes_per_row));
+		uint8_t* d = (uint8_t*) dst.data + (size_t(y) * size_t(dst.bytes_per_row));
+		if (src_565 && dst_565) {
+			if (s != d) {
+				memmove(d, s, n * 2);
+			}
+		} else if (src_565) {
+			k.from_rgb565((uint32_t*) d, (const uint16_t*) s, n);
+			const convert_func from = FromARGB(k, dst.format);
+			if (from != nullptr) {
+				from((uint32_t*) d, (const uint32_t*) d, n);
+			}
+		} else if (dst_565) {
+			const convert_func to = ToARGB(k, src.format);
+			const uint32_t* argb = (const uint32_t*) s;
+			if (to != nullptr) {
+				row.resize(n);
+				to(row.data(), argb, n);
+				argb = row.data();
+			}
+			k.to_rgb565((uint16_t*) d, argb, n);
+		} else {
+			const convert_func to = ToARGB(k, src.format);
+			const convert_func from = FromARGB(k, dst.format);
+			if (src.format == dst.format) {
+				if (s != d) {
+					memmove(d, s, n * 4);
+				}
+			} else if (to != nullptr && from != nullptr) {
+				to((uint32_t*) d, (const uint32_t*) s, n);
+				from((uint32_t*) d, (const uint32_t*) d, n);
+			} else if (to != nullptr) {
+				to((uint32_t*) d, (const uint32_t*) s, n);
+			} else {
+				from((uint32_t*) d, (const uint32_t*) s, n);
+			}
+		}
+	}
+	return true;
+}
+
+// Calls func(row, width) on each row, as ARGB8888 or ABGR8888 (with the alpha in the top byte).
+template<typename F>
+bool ForEachAlphaRow(DataBuffer& buffer, F func) {
+	const raster_kernels& k = Kernels();
+	const bool rotate = buffer.format == SDL_PIXELFORMAT_RGBA8888;
+	if (!rotate && buffer.format != SDL_PIXELFORMAT_ARGB8888 && buffer.format != SDL_PIXELFORMAT_ABGR8888) {
+		return false;
+	}
+	const size_t n = size_t(max(buffer.width, 0));
+	for (int y = 0; y < buffer.height; y++) {
+		uint32_t* row = (uint32_t*) ((uint8_t*) buffer.data + (size_t(y) * size_t(buffer.bytes_per_row)));
+		if (rotate) {
+			k.rotr8(row, row, n);
+		}
+		func(row, n);
+		if (rotate) {
+			k.rotl8(row, row, n);
+		}
+	}
+	return true;
+}
+
+bool PremultiplyAlpha(DataBuffer& buffer) {
+	return ForEachAlphaRow(buffer, Kernels().premultiply);
+}
+
+bool UnpremultiplyAlpha(DataBuffer& buffer) {
+	return ForEachAlphaRow(buffer, Kernels().unpremultiply);
+}
+
+} } // namespace arc::raster
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "graphics.h"
+
+// Software rasterizing into 32-bit (4 bytes per pixel) DataBuffers, for procedurally drawn sprites.
+// Pixels are uint32_t values with alpha in the top byte (ARGB8888, the DataBuffer default), and
+// everything is clipped to the buffer.
+// The kernels use AVX2 or SSE2 when available, with the exact same results as the scalar code.
+
+namespace arc { namespace raster {
+
+// Fills (replaces) the pixels.
+void FillSpan32(DataBuffer& buffer, const int x, const int y, const int width, const uint32_t pixel);
+void FillRect32(DataBuffer& buffer, const int x, const int y, const int width, const int height, const uint32_t pixel);
+
+// Blends with the pixel's (straight, not premultiplied) alpha, the same as SDL_BLENDMODE_BLEND:
+// color = src * a + dst * (1 - a), alpha = a + dst_alpha * (1 - a)
+void BlendSpan32(DataBuffer& buffer, const int x, const int y, const int width, const uint32_t pixel);
+void BlendRect32(DataBuffer& buffer, const int x, const int y, const int width, const int height, const uint32_t pixel);
+
+// Copies all of src to x, y in dst.
+void Blit32(DataBuffer& dst, const DataBuffer& src, const int x, const int y);
+// Blends all of src to x, y in dst, with straight alpha (as BlendSpan32).
+void BlitAlpha32(DataBuffer& dst, const DataBuffer& src, const int x, const int y);
+// For src with premultiplied alpha: all channels = src + dst * (1 - src_alpha)
+void BlitPremultiplied32(DataBuffer& dst, const DataBuffer& src, const int x, const int y);
+
+// Each point of the line is a thickness x thickness square (from its top-left), drawn as one span
+// per row, so no pixel is drawn (or blended) twice.
+void DrawLine32(DataBuffer& buffer, const int x_start, const int y_start, const int x_end, const int y_end,
+	const int thickness, const uint32_t pixel, const bool blend = false);
+
+// Pixel format conversion between ARGB8888, ABGR8888, RGBA8888, and RGB565 (SDL_PIXELFORMAT_*).
+// From RGB565 is opaque, and to it drops the alpha (and the lowest bits of each color).
+bool IsConvertibleFormat(const uint32_t format);
+// Converts all of src into dst, which must have its own format already set, and the same width and
+// height. Returns false if either format isn't supported. (dst can be src, except to or from RGB565.)
+bool ConvertPixels(const DataBuffer& src, DataBuffer& dst);
+
+// For the 32-bit formats: Multiplies the colors by the alpha, or divides them by it again.
+// (Fully transparent pixels become 0, as their colors can't be restored.) Returns false for other formats.
+bool PremultiplyAlpha(DataBuffer& buffer);
+bool UnpremultiplyAlpha(DataBuffer& buffer);
+
+// Disable for the scalar code only (for comparisons), not thread safe while drawing.
+void UseSimd(const bool enabled = true);
+const char* KernelName(); // "avx2", "sse2", or "scalar"
+
+} } // namespace arc::raster
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <vector>
 
 namespace arc {
@@ -87,4 +88,121 @@ void removefromzerovector(std::vector<T>& items, T element) {
 	}
 }
 
+// Handles for slot_pool: The low bits are the slot index, and the high bits are the generation of
+// the slot (changed every time its item is removed), so handles of removed items are detected as
+// stale, even after the slot is used again. A slot is retired (never used again) instead of its
+// generation wrapping around, so stale handles can never match a later item. 0 is never a valid handle.
+#define ARC_HANDLE_INDEX_BITS 20 // Up to about a million items at once.
+#define ARC_HANDLE_INDEX_MASK ((uint32_t{ 1 } << ARC_HANDLE_INDEX_BITS) - 1)
+#define ARC_HANDLE_GENERATION_MASK (~uint32_t{ 0 } >> ARC_HANDLE_INDEX_BITS)
+#define ARC_NULL_HANDLE 0
+#define ARC_HANDLE_NO_FREE_SLOT (~uint32_t{ 0 })
+
+// A slot vector with a free list, so adding and removing are O(1) instead of a search, with
+// generational handles. The items are Owned, and deleted when removed. Freed slots are used again
+// in the order they were freed, so each one's generations last as long as possible.
+// (Each slot holds up to 4095 items over time, so with 2^20 slots about 4 billion adds in total.)
+template<typename T>
+class slot_pool {
+public:
+	slot_pool() {}
+	~slot_pool() { clear(); }
+
+	// Returns ARC_NULL_HANDLE if full (then element is NOT Owned).
+	uint32_t add(T* element) {
+		uint32_t index = free_head_;
+		if (index != ARC_HANDLE_NO_FREE_SLOT) {
+			free_head_ = slots_[index].next_free;
+			if (free_head_ == ARC_HANDLE_NO_FREE_SLOT) {
+				free_tail_ = ARC_HANDLE_NO_FREE_SLOT;
+			}
+		} else {
+			if (slots_.size() > ARC_HANDLE_INDEX_MASK) {
+				return ARC_NULL_HANDLE;
+			}
+			index = uint32_t(slots_.size());
+			slots_.push_back(slot());
+		}
+		slot& s = slots_[index];
+		s.item = element;
+		s.next_free = ARC_HANDLE_NO_FREE_SLOT;
+		count_++;
+		return (s.generation << ARC_HANDLE_INDEX_BITS) | index;
+	}
+
+	// nullptr if removed (or never added).
+	T* get(const uint32_t handle) const {
+		const uint32_t index = handle & ARC_HANDLE_INDEX_MASK;
+		if (index >= slots_.size()) {
+			return nullptr;
+		}
+		const slot& s = slots_[index];
+		if (s.item == nullptr || s.generation != (handle >> ARC_HANDLE_INDEX_BITS)) {
+			return nullptr;
+		}
+		return s.item;
+	}
+
+	// Removes without deleting it, returns nullptr if already removed.
+	T* release(const uint32_t handle) {
+		T* item = get(handle);
+		if (item == nullptr) {
+			return nullptr;
+		}
+		const uint32_t index = handle & ARC_HANDLE_INDEX_MASK;
+		slot& s = slots_[index];
+		s.item = nullptr;
+		count_--;
+		if (s.generation == ARC_HANDLE_GENERATION_MASK) {
+			return item; // Retired, as the next generation would wrap around.
+		}
+		s.generation++;
+		if (free_tail_ == ARC_HANDLE_NO_FREE_SLOT) {
+			free_head_ = index;
+		} else {
+			slots_[free_tail_].next_free = index;
+		}
+		free_tail_ = index;
+		return item;
+	}
+
+	// Returns false if already removed.
+	bool remove(const uint32_t handle) {
+		T* item = release(handle);
+		delete item;
+		return item != nullptr;
+	}
+
+	// Removes (and deletes) all, but keeps the generations, so older handles are still stale.
+	void clear() {
+		for (size_t i = 0; i < slots_.size(); i++) {
+			const slot& s = slots_[i];
+			if (s.item != nullptr) {
+				remove((s.generation << ARC_HANDLE_INDEX_BITS) | uint32_t(i));
+			}
+		}
+	}
+
+	size_t size() const { return count_; } // Number of items.
+	// For iterating over all of the slots, free slots are nullptr.
+	size_t slots() const { return slots_.size(); }
+	T* operator[](const size_t index) const { return slots_[index].item; }
+
+private:
+	struct slot {
+		T* item = nullptr;
+		uint32_t generation = 1;
+		uint32_t next_free = ARC_HANDLE_NO_FREE_SLOT;
+	};
+
+	std::vector<slot> slots_;
+	// Least recently freed first, then each one's next_free.
+	uint32_t free_head_ = ARC_HANDLE_NO_FREE_SLOT;
+	uint32_t free_tail_ = ARC_HANDLE_NO_FREE_SLOT; // Most recently freed.
+	size_t count_ = 0;
+
+	slot_pool(const slot_pool&) = delete;
+	slot_pool& operator=(const slot_pool&) = delete;
+};
+
 } // namespace arc
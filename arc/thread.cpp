@@ -1,9 +1,12 @@
 #include "thread.h"
 
 #include "log.h"
+#include "trace.h"
 
 namespace arc {
 
+ThreadManager thread_manager;
+
 void ThreadDispatcher(thread* target) {
 	if (target != nullptr) {
 		target->main_dispatch();
@@ -93,17 +96,94 @@ bool thread::running() {
 
 void thread::main_dispatch() {
 	state_.store(THREAD_STATE_RUNNING);
+	ARC_TRACE_SCOPE("thread::main");
 	try {
 		ret_code_ = main();
 	} catch (std::exception e) {
-		log::Error("Exception encountered in thread " + string::itoa(std::hash<std::thread::id>()(thread_.get_id())) + ": " + string(e.what()));
+		ARC_LOG_ERROR("Exception encountered in thread " + string::itoa(std::hash<std::thread::id>()(thread_.get_id())) + ": " + string(e.what()));
 		state_.store(THREAD_STATE_EXCEPT_FAILED);
 		return;
 	}
 	state_.store(ret_code_ == 0 ? THREAD_STATE_COMPLETE : THREAD_STATE_RET_FAILED);
 }
 
+thread_pool::thread_pool(const unsigned int n_threads) {
+	const unsigned int n = n_threads == 0 ? 1 : n_threads;
+	workers_.reserve(n);
+	for (unsigned int i = 0; i < n; i++) {
+		workers_.push_back(std::thread(&thread_pool::worker_main, this));
+	}
+}
+
+thread_pool::~thread_pool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stopping_ = true;
+	}
+	task_cv_.notify_all();
+	for (size_t i = 0; i < workers_.size(); i++) {
+		if (workers_[i].joinable()) {
+			workers_[i].join();
+		}
+	}
+}
+
+void thread_pool::run(std::function<void()> task) {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		tasks_.push_back(std::move(task));
+	}
+	task_cv_.notify_one();
+}
+
+size_t thread_pool::pending() {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return tasks_.size();
+}
+
+void thread_pool::wait_idle() {
+	std::unique_lock<std::mutex> lock(mutex_);
+	idle_cv_.wait(lock, [this]() { return tasks_.empty() && active_ == 0; });
+}
+
+void thread_pool::worker_main() {
+	ARC_TRACE_THREAD_NAME("thread_pool worker");
+	while (true) {
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			task_cv_.wait(lock, [this]() { return stopping_ || !tasks_.empty(); });
+			if (tasks_.empty()) {
+				return; // Stopping, and all tasks are done.
+			}
+			task = std::move(tasks_.front());
+			tasks_.pop_front();
+			active_++;
+		}
+
+		try {
+			ARC_TRACE_SCOPE("thread_pool task");
+			task();
+		} catch (const std::exception& e) {
+			ARC_LOG_ERROR("thread_pool", "Exception encountered in pool task: " + string(e.what()));
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			active_--;
+			if (active_ == 0 && tasks_.empty()) {
+				idle_cv_.notify_all();
+			}
+		}
+	}
+}
+
 ThreadManager::~ThreadManager() {
+	if (pool_ != nullptr) {
+		delete pool_; // Finishes any queued tasks first.
+		pool_ = nullptr;
+	}
+
 	const size_t len = threads_.size();
 	for (size_t i = 0; i < len; i++) {
 		if (threads_[i] != nullptr) {
@@ -133,6 +213,11 @@ thread& ThreadManager::CreateThreadFromObject(thread* t_obj) {
 	return *(threads_[len]);
 }
 
+thread_pool& ThreadManager::Pool() {
+	std::call_once(pool_once_, [this]() { pool_ = new thread_pool(RecommendedConcurrency()); });
+	return *pool_;
+}
+
 thread& ThreadManager::RunThreadFromObject(thread* t_obj) {
 	thread& th = CreateThreadFromObject(t_obj);
 	th.run();
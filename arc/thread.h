@@ -4,6 +4,11 @@
 #include <atomic>
 #include <chrono>
 #include <vector>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <condition_variable>
 
 #include "sync.h"
 
@@ -79,6 +84,45 @@ protected:
 
 void ThreadDispatcher(thread* target);
 
+// Fixed set of worker threads that run short tasks (file I/O, decoding, etc.) in the order they were queued.
+// Tasks must not block waiting on other tasks in the same pool, as that can starve the workers.
+class thread_pool {
+public:
+	explicit thread_pool(const unsigned int n_threads);
+	~thread_pool(); // Runs any remaining queued tasks, then joins all workers.
+
+	// Safe to call from any thread, including from within a running task.
+	void run(std::function<void()> task);
+
+	// Same as run, but the return value (or exception) is available through the future.
+	template<class Function>
+	std::future<typename std::result_of<Function()>::type> async(Function&& f) {
+		typedef typename std::result_of<Function()>::type R;
+		std::shared_ptr<std::packaged_task<R()>> task = std::make_shared<std::packaged_task<R()>>(std::forward<Function>(f));
+		std::future<R> result = task->get_future();
+		run([task]() { (*task)(); });
+		return result;
+	}
+
+	unsigned int size() const { return (unsigned int) workers_.size(); }
+	size_t pending(); // Queued tasks that have not started yet.
+
+	void wait_idle(); // Blocks until the queue is empty and no task is running. (Never call from a task!)
+
+protected:
+	void worker_main();
+
+	std::vector<std::thread> workers_;
+	std::deque<std::function<void()>> tasks_;
+	std::mutex mutex_;
+	std::condition_variable task_cv_;
+	std::condition_variable idle_cv_;
+	size_t active_ = 0;
+	bool stopping_ = false;
+
+	DELETE_COPY_AND_ASSIGN(thread_pool);
+};
+
 // TODO! All thread objects stored in the ThreadModule, so memory management/lifetime is not a problem, the access as references.
 // This also applies to RunFunctionInThread and CreateThreadFromObject, etc.
 
@@ -102,12 +146,20 @@ public:
 		return hardware_concurrency_ < 2 ? 2 : hardware_concurrency_;
 	}
 
-	// TODO: Thread pool, automatic management, etc.
+	// Shared worker pool (RecommendedConcurrency threads), created on first use.
+	thread_pool& Pool();
+
+	// TODO: Automatic management, etc.
 
 private:
 	std::vector<thread*> threads_;
 	const unsigned int hardware_concurrency_ = std::thread::hardware_concurrency();
 
-} thread_manager;
+	// Owned:
+	thread_pool* pool_ = nullptr;
+	std::once_flag pool_once_;
+};
+
+extern ThreadManager thread_manager;
 
 } // namespace arc
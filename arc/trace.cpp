@@ -0,0 +1,285 @@
+#include "trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <stdio.h>
+
+namespace arc { namespace trace {
+
+static std::atomic<bool> trace_enabled{ true };
+
+enum class EventType : uint8_t { COMPLETE, ASYNC_BEGIN, ASYNC_END };
+
+struct TraceEventInternal {
+	const char* name;
+	uint64_t start; // nsec
+	uint64_t value; // Duration (nsec) of complete events, or the id of async events
+	EventType type;
+};
+
+// Single producer (the owning thread), read by the export while it may still be written, so each
+// field is atomic (relaxed, as plain loads/stores on most platforms) and events that may have been
+// overwritten during the copy are left out.
+class TraceBufferInternal {
+public:
+	static const uint64_t kSize = ARC_TRACE_BUFFER_EVENTS;
+
+	explicit TraceBufferInternal(const uint32_t tid) : tid_(tid), events_(new Slot[kSize]) {}
+
+	void push(const EventType type, const char* name, const uint64_t start, const uint64_t value) {
+		const uint64_t n = written_.load(std::memory_order_relaxed);
+		Slot& slot = events_[n % kSize];
+		slot.name.store(name, std::memory_order_relaxed);
+		slot.start.store(start, std::memory_order_relaxed);
+		slot.value.store(value, std::memory_order_relaxed);
+		slot.type.store((uint8_t) type, std::memory_order_relaxed);
+		written_.store(n + 1, std::memory_order_release);
+	}
+
+	// Appends the events still in the buffer (oldest first) to out.
+	void collect(std::vector<TraceEventInternal>& out) const {
+		const uint64_t end = written_.load(std::memory_order_acquire);
+		uint64_t begin = end > kSize ? end - kSize : 0;
+		begin = std::max(begin, cleared_.load(std::memory_order_relaxed));
+		const size_t first = out.size();
+		for (uint64_t n = begin; n < end; n++) {
+			const Slot& slot = events_[n % kSize];
+			TraceEventInternal e;
+			e.name = slot.name.load(std::memory_order_relaxed);
+			e.start = slot.start.load(std::memory_order_relaxed);
+			e.value = slot.value.load(std::memory_order_relaxed);
+			e.type = (EventType) slot.type.load(std::memory_order_relaxed);
+			out.push_back(e);
+		}
+
+		// The event being written now replaces the one kSize before it, so drop any copied since then.
+		std::atomic_thread_fence(std::memory_order_acquire);
+		const uint64_t after = written_.load(std::memory_order_relaxed);
+		const uint64_t valid_from = after >= kSize ? after - kSize + 1 : 0;
+		if (valid_from > begin) {
+			const size_t overwritten = (size_t) std::min(valid_from - begin, end - begin);
+			out.erase(out.begin() + first, out.begin() + first + overwritten);
+		}
+	}
+
+	void clear() { cleared_.store(written_.load(std::memory_order_acquire), std::memory_order_relaxed); }
+
+	uint32_t tid() const { return tid_; }
+
+	std::string name_; // Requires the registry mutex
+	std::atomic<bool> owner_exited_{ false };
+
+protected:
+	struct Slot {
+		std::atomic<const char*> name{ nullptr };
+		std::atomic<uint64_t> start{ 0 };
+		std::atomic<uint64_t> value{ 0 };
+		std::atomic<uint8_t> type{ 0 };
+	};
+
+	const uint32_t tid_;
+	std::unique_ptr<Slot[]> events_;
+	std::atomic<uint64_t> written_{ 0 };
+	std::atomic<uint64_t> cleared_{ 0 }; // Events before this are not exported.
+
+	DELETE_COPY_AND_ASSIGN(TraceBufferInternal);
+};
+
+// Marks the thread's buffer as exited (it is still exported until cleared), when the thread exits.
+struct ThreadTraceBufferInternal {
+	~ThreadTraceBufferInternal() {
+		if (buffer) {
+			buffer->owner_exited_.store(true);
+		}
+	}
+
+	std::shared_ptr<TraceBufferInternal> buffer;
+};
+
+static thread_local ThreadTraceBufferInternal thread_trace_buffer;
+
+class TraceRegistryInternal {
+public:
+	// Never deleted, so threads can still record during static destruction.
+	static TraceRegistryInternal& Get() {
+		static TraceRegistryInternal* registry = new TraceRegistryInternal();
+		return *registry;
+	}
+
+	TraceBufferInternal* ThreadBuffer() {
+		if (!thread_trace_buffer.buffer) {
+			std::lock_guard<std::mutex> lock(mutex_);
+			thread_trace_buffer.buffer = std::make_shared<TraceBufferInternal>(next_tid_++);
+			buffers_.push_back(thread_trace_buffer.buffer);
+		}
+		return thread_trace_buffer.buffer.get();
+	}
+
+	void SetThreadName(const std::string& name) {
+		TraceBufferInternal* buffer = ThreadBuffer();
+		std::lock_guard<std::mutex> lock(mutex_);
+		buffer->name_ = name;
+	}
+
+	void Clear();
+	std::string ChromeTraceJson();
+
+protected:
+	TraceRegistryInternal() {}
+
+	std::mutex mutex_; // For everything below, and the buffer names.
+	std::vector<std::shared_ptr<TraceBufferInternal>> buffers_;
+	uint32_t next_tid_ = 1;
+
+	DELETE_COPY_AND_ASSIGN(TraceRegistryInternal);
+};
+
+void TraceRegistryInternal::Clear() {
+	std::lock_guard<std::mutex> lock(mutex_);
+	for (size_t i = 0; i < buffers_.size();) {
+		if (buffers_[i]->owner_exited_.load()) {
+			buffers_[i] = std::move(buffers_.back());
+			buffers_.pop_back();
+		} else {
+			buffers_[i]->clear();
+			i++;
+		}
+	}
+}
+
+static void AppendJsonString(std::string& out, const char* str) {
+	out.push_back('"');
+	for (const char* c = str; *c != '\0'; c++) {
+		switch (*c) {
+		case '"': out.append("\\\""); break;
+		case '\\': out.append("\\\\"); break;
+		case '\n': out.append("\\n"); break;
+		case '\t': out.append("\\t"); break;
+		default:
+			if ((unsigned char) *c < 0x20) {
+				char escaped[8];
+				snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned int) (unsigned char) *c);
+				out.append(escaped);
+			} else {
+				out.push_back(*c);
+			}
+		}
+	}
+	out.push_back('"');
+}
+
+std::string TraceRegistryInternal::ChromeTraceJson() {
+	struct ThreadEvents {
+		uint32_t tid;
+		std::string name;
+		std::vector<TraceEventInternal> events;
+	};
+	std::vector<ThreadEvents> threads;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		threads.resize(buffers_.size());
+		for (size_t i = 0; i < buffers_.size(); i++) {
+			threads[i].tid = buffers_[i]->tid();
+			threads[i].name = buffers_[i]->name_.empty() ? "thread " + std::to_string(buffers_[i]->tid()) : buffers_[i]->name_;
+			buffers_[i]->collect(threads[i].events);
+		}
+	}
+
+	// Timestamps are from the first event, in usec (as the format expects).
+	uint64_t epoch = UINT64_MAX;
+	for (const ThreadEvents& t : threads) {
+		for (const TraceEventInternal& e : t.events) {
+			epoch = std::min(epoch, e.start);
+		}
+	}
+
+	std::string out("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+	bool first = true;
+	char buffer[160];
+	for (const ThreadEvents& t : threads) {
+		snprintf(buffer, sizeof(buffer), "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":",
+			first ? "\n" : ",\n", t.tid);
+		out.append(buffer);
+		AppendJsonString(out, t.name.c_str());
+		out.append("}}");
+		first = false;
+
+		for (const TraceEventInternal& e : t.events) {
+			out.append(",\n{\"name\":");
+			AppendJsonString(out, e.name != nullptr ? e.name : "");
+			const double ts = double(e.start - epoch) / 1000.0;
+			if (e.type == EventType::COMPLETE) {
+				snprintf(buffer, sizeof(buffer), ",\"cat\":\"arc\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+					t.tid, ts, double(e.value) / 1000.0);
+			} else {
+				snprintf(buffer, sizeof(buffer), ",\"cat\":\"arc\",\"ph\":\"%c\",\"id\":\"0x%llx\",\"pid\":1,\"tid\":%u,\"ts\":%.3f}",
+					e.type == EventType::ASYNC_BEGIN ? 'b' : 'e', (unsigned long long) e.value, t.tid, ts);
+			}
+			out.append(buffer);
+		}
+	}
+	out.append("\n]}\n");
+	return out;
+}
+
+void SetEnabled(const bool enabled) {
+	trace_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool Enabled() {
+	return trace_enabled.load(std::memory_order_relaxed);
+}
+
+void SetThreadName(const std::string& name) {
+	TraceRegistryInternal::Get().SetThreadName(name);
+}
+
+void Clear() {
+	TraceRegistryInternal::Get().Clear();
+}
+
+std::string ChromeTraceJson() {
+	return TraceRegistryInternal::Get().ChromeTraceJson();
+}
+
+bool WriteChromeTrace(const char* filename) {
+	const std::string json = ChromeTraceJson();
+	FILE* f = fopen(filename, "wb");
+	if (f == nullptr) {
+		perror("Error [trace.WriteChromeTrace]: file open for write failed");
+		return false;
+	}
+	const bool ok = fwrite(json.data(), 1, json.size(), f) == json.size();
+	if (fclose(f) != 0 || !ok) {
+		perror("Error [trace.WriteChromeTrace]: file write failed");
+		return false;
+	}
+	return true;
+}
+
+uint64_t Now() {
+	return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Complete(const char* name, const uint64_t start_nsec, const uint64_t end_nsec) {
+	TraceRegistryInternal::Get().ThreadBuffer()->push(EventType::COMPLETE, name, start_nsec, end_nsec - start_nsec);
+}
+
+void AsyncBegin(const char* name, const uint64_t id) {
+	if (Enabled()) {
+		TraceRegistryInternal::Get().ThreadBuffer()->push(EventType::ASYNC_BEGIN, name, Now(), id);
+	}
+}
+
+void AsyncEnd(const char* name, const uint64_t id) {
+	if (Enabled()) {
+		TraceRegistryInternal::Get().ThreadBuffer()->push(EventType::ASYNC_END, name, Now(), id);
+	}
+}
+
+} } // namespace arc::trace
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "arc.h"
+
+// Tracing is compiled out unless ARC_TRACE is defined, then all of the ARC_TRACE_* macros below
+// expand to nothing (and their arguments are not evaluated).
+
+// Events kept per thread, the oldest are overwritten when full.
+#ifndef ARC_TRACE_BUFFER_EVENTS
+	#define ARC_TRACE_BUFFER_EVENTS 8192
+#endif
+
+#define ARC_TRACE_CONCAT_INTERNAL(a, b) a##b
+#define ARC_TRACE_CONCAT(a, b) ARC_TRACE_CONCAT_INTERNAL(a, b)
+
+#ifdef ARC_TRACE
+	// Traces from here until the end of the enclosing scope. name must be a string literal (or
+	// otherwise never freed), as only the pointer is kept.
+	#define ARC_TRACE_SCOPE(name) ::arc::trace::trace_scope ARC_TRACE_CONCAT(arc_trace_scope_, __LINE__)(name)
+	// For operations that finish on another thread (or interleave with others on the same thread),
+	// id must be the same for the begin and end, and unique among those in progress with this name.
+	#define ARC_TRACE_ASYNC_BEGIN(name, id) ::arc::trace::AsyncBegin(name, (uint64_t) (uintptr_t) (id))
+	#define ARC_TRACE_ASYNC_END(name, id) ::arc::trace::AsyncEnd(name, (uint64_t) (uintptr_t) (id))
+	// Shown for the calling thread, instead of its number.
+	#define ARC_TRACE_THREAD_NAME(name) ::arc::trace::SetThreadName(name)
+#else
+	#define ARC_TRACE_SCOPE(name) ((void) 0)
+	#define ARC_TRACE_ASYNC_BEGIN(name, id) ((void) 0)
+	#define ARC_TRACE_ASYNC_END(name, id) ((void) 0)
+	#define ARC_TRACE_THREAD_NAME(name) ((void) 0)
+#endif
+
+namespace arc { namespace trace {
+
+// Events are recorded into a lock-free ring buffer for each thread, and are only collected when
+// exported. The export is in the Chrome Trace Event JSON format, which can be opened in
+// chrome://tracing or the Perfetto UI (https://ui.perfetto.dev).
+
+// Enabled by default (when compiled in), this pauses or resumes recording on all threads.
+void SetEnabled(const bool enabled);
+bool Enabled();
+
+void SetThreadName(const std::string& name);
+
+// Removes all recorded events (and the buffers of threads that have exited).
+void Clear();
+
+// Safe to call while other threads are still recording, events overwritten during the export are
+// left out.
+std::string ChromeTraceJson();
+bool WriteChromeTrace(const char* filename); // Returns false if the file could not be written.
+
+// Used by the macros above:
+
+uint64_t Now(); // In nanoseconds, from a monotonic clock.
+void Complete(const char* name, const uint64_t start_nsec, const uint64_t end_nsec);
+void AsyncBegin(const char* name, const uint64_t id);
+void AsyncEnd(const char* name, const uint64_t id);
+
+class trace_scope {
+public:
+	explicit trace_scope(const char* name) : name_(name), start_(Enabled() ? Now() : 0) {}
+	~trace_scope() {
+		if (start_ != 0) {
+			Complete(name_, start_, Now());
+		}
+	}
+
+protected:
+	const char* name_;
+	const uint64_t start_; // 0 when disabled
+
+	DELETE_COPY_AND_ASSIGN(trace_scope);
+};
+
+} } // namespace arc::trace